@@ -200,11 +200,13 @@ local function write_log(source_ip, source_port, rfc, ...)
   if rfc then writer(source_ip, source_port, rfc, ...) end
 end
 
-uv.udp()
+uv.udp(uv.UDP_RECVMMSG and "recvmmsg")
   :bind("*", "514")
-  :start_recv(function(srv, err, data, flags, host, port)
+  :start_recv({batch = 64}, function(srv, err, datas, hosts, ports, n)
     if err then return end
-    write_log(host, port, syslog_msg(data))
+    for i = 1, n do
+      write_log(hosts[i], ports[i], syslog_msg(datas[i]))
+    end
   end)
 
 uv.run()
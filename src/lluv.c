@@ -26,11 +26,15 @@
 #include "lluv_check.h"
 #include "lluv_poll.h"
 #include "lluv_signal.h"
+#include "lluv_async.h"
 #include "lluv_fs_event.h"
 #include "lluv_fs_poll.h"
 #include "lluv_process.h"
 #include "lluv_misc.h"
 #include "lluv_dns.h"
+#include "lluv_work.h"
+#include "lluv_thread.h"
+#include "lluv_sockaddr.h"
 
 #define LLUV_COPYRIGHT     "Copyright (C) 2014-2019 Alexey Melnichuk"
 #define LLUV_MODULE_NAME   "lluv"
@@ -104,11 +108,15 @@ static int luaopen_lluv_impl(lua_State *L, int safe){
   LLUV_PUSH_UPVALUES(L); lluv_check_initlib    (L, NUPVALUES, safe);
   LLUV_PUSH_UPVALUES(L); lluv_poll_initlib     (L, NUPVALUES, safe);
   LLUV_PUSH_UPVALUES(L); lluv_signal_initlib   (L, NUPVALUES, safe);
+  LLUV_PUSH_UPVALUES(L); lluv_async_initlib    (L, NUPVALUES, safe);
   LLUV_PUSH_UPVALUES(L); lluv_fs_event_initlib (L, NUPVALUES, safe);
   LLUV_PUSH_UPVALUES(L); lluv_fs_poll_initlib  (L, NUPVALUES, safe);
   LLUV_PUSH_UPVALUES(L); lluv_process_initlib  (L, NUPVALUES, safe);
   LLUV_PUSH_UPVALUES(L); lluv_misc_initlib     (L, NUPVALUES, safe);
   LLUV_PUSH_UPVALUES(L); lluv_dns_initlib      (L, NUPVALUES, safe);
+  LLUV_PUSH_UPVALUES(L); lluv_work_initlib     (L, NUPVALUES, safe);
+  LLUV_PUSH_UPVALUES(L); lluv_thread_initlib   (L, NUPVALUES, safe);
+  LLUV_PUSH_UPVALUES(L); lluv_sockaddr_initlib (L, NUPVALUES, safe);
 
   lua_remove(L, -2); /* registry */
   lua_remove(L, -2); /* handles  */
@@ -0,0 +1,514 @@
+/******************************************************************************
+* Author: Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Copyright (C) 2014-2017 Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Licensed according to the included 'LICENSE' document
+*
+* This file is part of lua-lluv library.
+******************************************************************************/
+
+#include "lluv.h"
+#include "lluv_handle.h"
+#include "lluv_async.h"
+#include "lluv_loop.h"
+#include "lluv_error.h"
+#include "lluv_serial.h"
+#include <assert.h>
+#include <string.h>
+
+#define LLUV_ASYNC_NAME LLUV_PREFIX" Async"
+static const char *LLUV_ASYNC = LLUV_ASYNC_NAME;
+
+#define LLUV_CHANNEL_NAME LLUV_PREFIX" Channel"
+static const char *LLUV_CHANNEL = LLUV_CHANNEL_NAME;
+
+#define LLUV_CHANNEL_SENDER_NAME LLUV_PREFIX" Channel sender"
+static const char *LLUV_CHANNEL_SENDER = LLUV_CHANNEL_SENDER_NAME;
+
+static const lluv_async_api_t lluv_async_api = {
+  LLUV_ASYNC_API_VERSION,
+  uv_async_send
+};
+
+static void lluv_on_async(uv_async_t *arg){
+  lluv_on_handle_start((uv_handle_t*)arg);
+}
+
+/* async([loop,] cb)
+ * Handle is active since creation so it keeps loop alive until closed
+ * or unref'ed.
+ */
+LLUV_IMPL_SAFE(lluv_async_create){
+  lluv_loop_t   *loop = lluv_opt_loop(L, 1, LLUV_FLAG_OPEN);
+  int argc = loop ? 1 : 0;
+  lluv_handle_t *handle;
+  int err;
+
+  if(!loop) loop = lluv_default_loop(L);
+
+  lluv_check_args_with_cb(L, argc + 1);
+
+  handle = lluv_handle_create(L, UV_ASYNC, safe_flag | INHERITE_FLAGS(loop));
+  err = uv_async_init(loop->handle, LLUV_H(handle, uv_async_t), lluv_on_async);
+  if(err < 0){
+    lluv_handle_cleanup(L, handle, -1);
+    return lluv_fail(L, safe_flag | loop->flags, LLUV_ERR_UV, (uv_errno_t)err, NULL);
+  }
+
+  lua_pushvalue(L, -2);
+  LLUV_START_CB(handle) = luaL_ref(L, LLUV_LUA_REGISTRY);
+  lluv_handle_lock(L, handle, LLUV_LOCK_START);
+
+  return 1;
+}
+
+static lluv_handle_t* lluv_check_async(lua_State *L, int idx, lluv_flags_t flags){
+  lluv_handle_t *handle = lluv_check_handle(L, idx, flags);
+  luaL_argcheck (L, LLUV_H(handle, uv_handle_t)->type == UV_ASYNC, idx, LLUV_ASYNC_NAME" expected");
+
+  return handle;
+}
+
+/* Multiple sends before loop iteration result in single callback call */
+static int lluv_async_send(lua_State *L){
+  lluv_handle_t *handle = lluv_check_async(L, 1, LLUV_FLAG_OPEN);
+  int err = uv_async_send(LLUV_H(handle, uv_async_t));
+  if(err < 0){
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
+  }
+
+  lua_settop(L, 1);
+  return 1;
+}
+
+static int lluv_async_pointer(lua_State *L){
+  lluv_handle_t *handle = lluv_check_async(L, 1, LLUV_FLAG_OPEN);
+  lua_pushlightuserdata(L, LLUV_H(handle, uv_async_t));
+  lua_pushlightuserdata(L, (void*)&lluv_async_api);
+  return 2;
+}
+
+static const struct luaL_Reg lluv_async_methods[] = {
+  { "send",       lluv_async_send      },
+  { "pointer",    lluv_async_pointer   },
+
+  {NULL,NULL}
+};
+
+//{ Channel
+
+/* Channel is an async handle with multi producer single consumer queue
+ * of serialized messages. Queue is intrusive lock-free queue by D.Vyukov.
+ * Producers may live in any thread and reference shared channel
+ * by sender objects. Mutex guards only pointer to async handle and
+ * taken once per wakeup.
+ */
+
+#if defined(_MSC_VER)
+#  define LLUV_ATOMIC_XCHG_PTR(P, V)  InterlockedExchangePointer((PVOID volatile*)(P), (V))
+#  define LLUV_ATOMIC_STORE_PTR(P, V) InterlockedExchangePointer((PVOID volatile*)(P), (V))
+#  define LLUV_ATOMIC_LOAD_PTR(P)     (*(P))
+#  define LLUV_ATOMIC_XCHG(P, V)      InterlockedExchange((LONG volatile*)(P), (V))
+#  define LLUV_ATOMIC_LOAD(P)         (*(P))
+#  define LLUV_ATOMIC_INC(P)          InterlockedIncrement((LONG volatile*)(P))
+#  define LLUV_ATOMIC_DEC(P)          InterlockedDecrement((LONG volatile*)(P))
+#else
+#  define LLUV_ATOMIC_XCHG_PTR(P, V)  __atomic_exchange_n((P), (V), __ATOMIC_ACQ_REL)
+#  define LLUV_ATOMIC_STORE_PTR(P, V) __atomic_store_n((P), (V), __ATOMIC_RELEASE)
+#  define LLUV_ATOMIC_LOAD_PTR(P)     __atomic_load_n((P), __ATOMIC_ACQUIRE)
+#  define LLUV_ATOMIC_XCHG(P, V)      __atomic_exchange_n((P), (V), __ATOMIC_SEQ_CST)
+#  define LLUV_ATOMIC_LOAD(P)         __atomic_load_n((P), __ATOMIC_SEQ_CST)
+#  define LLUV_ATOMIC_INC(P)          __atomic_add_fetch((P), 1, __ATOMIC_SEQ_CST)
+#  define LLUV_ATOMIC_DEC(P)          __atomic_sub_fetch((P), 1, __ATOMIC_SEQ_CST)
+#endif
+
+/* Max number of messages delivered per loop iteration */
+#ifndef LLUV_CHANNEL_BATCH
+#  define LLUV_CHANNEL_BATCH 1024
+#endif
+
+typedef struct lluv_channel_msg_tag{
+  struct lluv_channel_msg_tag *next;
+  size_t size;
+  /* serialized values follows */
+} lluv_channel_msg_t;
+
+typedef struct lluv_channel_tag{
+  long                 refs;
+  long                 signaled;
+  long                 closed;
+  lluv_channel_msg_t  *head;  /* producers push here */
+  lluv_channel_msg_t  *tail;  /* consumer pops here  */
+  lluv_channel_msg_t   stub;
+  uv_mutex_t           mutex;
+  uv_async_t          *async; /* NULL when receiver closed */
+} lluv_channel_t;
+
+typedef struct lluv_channel_sender_tag{
+  lluv_channel_t *channel;
+} lluv_channel_sender_t;
+
+#define LLUV_MSG_DATA(M) ((const char*)((M) + 1))
+
+static void lluv_channel_push(lluv_channel_t *ch, lluv_channel_msg_t *msg){
+  lluv_channel_msg_t *prev;
+  msg->next = NULL;
+  prev = (lluv_channel_msg_t*)LLUV_ATOMIC_XCHG_PTR(&ch->head, msg);
+  LLUV_ATOMIC_STORE_PTR(&prev->next, msg);
+}
+
+/* returns NULL if queue is empty or producer does not finish push yet.
+ * In last case producer wakeup consumer again.
+ */
+static lluv_channel_msg_t *lluv_channel_pop(lluv_channel_t *ch){
+  lluv_channel_msg_t *tail = ch->tail;
+  lluv_channel_msg_t *next = LLUV_ATOMIC_LOAD_PTR(&tail->next);
+
+  if(tail == &ch->stub){
+    if(!next) return NULL;
+    ch->tail = tail = next;
+    next = LLUV_ATOMIC_LOAD_PTR(&next->next);
+  }
+
+  if(next){
+    ch->tail = next;
+    return tail;
+  }
+
+  if(tail != LLUV_ATOMIC_LOAD_PTR(&ch->head)) return NULL;
+
+  lluv_channel_push(ch, &ch->stub);
+
+  next = LLUV_ATOMIC_LOAD_PTR(&tail->next);
+  if(next){
+    ch->tail = next;
+    return tail;
+  }
+
+  return NULL;
+}
+
+static lluv_channel_t *lluv_channel_new(void){
+  lluv_channel_t *ch = lluv_alloc_t(NULL, lluv_channel_t);
+  if(!ch) return NULL;
+
+  if(uv_mutex_init(&ch->mutex) < 0){
+    lluv_free_t(NULL, lluv_channel_t, ch);
+    return NULL;
+  }
+
+  ch->refs      = 1;
+  ch->signaled  = 0;
+  ch->closed    = 0;
+  ch->stub.next = NULL;
+  ch->head      = &ch->stub;
+  ch->tail      = &ch->stub;
+  ch->async     = NULL;
+
+  return ch;
+}
+
+static void lluv_channel_ref(lluv_channel_t *ch){
+  LLUV_ATOMIC_INC(&ch->refs);
+}
+
+static void lluv_channel_unref(lluv_channel_t *ch){
+  lluv_channel_msg_t *msg;
+
+  if(LLUV_ATOMIC_DEC(&ch->refs) != 0) return;
+
+  /* nobody can push any more */
+  while((msg = lluv_channel_pop(ch))){
+    lluv_serial_release(LLUV_MSG_DATA(msg), msg->size);
+    lluv_free(NULL, msg);
+  }
+
+  uv_mutex_destroy(&ch->mutex);
+  lluv_free_t(NULL, lluv_channel_t, ch);
+}
+
+/* serialize values and push them. Returns 1 if message sent,
+ * 0 if receiver closed or raises error.
+ */
+static int lluv_channel_send_impl(lua_State *L, lluv_channel_t *ch, int first){
+  lluv_channel_msg_t *msg, hdr;
+  lluv_sbuf_t buf;
+  const char *emsg;
+  int err;
+
+  if(LLUV_ATOMIC_LOAD(&ch->closed)) return 0;
+
+  lluv_sbuf_init(&buf);
+  memset(&hdr, 0, sizeof(hdr));
+  err = lluv_sbuf_append(&buf, &hdr, sizeof(hdr));
+  if(err < 0){
+    lluv_sbuf_free(&buf);
+    return luaL_error(L, "not enough memory");
+  }
+
+  err = lluv_serial_encode(L, first, lua_gettop(L), &buf, &emsg);
+  if(err < 0){
+    lluv_serial_release(buf.data + sizeof(lluv_channel_msg_t), buf.size - sizeof(lluv_channel_msg_t));
+    lluv_sbuf_free(&buf);
+    return luaL_error(L, "%s", emsg);
+  }
+
+  msg = (lluv_channel_msg_t*)buf.data;
+  msg->size = buf.size - sizeof(lluv_channel_msg_t);
+  lluv_channel_push(ch, msg);
+
+  /* wakeup only if consumer is not signaled yet */
+  if(!LLUV_ATOMIC_XCHG(&ch->signaled, 1)){
+    uv_mutex_lock(&ch->mutex);
+    if(ch->async) uv_async_send(ch->async);
+    uv_mutex_unlock(&ch->mutex);
+  }
+
+  return 1;
+}
+
+static void lluv_on_channel(uv_async_t *arg){
+  lluv_handle_t  *handle = lluv_handle_byptr((uv_handle_t*)arg);
+  lluv_channel_t *ch     = (lluv_channel_t*)handle->ext;
+  lluv_loop_t    *loop   = lluv_loop_by_handle(&handle->handle);
+  lua_State *L = LLUV_HCALLBACK_L(handle);
+  lluv_channel_msg_t *msg;
+  int i, n;
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  LLUV_ATOMIC_XCHG(&ch->signaled, 0);
+
+  for(i = 0; i < LLUV_CHANNEL_BATCH; ++i){
+    if(uv_is_closing((uv_handle_t*)arg)) return;
+
+    msg = lluv_channel_pop(ch);
+    if(!msg) break;
+
+    lua_rawgeti(L, LLUV_LUA_REGISTRY, LLUV_START_CB(handle));
+    lluv_handle_pushself(L, handle);
+    n = lluv_serial_decode(L, LLUV_MSG_DATA(msg), msg->size);
+    lluv_free(NULL, msg);
+    if(n < 0) n = 0;
+
+    if(lluv_lua_call(L, n + 1, 0)){
+      i = LLUV_CHANNEL_BATCH;
+      break;
+    }
+    lluv_loop_defer_proceed(L, loop);
+  }
+
+  /* there may be more messages so continue on next iteration */
+  if(i == LLUV_CHANNEL_BATCH && !uv_is_closing((uv_handle_t*)arg)){
+    if(!LLUV_ATOMIC_XCHG(&ch->signaled, 1)) uv_async_send(arg);
+  }
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+LLUV_INTERNAL void lluv_async_ext_close(lluv_handle_t *handle){
+  lluv_channel_t *ch = (lluv_channel_t*)handle->ext;
+
+  if(LLUV_ATOMIC_XCHG(&ch->closed, 1)) return;
+
+  uv_mutex_lock(&ch->mutex);
+  ch->async = NULL;
+  uv_mutex_unlock(&ch->mutex);
+}
+
+LLUV_INTERNAL void lluv_async_ext_free(lua_State *L, lluv_handle_t *handle){
+  lluv_channel_t *ch = (lluv_channel_t*)handle->ext;
+  (void)L;
+
+  lluv_async_ext_close(handle);
+  handle->ext = NULL;
+  lluv_channel_unref(ch);
+}
+
+/* channel([loop,] cb) */
+LLUV_IMPL_SAFE(lluv_channel_create){
+  lluv_loop_t   *loop = lluv_opt_loop(L, 1, LLUV_FLAG_OPEN);
+  int argc = loop ? 1 : 0;
+  lluv_handle_t *handle;
+  lluv_channel_t *ch;
+  int err;
+
+  if(!loop) loop = lluv_default_loop(L);
+
+  lluv_check_args_with_cb(L, argc + 1);
+
+  ch = lluv_channel_new();
+  if(!ch) return lluv_fail(L, safe_flag | loop->flags, LLUV_ERR_UV, UV_ENOMEM, NULL);
+
+  handle = lluv_handle_create(L, UV_ASYNC, safe_flag | INHERITE_FLAGS(loop));
+  err = uv_async_init(loop->handle, LLUV_H(handle, uv_async_t), lluv_on_channel);
+  if(err < 0){
+    lluv_channel_unref(ch);
+    lluv_handle_cleanup(L, handle, -1);
+    return lluv_fail(L, safe_flag | loop->flags, LLUV_ERR_UV, (uv_errno_t)err, NULL);
+  }
+
+  ch->async   = LLUV_H(handle, uv_async_t);
+  handle->ext = ch;
+  lluv_handle_setmeta(L, -1, LLUV_CHANNEL);
+
+  lua_pushvalue(L, -2);
+  LLUV_START_CB(handle) = luaL_ref(L, LLUV_LUA_REGISTRY);
+  lluv_handle_lock(L, handle, LLUV_LOCK_START);
+
+  return 1;
+}
+
+static lluv_handle_t* lluv_check_channel(lua_State *L, int idx, lluv_flags_t flags){
+  lluv_handle_t *handle = lluv_check_handle(L, idx, flags);
+  luaL_argcheck (L, LLUV_H(handle, uv_handle_t)->type == UV_ASYNC && handle->ext, idx, LLUV_CHANNEL_NAME" expected");
+
+  return handle;
+}
+
+static int lluv_channel_send(lua_State *L){
+  lluv_handle_t *handle = lluv_check_channel(L, 1, LLUV_FLAG_OPEN);
+  lua_pushboolean(L, lluv_channel_send_impl(L, (lluv_channel_t*)handle->ext, 2));
+  return 1;
+}
+
+static lluv_channel_sender_t *lluv_channel_sender_push(lua_State *L, lluv_channel_t *ch);
+
+static int lluv_channel_sender(lua_State *L){
+  lluv_handle_t *handle = lluv_check_channel(L, 1, LLUV_FLAG_OPEN);
+  lluv_channel_t *ch = (lluv_channel_t*)handle->ext;
+  lluv_channel_ref(ch);
+  lluv_channel_sender_push(L, ch);
+  return 1;
+}
+
+static const struct luaL_Reg lluv_channel_methods[] = {
+  { "send",       lluv_channel_send    },
+  { "sender",     lluv_channel_sender  },
+
+  {NULL,NULL}
+};
+
+//}
+
+//{ Channel sender
+
+/* Sender can be created in any Lua state even without lluv library
+ * so its metatable is created on demand and does not use upvalues.
+ */
+
+static lluv_channel_sender_t *lluv_check_channel_sender(lua_State *L, int idx){
+  lluv_channel_sender_t *sender = (lluv_channel_sender_t *)lutil_checkudatap (L, idx, LLUV_CHANNEL_SENDER);
+  luaL_argcheck (L, sender != NULL, idx, LLUV_CHANNEL_SENDER_NAME" expected");
+  luaL_argcheck (L, sender->channel != NULL, idx, LLUV_CHANNEL_SENDER_NAME" closed");
+  return sender;
+}
+
+static int lluv_channel_sender_send(lua_State *L){
+  lluv_channel_sender_t *sender = lluv_check_channel_sender(L, 1);
+  lua_pushboolean(L, lluv_channel_send_impl(L, sender->channel, 2));
+  return 1;
+}
+
+static int lluv_channel_sender_closed(lua_State *L){
+  lluv_channel_sender_t *sender = lluv_check_channel_sender(L, 1);
+  lua_pushboolean(L, LLUV_ATOMIC_LOAD(&sender->channel->closed) ? 1 : 0);
+  return 1;
+}
+
+static int lluv_channel_sender_gc(lua_State *L){
+  lluv_channel_sender_t *sender = (lluv_channel_sender_t *)lutil_checkudatap (L, 1, LLUV_CHANNEL_SENDER);
+  if(sender && sender->channel){
+    lluv_channel_unref(sender->channel);
+    sender->channel = NULL;
+  }
+  return 0;
+}
+
+static int lluv_channel_sender_to_s(lua_State *L){
+  lluv_channel_sender_t *sender = lluv_check_channel_sender(L, 1);
+  lua_pushfstring(L, LLUV_CHANNEL_SENDER_NAME" (%p)", sender->channel);
+  return 1;
+}
+
+static const struct luaL_Reg lluv_channel_sender_methods[] = {
+  { "send",       lluv_channel_sender_send   },
+  { "closed",     lluv_channel_sender_closed },
+  { "__gc",       lluv_channel_sender_gc     },
+  { "__tostring", lluv_channel_sender_to_s   },
+
+  {NULL,NULL}
+};
+
+static lluv_channel_sender_t *lluv_channel_sender_push(lua_State *L, lluv_channel_t *ch){
+  lluv_channel_sender_t *sender;
+
+  lutil_createmetap(L, LLUV_CHANNEL_SENDER, lluv_channel_sender_methods, 0);
+  lua_pop(L, 1);
+
+  sender = lutil_newudatap(L, lluv_channel_sender_t, LLUV_CHANNEL_SENDER);
+  sender->channel = ch;
+  return sender;
+}
+
+LLUV_INTERNAL void *lluv_channel_serial_ref(lua_State *L, int idx){
+  lluv_channel_t *ch = NULL;
+
+  if(lutil_isudatap(L, idx, LLUV_CHANNEL_SENDER)){
+    ch = ((lluv_channel_sender_t*)lua_touserdata(L, idx))->channel;
+  }
+  else{
+    lluv_handle_t *handle = lluv_test_handle(L, idx);
+    if(handle && IS_(handle, OPEN) && handle->handle.type == UV_ASYNC)
+      ch = (lluv_channel_t*)handle->ext;
+  }
+
+  if(ch) lluv_channel_ref(ch);
+  return ch;
+}
+
+LLUV_INTERNAL void lluv_channel_serial_push(lua_State *L, void *channel){
+  lluv_channel_sender_push(L, (lluv_channel_t*)channel);
+}
+
+LLUV_INTERNAL void lluv_channel_serial_release(void *channel){
+  lluv_channel_unref((lluv_channel_t*)channel);
+}
+
+//}
+
+#define LLUV_FUNCTIONS(F)               \
+  {"async",   lluv_async_create_##F},   \
+  {"channel", lluv_channel_create_##F}, \
+
+static const struct luaL_Reg lluv_functions[][3] = {
+  {
+    LLUV_FUNCTIONS(unsafe)
+
+    {NULL,NULL}
+  },
+  {
+    LLUV_FUNCTIONS(safe)
+
+    {NULL,NULL}
+  },
+};
+
+LLUV_INTERNAL void lluv_async_initlib(lua_State *L, int nup, int safe){
+  assert((safe == 0) || (safe == 1));
+
+  lutil_pushnvalues(L, nup);
+  if(!lutil_createmetap(L, LLUV_ASYNC, lluv_async_methods, nup))
+    lua_pop(L, nup);
+  lua_pop(L, 1);
+  lluv_handle_createmeta(L, nup, UV_ASYNC, LLUV_ASYNC, NULL);
+
+  lutil_pushnvalues(L, nup);
+  if(!lutil_createmetap(L, LLUV_CHANNEL, lluv_channel_methods, nup))
+    lua_pop(L, nup);
+  lua_pop(L, 1);
+  lluv_handle_createmeta(L, nup, UV_UNKNOWN_HANDLE, LLUV_CHANNEL, NULL);
+
+  luaL_setfuncs(L, lluv_functions[safe], nup);
+}
@@ -0,0 +1,46 @@
+/******************************************************************************
+* Author: Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Copyright (C) 2014-2017 Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Licensed according to the included 'LICENSE' document
+*
+* This file is part of lua-lluv library.
+******************************************************************************/
+
+#ifndef _LLUV_ASYNC_H_
+#define _LLUV_ASYNC_H_
+
+LLUV_INTERNAL void lluv_async_initlib(lua_State *L, int nup, int safe);
+
+LLUV_INTERNAL void lluv_async_ext_close(struct lluv_handle_tag *handle);
+
+LLUV_INTERNAL void lluv_async_ext_free(lua_State *L, struct lluv_handle_tag *handle);
+
+/* Serializer support for channels.
+ * `ref` returns referenced channel or NULL if value is not a channel,
+ * `push` creates sender object and takes ownership of reference.
+ */
+LLUV_INTERNAL void *lluv_channel_serial_ref(lua_State *L, int idx);
+
+LLUV_INTERNAL void lluv_channel_serial_push(lua_State *L, void *channel);
+
+LLUV_INTERNAL void lluv_channel_serial_release(void *channel);
+
+/* Native API to wake up async handle from any thread.
+ * `async:pointer()` returns pointer to handle and pointer to this structure
+ * as lightuserdata values. So native extension does not have to link to
+ * same libuv library. Pointer to handle is valid until handle is closed.
+ *
+ *   uv_async_t *h = lua_touserdata(L, 1);
+ *   const lluv_async_api_t *api = lua_touserdata(L, 2);
+ *   api->send(h);
+ */
+#define LLUV_ASYNC_API_VERSION 1
+
+typedef struct lluv_async_api_tag{
+  int version;
+  int (*send)(uv_async_t *handle);
+} lluv_async_api_t;
+
+#endif
@@ -18,10 +18,6 @@
 #define LLUV_CHECK_NAME LLUV_PREFIX" Check"
 static const char *LLUV_CHECK = LLUV_CHECK_NAME;
 
-LLUV_INTERNAL int lluv_check_index(lua_State *L){
-  return lluv__index(L, LLUV_CHECK, lluv_handle_index);
-}
-
 LLUV_IMPL_SAFE(lluv_check_create){
   lluv_loop_t   *loop   = lluv_opt_loop_ex(L, 1, LLUV_FLAG_OPEN);
   lluv_handle_t *handle = lluv_handle_create(L, UV_CHECK, safe_flag | INHERITE_FLAGS(loop));
@@ -98,6 +94,7 @@ LLUV_INTERNAL void lluv_check_initlib(lua_State *L, int nup, int safe){
   if(!lutil_createmetap(L, LLUV_CHECK, lluv_check_methods, nup))
     lua_pop(L, nup);
   lua_pop(L, 1);
+  lluv_handle_createmeta(L, nup, UV_CHECK, LLUV_CHECK, NULL);
 
   luaL_setfuncs(L, lluv_functions[safe], nup);
 }
@@ -13,6 +13,7 @@
 #include "lluv_loop.h"
 #include "lluv_error.h"
 #include "lluv_req.h"
+#include "lluv_sockaddr.h"
 #include <memory.h>
 #include <assert.h>
 
@@ -334,7 +335,7 @@ LLUV_IMPL_SAFE(lluv_getnameinfo){
     int has_callback = lua_isfunction(L, -1);
 
     // Push port number
-    if(!lua_isnumber(L, ARGN(2))){
+    if(!lua_isnumber(L, ARGN(2)) && !lluv_test_sockaddr(L, ARGN(1))){
       lua_pushinteger(L, 0);
       lua_insert(L, ARGN(2));
     }
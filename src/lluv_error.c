@@ -27,9 +27,14 @@ static const char *LLUV_ERROR = LLUV_ERROR_NAME;
 static const char *LLUV_ERR_UV_NAME = "LIBUV";
 static const char *LLUV_ERR_LIB_NAME = "LLUV";
 
+/* Error objects are immutable so errors without `ext`
+ * can be shared. Key is `error_no * 2 + error_category`.
+ */
+static const char *LLUV_ERROR_CACHE = LLUV_PREFIX" Error cache";
+
 //{ Error object
 
-LLUV_INTERNAL int lluv_error_create(lua_State *L, int error_category, uv_errno_t error_no, const char *ext){
+static int lluv_error_new_object(lua_State *L, int error_category, uv_errno_t error_no, const char *ext){
   static size_t max_ext_len = 4096;
   lluv_error_t *err;
   size_t len;
@@ -55,6 +60,36 @@ LLUV_INTERNAL int lluv_error_create(lua_State *L, int error_category, uv_errno_t
   return 1;
 }
 
+LLUV_INTERNAL int lluv_error_create(lua_State *L, int error_category, uv_errno_t error_no, const char *ext){
+  int key;
+
+  if((ext && ext[0]) || ((error_category != LLUV_ERR_UV) && (error_category != LLUV_ERR_LIB)))
+    return lluv_error_new_object(L, error_category, error_no, ext);
+
+  key = (int)error_no * 2 + error_category;
+
+  lua_rawgetp(L, LUA_REGISTRYINDEX, LLUV_ERROR_CACHE);
+  assert(lua_istable(L, -1));
+  lua_rawgeti(L, -1, key);
+  if(lua_isnil(L, -1)){
+    lua_pop(L, 1);
+    lluv_error_new_object(L, error_category, error_no, NULL);
+    lua_pushvalue(L, -1);
+    lua_rawseti(L, -3, key);
+  }
+  lua_remove(L, -2);
+
+  return 1;
+}
+
+LLUV_INTERNAL int lluv_error_push(lua_State *L, lluv_flags_t flags, int error_category, uv_errno_t error_no){
+  if(FLAG_IS_SET(flags, LLUV_FLAG_ERROR_NUMBER) && (error_category == LLUV_ERR_UV)){
+    lua_pushinteger(L, error_no);
+    return 1;
+  }
+  return lluv_error_create(L, error_category, error_no, NULL);
+}
+
 static lluv_error_t *lluv_check_error(lua_State *L, int i){
   lluv_error_t *err = (lluv_error_t *)lutil_checkudatap (L, i, LLUV_ERROR);
   luaL_argcheck (L, err != NULL, 1, LLUV_ERROR_NAME" expected");
@@ -65,7 +100,7 @@ static int lluv_err_category(lua_State *L){
   lluv_error_t *err = lluv_check_error(L,1);
 
   if(err->cat == LLUV_ERR_UV) lua_pushstring(L, LLUV_ERR_UV_NAME);
-  else if(err->cat == LLUV_ERR_LIB) lua_pushstring(L, LLUV_ERR_LIB);
+  else if(err->cat == LLUV_ERR_LIB) lua_pushstring(L, LLUV_ERR_LIB_NAME);
   else lua_pushinteger(L, err->cat);
 
   return 1;
@@ -100,7 +135,7 @@ static int lluv_err_tostring(lua_State *L){
   const char *cat = 0;
   int n = 2;
 
-  if(err->cat == LLUV_ERR_LIB)     cat = LLUV_ERR_LIB;
+  if(err->cat == LLUV_ERR_LIB)     cat = LLUV_ERR_LIB_NAME;
   else if(err->cat == LLUV_ERR_UV) cat = LLUV_ERR_UV_NAME;
 
   if(cat) lua_pushfstring(L, "[%s]", cat);
@@ -161,7 +196,7 @@ static int lluv_error_new(lua_State *L){
 
   //! @todo checks error type value
 
-  lluv_error_create(L, tp, no, ext);
+  lluv_error_new_object(L, tp, no, ext);
   return 1;
 }
 
@@ -207,6 +242,12 @@ LLUV_INTERNAL void lluv_error_initlib(lua_State *L, int nup, int safe){
     lua_pop(L, nup);
   lua_pop(L, 1);
 
+  lua_rawgetp(L, LUA_REGISTRYINDEX, LLUV_ERROR_CACHE);
+  if(lua_isnil(L, -1)){
+    lua_newtable(L); lua_rawsetp(L, LUA_REGISTRYINDEX, LLUV_ERROR_CACHE);
+  }
+  lua_pop(L, 1);
+
   luaL_setfuncs(L, lluv_error_functions, nup);
   lluv_register_constants(L, lluv_error_constants);
 }
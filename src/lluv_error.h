@@ -26,8 +26,12 @@ typedef struct lluv_error_tag{
 
 LLUV_INTERNAL void lluv_error_initlib(lua_State *L, int nup, int safe);
 
+/* errors without `ext` are cached so there no allocation */
 LLUV_INTERNAL int lluv_error_create(lua_State *L, int error_category, uv_errno_t error_no, const char *ext);
 
+/* push error object or number if LLUV_FLAG_ERROR_NUMBER is set */
+LLUV_INTERNAL int lluv_error_push(lua_State *L, lluv_flags_t flags, int error_category, uv_errno_t error_no);
+
 LLUV_INTERNAL int lluv_fail(lua_State *L, lluv_flags_t flags, int error_category, uv_errno_t error_no, const char *ext);
 
 #endif
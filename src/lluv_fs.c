@@ -673,6 +673,10 @@ static lluv_file_t *lluv_check_file(lua_State *L, int i, lluv_flags_t flags){
   return f;
 }
 
+LLUV_INTERNAL uv_file lluv_check_file_handle(lua_State *L, int idx){
+  return lluv_check_file(L, idx, LLUV_FLAG_OPEN)->handle;
+}
+
 static int lluv_file_to_s(lua_State *L){
   lluv_file_t *f = lluv_check_file(L, 1, 0);
   lua_pushfstring(L, LLUV_FILE_NAME" (%p)", f);
@@ -15,5 +15,7 @@
 
 LLUV_INTERNAL void lluv_fs_initlib(lua_State *L, int nup, int safe);
 
+LLUV_INTERNAL uv_file lluv_check_file_handle(lua_State *L, int idx);
+
 #endif
 
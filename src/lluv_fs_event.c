@@ -18,10 +18,6 @@
 #define LLUV_FS_EVENT_NAME LLUV_PREFIX" FS Event"
 static const char *LLUV_FS_EVENT = LLUV_FS_EVENT_NAME;
 
-LLUV_INTERNAL int lluv_fs_event_index(lua_State *L){
-  return lluv__index(L, LLUV_FS_EVENT, lluv_handle_index);
-}
-
 LLUV_IMPL_SAFE(lluv_fs_event_create){
   lluv_loop_t   *loop   = lluv_opt_loop_ex(L, 1, LLUV_FLAG_OPEN);
   lluv_handle_t *handle = lluv_handle_create(L, UV_FS_EVENT, safe_flag | INHERITE_FLAGS(loop));
@@ -50,7 +46,7 @@ static void lluv_on_fs_event_start(uv_fs_event_t *arg, const char* filename, int
   assert(!lua_isnil(L, -1)); /* is callble */
 
   lluv_handle_pushself(L, handle);
-  lluv_push_status(L, status);
+  lluv_push_status_ex(L, handle->flags, status);
 
   if(filename)lua_pushstring(L, filename); else lua_pushnil(L);
   lua_pushinteger(L, events);
@@ -167,6 +163,7 @@ LLUV_INTERNAL void lluv_fs_event_initlib(lua_State *L, int nup, int safe){
   if(!lutil_createmetap(L, LLUV_FS_EVENT, lluv_fs_event_methods, nup))
     lua_pop(L, nup);
   lua_pop(L, 1);
+  lluv_handle_createmeta(L, nup, UV_FS_EVENT, LLUV_FS_EVENT, NULL);
 
   luaL_setfuncs(L, lluv_fs_event_functions[safe], nup);
   lluv_register_constants(L, lluv_fs_event_constants);
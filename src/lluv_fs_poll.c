@@ -18,10 +18,6 @@
 #define LLUV_FS_POLL_NAME LLUV_PREFIX" FS Poll"
 static const char *LLUV_FS_POLL = LLUV_FS_POLL_NAME;
 
-LLUV_INTERNAL int lluv_fs_poll_index(lua_State *L){
-  return lluv__index(L, LLUV_FS_POLL, lluv_handle_index);
-}
-
 LLUV_IMPL_SAFE(lluv_fs_poll_create){
   lluv_loop_t   *loop   = lluv_opt_loop_ex(L, 1, LLUV_FLAG_OPEN);
   lluv_handle_t *handle = lluv_handle_create(L, UV_FS_POLL, safe_flag | INHERITE_FLAGS(loop));
@@ -50,7 +46,7 @@ static void lluv_on_fs_poll_start(uv_fs_poll_t *arg, int status, const uv_stat_t
   assert(!lua_isnil(L, -1)); /* is callble */
 
   lluv_handle_pushself(L, handle);
-  lluv_push_status(L, status);
+  lluv_push_status_ex(L, handle->flags, status);
 
   if(prev)lluv_push_stat(L, prev); else lua_pushnil(L);
   if(curr)lluv_push_stat(L, curr); else lua_pushnil(L);
@@ -154,6 +150,7 @@ LLUV_INTERNAL void lluv_fs_poll_initlib(lua_State *L, int nup, int safe){
   if(!lutil_createmetap(L, LLUV_FS_POLL, lluv_fs_poll_methods, nup))
     lua_pop(L, nup);
   lua_pop(L, 1);
+  lluv_handle_createmeta(L, nup, UV_FS_POLL, LLUV_FS_POLL, NULL);
 
   luaL_setfuncs(L, lluv_fs_poll_functions[safe], nup);
   lluv_register_constants(L, lluv_fs_poll_constants);
@@ -23,39 +23,20 @@
 #include "lluv_check.h"
 #include "lluv_poll.h"
 #include "lluv_signal.h"
+#include "lluv_async.h"
 #include "lluv_fs_event.h"
 #include "lluv_fs_poll.h"
 #include "lluv_process.h"
 #include <assert.h>
 #include <string.h>
 
-static const char* LLUV_HANDLES_SET = LLUV_PREFIX" Handles set";
-static const char* LLUV_HANDLE_NIL_UD = LLUV_PREFIX" nil ud";
+static const char* LLUV_HANDLE_METAS   = LLUV_PREFIX" Handle metatables";
+static const char* LLUV_HANDLE_METHODS = LLUV_PREFIX" Handle methods";
 
-static int lluv_handle_dispatch(lua_State *L){
-  lluv_handle_t *handle = lluv_check_handle(L, 1, 0);
-  luaL_checkstring(L, 2);
-
-  switch(handle->handle.type){
-    case UV_HANDLE:     return lluv_handle_index(L);
-    case UV_STREAM:     return lluv_stream_index(L);
-    case UV_IDLE:       return lluv_idle_index(L);
-    case UV_TIMER:      return lluv_timer_index(L);
-    case UV_TCP:        return lluv_tcp_index(L);
-    case UV_NAMED_PIPE: return lluv_pipe_index(L);
-    case UV_TTY:        return lluv_tty_index(L);
-    case UV_UDP:        return lluv_udp_index(L);
-    case UV_PREPARE:    return lluv_prepare_index(L);
-    case UV_CHECK:      return lluv_check_index(L);
-    case UV_POLL:       return lluv_poll_index(L);
-    case UV_SIGNAL:     return lluv_signal_index(L);
-    case UV_FS_EVENT:   return lluv_fs_event_index(L);
-    case UV_FS_POLL:    return lluv_fs_poll_index(L);
-    case UV_PROCESS:    return lluv_process_index(L);
-  }
-  assert(0 && "please provide index function for this handle type");
-  return 0;
-}
+#if LUA_VERSION_NUM < 502
+/* Lua 5.1 has no uservalue so `data` field stored in weak table */
+static const char* LLUV_HANDLES_DATA = LLUV_PREFIX" Handles data";
+#endif
 
 //{ Handle
 
@@ -66,16 +47,6 @@ static int lluv_handle_set_data(lua_State *L);
 
 static int lluv_handle_get_data(lua_State *L);
 
-LLUV_INTERNAL int lluv_handle_index(lua_State *L){
-  const char *key = luaL_checkstring(L, 2);
-  if(0 == strcmp("data", key)){
-    lua_remove(L, 2);
-    return lluv_handle_get_data(L);
-  }
-
-  return lluv__index(L, LLUV_HANDLE, NULL);
-}
-
 LLUV_INTERNAL int lluv_handle_newindex(lua_State *L){
   const char *key = luaL_checkstring(L, 2);
   if(0 == strcmp("data", key)){
@@ -93,23 +64,27 @@ LLUV_INTERNAL lluv_handle_t* lluv_handle_create(lua_State *L, uv_handle_type typ
 
   assert(uv_handle_size(type) >= sizeof(uv_handle_t));
 
-  handle = (lluv_handle_t *)lutil_newudatap_impl(L, sizeof(lluv_handle_t) + extra_size, LLUV_HANDLE);
+  handle = (lluv_handle_t *)lua_newuserdata(L, sizeof(lluv_handle_t) + extra_size);
+  memset(handle, 0, sizeof(lluv_handle_t) + extra_size);
+
+  lua_rawgetp(L, LLUV_LUA_REGISTRY, LLUV_HANDLE_METAS);
+  lua_rawgeti(L, -1, type);
+  assert(lua_istable(L, -1) && "handle type has no metatable");
+  lua_setmetatable(L, -3);
+  lua_pop(L, 1);
 
   handle->L      = L;
   handle->flags  = flags | LLUV_FLAG_OPEN;
   handle->handle.data = handle;
+  handle->ext    = NULL;
   for(i = 0; i < LLUV_MAX_HANDLE_CB; ++i){
     handle->callbacks[i] = LUA_NOREF;
   }
 
+  /* the only registry slot of handle */
   lua_pushvalue(L, -1);
   lua_rawsetp(L, LLUV_LUA_HANDLES, &handle->handle);
 
-  lua_rawgetp(L, LLUV_LUA_REGISTRY, LLUV_HANDLES_SET);
-  assert(lua_istable(L, -1));
-  lua_pushvalue(L, -2); lua_pushlightuserdata(L, (void*)LLUV_HANDLE_NIL_UD); lua_rawset(L, -3);
-  lua_pop(L, 1);
-
   handle->self = LUA_NOREF;
   handle->lock = 0;
   handle->lock_counter = 0;
@@ -118,7 +93,7 @@ LLUV_INTERNAL lluv_handle_t* lluv_handle_create(lua_State *L, uv_handle_type typ
 }
 
 LLUV_INTERNAL lluv_handle_t* lluv_check_handle(lua_State *L, int idx, lluv_flags_t flags){
-  lluv_handle_t *handle = (lluv_handle_t *)lutil_checkudatap (L, idx, LLUV_HANDLE);
+  lluv_handle_t *handle = lluv_test_handle(L, idx);
   luaL_argcheck (L, handle != NULL, idx, LLUV_HANDLE_NAME" expected");
 
   luaL_argcheck (L, FLAGS_IS_SET(handle->flags, flags), idx, LLUV_HANDLE_NAME" closed");
@@ -133,33 +108,11 @@ LLUV_INTERNAL lluv_handle_t* lluv_handle_byptr(uv_handle_t *h){
   return handle;
 }
 
-static int lluv_find_handle(lua_State *L, uv_handle_t *h){
-  lua_rawgetp(L, LLUV_LUA_REGISTRY, LLUV_HANDLES_SET);
-  lua_pushnil(L);
-  while(lua_next(L, -2) != 0){/*handle => UserValue*/
-    lluv_handle_t *handle;
-
-    assert(lluv_check_handle(L, -2, 0));
-    lua_pop(L, 1);
-
-    handle = (lluv_handle_t*)lua_touserdata(L, -1);
-    if(h == &handle->handle){
-      lua_remove(L, -2);
-      return 1;
-    }
-  }
-  lua_pop(L, 1);
-  lua_pushnil(L);
-  return 1;
-}
-
+/* Handle object can be missing only if it already unreachable
+ * and waits its finalizer.
+ */
 LLUV_INTERNAL int lluv_handle_find(lua_State *L, uv_handle_t *h){
   lua_rawgetp(L, LLUV_LUA_HANDLES, h);
-  if(lua_isnil(L, -1)){
-    lua_pop(L, 1);
-    lluv_find_handle(L, h);
-  }
-
   return 1;
 }
 
@@ -177,10 +130,84 @@ LLUV_INTERNAL int lluv_handle_pushself(lua_State *L, lluv_handle_t *handle){
   else
     lluv_handle_find(L, &handle->handle);
 
-  assert(handle == lua_touserdata(L, -1));
+  assert(lua_isnil(L, -1) || (handle == lua_touserdata(L, -1)));
   return 1;
 }
 
+//{ Handle data
+
+static void lluv_handle_data_clear(lua_State *L, int idx){
+#if LUA_VERSION_NUM >= 502
+  lua_pushnil(L);
+  lua_setuservalue(L, idx);
+#else
+  idx = lua_absindex(L, idx);
+  lua_rawgetp(L, LLUV_LUA_REGISTRY, LLUV_HANDLES_DATA);
+  lua_pushvalue(L, idx); lua_pushnil(L); lua_rawset(L, -3);
+  lua_pop(L, 1);
+#endif
+}
+
+/* set value at top of stack as data and pop it */
+static void lluv_handle_data_set(lua_State *L, int idx){
+  if(lua_isnil(L, -1)){
+    lua_pop(L, 1);
+    lluv_handle_data_clear(L, idx);
+    return;
+  }
+
+  idx = lua_absindex(L, idx);
+
+  /* switch to metatable which knows about `data` field */
+  lua_getmetatable(L, idx);
+  lua_rawgetp(L, -1, LLUV_HANDLE);
+  lua_setmetatable(L, idx);
+  lua_pop(L, 1);
+
+#if LUA_VERSION_NUM >= 503
+  lua_setuservalue(L, idx);
+#elif LUA_VERSION_NUM >= 502
+  /* uservalue have to be table */
+  lua_createtable(L, 1, 0); lua_insert(L, -2); lua_rawseti(L, -2, 1);
+  lua_setuservalue(L, idx);
+#else
+  lua_rawgetp(L, LLUV_LUA_REGISTRY, LLUV_HANDLES_DATA);
+  lua_insert(L, -2); lua_pushvalue(L, idx); lua_insert(L, -2); lua_rawset(L, -3);
+  lua_pop(L, 1);
+#endif
+}
+
+static void lluv_handle_data_get(lua_State *L, int idx){
+#if LUA_VERSION_NUM >= 503
+  lua_getuservalue(L, idx);
+#elif LUA_VERSION_NUM >= 502
+  lua_getuservalue(L, idx);
+  if(lua_istable(L, -1)){
+    lua_rawgeti(L, -1, 1);
+    lua_remove(L, -2);
+  }
+#else
+  idx = lua_absindex(L, idx);
+  lua_rawgetp(L, LLUV_LUA_REGISTRY, LLUV_HANDLES_DATA);
+  lua_pushvalue(L, idx); lua_rawget(L, -2);
+  lua_remove(L, -2);
+#endif
+}
+
+//}
+
+LLUV_INTERNAL lluv_handle_t* lluv_test_handle(lua_State *L, int idx){
+  lluv_handle_t *handle = (lluv_handle_t *)lua_touserdata(L, idx);
+  if(handle && lua_getmetatable(L, idx)){
+    /* all handle metatables have reference to data metatable */
+    lua_rawgetp(L, -1, LLUV_HANDLE);
+    if(!lua_istable(L, -1)) handle = NULL;
+    lua_pop(L, 2);
+    return handle;
+  }
+  return NULL;
+}
+
 LLUV_INTERNAL void lluv_handle_cleanup(lua_State *L, lluv_handle_t *handle, int idx){
   int i;
 
@@ -189,9 +216,7 @@ LLUV_INTERNAL void lluv_handle_cleanup(lua_State *L, lluv_handle_t *handle, int
 
     assert(handle == lua_touserdata(L, idx));
 
-    lua_rawgetp(L, LLUV_LUA_REGISTRY, LLUV_HANDLES_SET);
-    lua_pushvalue(L, idx); lua_pushnil(L); lua_rawset(L, -3);
-    lua_pop(L, 1);
+    lluv_handle_data_clear(L, idx);
   }
 
   UNSET_(handle, OPEN);
@@ -204,6 +229,14 @@ LLUV_INTERNAL void lluv_handle_cleanup(lua_State *L, lluv_handle_t *handle, int
   handle->self = LUA_NOREF;
 
   handle->lock = 0;
+
+  if(handle->ext){
+    if(IS_(handle, STREAM)) lluv_stream_ext_free(L, handle);
+    else if(handle->handle.type == UV_TIMER) lluv_timer_ext_free(L, handle);
+    else if(handle->handle.type == UV_ASYNC) lluv_async_ext_free(L, handle);
+    else if(handle->handle.type == UV_UDP) lluv_udp_ext_free(L, handle);
+    assert(handle->ext == NULL);
+  }
 }
 
 LLUV_INTERNAL void lluv_handle_lock(lua_State *L, lluv_handle_t *handle, lluv_flags_t lock){
@@ -278,7 +311,12 @@ static void lluv_on_handle_close(uv_handle_t *arg){
   lua_rawgeti(L, LLUV_LUA_REGISTRY, LLUV_CLOSE_CB(handle));
   lluv_handle_pushself(L, handle);
 
-  if(lua_isnil(L, -2)){
+  if(lua_isnil(L, -1)){
+    /* closed by loop before finalizer was called */
+    lluv_handle_cleanup(L, handle, 0);
+    lua_pop(L, 2);
+  }
+  else if(lua_isnil(L, -2)){
     lluv_handle_cleanup(L, handle, -1);
     lua_pop(L, 2);
   }
@@ -289,10 +327,9 @@ static void lluv_on_handle_close(uv_handle_t *arg){
 
     LLUV_LOOP_CALL_CB(L, loop, 1);
 
-    /* cleanup LLUV_HANDLES_SET after callback */
+    /* cleanup data after callback */
     assert(lluv_check_handle(L, -1, 0));
-    lua_rawgetp(L, LLUV_LUA_REGISTRY, LLUV_HANDLES_SET);
-    lua_insert(L, -2); lua_pushnil(L); lua_rawset(L, -3);
+    lluv_handle_data_clear(L, -1);
     lua_pop(L, 1);
   }
 
@@ -307,6 +344,14 @@ static int lluv_handle_close(lua_State *L){
   }
 
   if(uv_is_closing(LLUV_H(handle, uv_handle_t))){
+    /* closed by lluv_handle_close_unreachable so this is finalizer.
+     * libuv still use memory so keep object until close callback.
+     */
+    if(!FLAG_IS_SET(handle->lock, LLUV_LOCK_CLOSE)){
+      lua_pushvalue(L, 1);
+      lua_rawsetp(L, LLUV_LUA_HANDLES, &handle->handle);
+      lluv_handle_lock(L, handle, LLUV_LOCK_CLOSE);
+    }
     return 0;
   }
 
@@ -319,12 +364,24 @@ static int lluv_handle_close(lua_State *L){
     LLUV_CLOSE_CB(handle) = luaL_ref(L, LLUV_LUA_REGISTRY);
   }
 
+  /* channel should not be signaled after close */
+  if(handle->ext && handle->handle.type == UV_ASYNC) lluv_async_ext_close(handle);
+
   uv_close(LLUV_H(handle, uv_handle_t), lluv_on_handle_close);
 
   lua_settop(L, 1);
   return 1;
 }
 
+LLUV_INTERNAL void lluv_handle_close_unreachable(lluv_handle_t *handle){
+  assert(IS_(handle, OPEN));
+  assert(handle->self == LUA_NOREF);
+
+  if(handle->ext && handle->handle.type == UV_ASYNC) lluv_async_ext_close(handle);
+
+  uv_close(LLUV_H(handle, uv_handle_t), lluv_on_handle_close);
+}
+
 static int lluv_handle_closed(lua_State *L){
   lluv_handle_t *handle = lluv_check_handle(L, 1, 0);
 
@@ -428,35 +485,35 @@ static int lluv_handle_fileno(lua_State *L){
 static int lluv_handle_set_data(lua_State *L){
   lluv_check_handle(L, 1, LLUV_FLAG_OPEN);
   lua_settop(L, 2);
-  if(lua_isnil(L, -1)){
-    lua_pop(L, 1);
-    lua_pushlightuserdata(L, (void*)LLUV_HANDLE_NIL_UD);
-  }
-  lua_rawgetp(L, LLUV_LUA_REGISTRY, LLUV_HANDLES_SET);
-  assert(lua_istable(L, -1));
-  lua_insert(L, 1);
-  lua_rawset(L, -3);
+  lluv_handle_data_set(L, 1);
   return 0;
 }
 
 static int lluv_handle_get_data(lua_State *L){
   lluv_check_handle(L, 1, 0);
   lua_settop(L, 1);
+  lluv_handle_data_get(L, 1);
+  return 1;
+}
 
-  lua_rawgetp(L, LLUV_LUA_REGISTRY, LLUV_HANDLES_SET);
-  assert(lua_istable(L, -1));
-  lua_insert(L, -2);
-  lua_rawget(L, -2);
+static int lluv_handle_error_mode(lua_State *L){
+  static const char *modes[] = {"object", "number", NULL};
+  lluv_handle_t *handle = lluv_check_handle(L, 1, 0);
+
+  if(lua_isnoneornil(L, 2)){
+    lua_pushstring(L, modes[IS_(handle, ERROR_NUMBER) ? 1 : 0]);
+    return 1;
+  }
 
-  if(lua_touserdata(L, -1) == LLUV_HANDLE_NIL_UD)
-    lua_pushnil(L);
+  if(luaL_checkoption(L, 2, NULL, modes)) SET_(handle, ERROR_NUMBER);
+  else UNSET_(handle, ERROR_NUMBER);
 
+  lua_settop(L, 1);
   return 1;
 }
 
 static const struct luaL_Reg lluv_handle_methods[] = {
   { "__gc",             lluv_handle_close            },
-  { "__index",          lluv_handle_dispatch         },
   { "__newindex",       lluv_handle_newindex         },
   { "__tostring",       lluv_handle_to_s             },
   { "loop",             lluv_handle_loop             },
@@ -473,14 +530,129 @@ static const struct luaL_Reg lluv_handle_methods[] = {
   { "lock",             lluv_handle_lock_            },
   { "unlock",           lluv_handle_unlock_          },
   { "locked",           lluv_handle_locked_          },
+  { "error_mode",       lluv_handle_error_mode       },
 
   {NULL,NULL}
 };
 
 //}
 
+//{ Handle metatables
+
+/* Each handle type has its own metatable with flat `__index` table
+ * so method lookup done by VM without any C call.
+ * Handle with `data` field use second metatable with `__index` function.
+ * Both metatables have reference to the second one with LLUV_HANDLE key
+ * which also used to recognize handle objects.
+ */
+
+static const char *lluv_handle_metamethods[] = {
+  "__gc", "__newindex", "__tostring", NULL
+};
+
+static int lluv_handle_index_data(lua_State *L){
+  const char *key;
+
+  lua_settop(L, 2);
+  lua_getmetatable(L, 1);
+  lua_rawgetp(L, -1, LLUV_HANDLE_METHODS);
+  lua_pushvalue(L, 2); lua_rawget(L, -2);
+  if(!lua_isnil(L, -1)) return 1;
+  lua_settop(L, 2);
+
+  key = lua_tostring(L, 2);
+  if(key && (0 == strcmp("data", key))){
+    lua_settop(L, 1);
+    return lluv_handle_get_data(L);
+  }
+
+  return 0;
+}
+
+static void lluv_handle_copy_fields(lua_State *L, const char *meta, int metamethods){
+  lutil_getmetatablep(L, meta);
+  assert(lua_istable(L, -1));
+
+  lua_pushnil(L);
+  while(lua_next(L, -2)){
+    int is_meta = (lua_type(L, -2) == LUA_TSTRING) &&
+      (0 == strncmp("__", lua_tostring(L, -2), 2));
+    if(is_meta == metamethods){
+      lua_pushvalue(L, -2); lua_insert(L, -2);
+      lua_rawset(L, -5);
+    }
+    else lua_pop(L, 1);
+  }
+
+  lua_pop(L, 1);
+}
+
+static void lluv_handle_copy_metamethods(lua_State *L){
+  const char **name = lluv_handle_metamethods;
+
+  lutil_getmetatablep(L, LLUV_HANDLE);
+  for(; *name; ++name){
+    lua_getfield(L, -1, *name);
+    lua_setfield(L, -3, *name);
+  }
+  lua_pop(L, 1);
+}
+
+LLUV_INTERNAL void lluv_handle_createmeta(lua_State *L, int nup, uv_handle_type type, const char *meta, const char *base){
+  int i;
+
+  lua_rawgetp(L, -nup, LLUV_HANDLE_METAS);
+  assert(lua_istable(L, -1));
+
+  lua_rawgetp(L, -1, meta);
+  if(!lua_isnil(L, -1)){ /* already created by other module flavor */
+    lua_pop(L, 2);
+    return;
+  }
+  lua_pop(L, 1);
+
+  /* flat methods table: handle <- base <- meta */
+  lua_newtable(L);
+  lluv_handle_copy_fields(L, LLUV_HANDLE, 0);
+  if(base) lluv_handle_copy_fields(L, base, 0);
+  lluv_handle_copy_fields(L, meta, 0);
+
+  /* metatable for handles with data */
+  lua_newtable(L);
+  lluv_handle_copy_metamethods(L);
+  for(i = 0; i < nup; ++i) lua_pushvalue(L, -(3 + nup));
+  lua_pushcclosure(L, lluv_handle_index_data, nup);
+  lua_setfield(L, -2, "__index");
+  lua_pushvalue(L, -2); lua_rawsetp(L, -2, LLUV_HANDLE_METHODS);
+  lua_pushvalue(L, -1); lua_rawsetp(L, -2, LLUV_HANDLE);
+
+  /* metatable for handles without data */
+  lua_newtable(L);
+  lluv_handle_copy_metamethods(L);
+  lua_pushvalue(L, -3); lua_setfield(L, -2, "__index");
+  lua_insert(L, -2); lua_rawsetp(L, -2, LLUV_HANDLE);
+
+  if(type != UV_UNKNOWN_HANDLE){
+    lua_pushvalue(L, -1); lua_rawseti(L, -4, type);
+  }
+  lua_rawsetp(L, -3, meta);
+
+  lua_pop(L, 2);
+}
+
+LLUV_INTERNAL void lluv_handle_setmeta(lua_State *L, int idx, const char *meta){
+  idx = lua_absindex(L, idx);
+  lua_rawgetp(L, LLUV_LUA_REGISTRY, LLUV_HANDLE_METAS);
+  lua_rawgetp(L, -1, meta);
+  assert(lua_istable(L, -1));
+  lua_setmetatable(L, idx);
+  lua_pop(L, 1);
+}
+
+//}
+
 static int lluv_debug_handles(lua_State *L){
-  lua_rawgetp(L, LLUV_LUA_REGISTRY, LLUV_HANDLES_SET);
+  lua_pushvalue(L, LLUV_LUA_HANDLES);
   return 1;
 }
 
@@ -509,7 +681,15 @@ LLUV_INTERNAL void lluv_handle_initlib(lua_State *L, int nup, int safe){
   int ret;
   lutil_pushnvalues(L, nup);
 
-  lluv_new_weak_table(L, "k"); lua_rawsetp(L, -nup - 1, LLUV_HANDLES_SET);
+#if LUA_VERSION_NUM < 502
+  lluv_new_weak_table(L, "k"); lua_rawsetp(L, -nup - 1, LLUV_HANDLES_DATA);
+#endif
+
+  lua_rawgetp(L, -nup, LLUV_HANDLE_METAS);
+  if(lua_isnil(L, -1)){
+    lua_newtable(L); lua_rawsetp(L, -nup - 2, LLUV_HANDLE_METAS);
+  }
+  lua_pop(L, 1);
 
   ret = lutil_newmetatablep(L, LLUV_HANDLE);
   lua_insert(L, -1 - nup); /* move mt prior upvalues */
@@ -29,6 +29,7 @@ typedef struct lluv_handle_tag{
   lua_State   *L;
   lluv_flags_t flags;
   int          callbacks[LLUV_MAX_HANDLE_CB];
+  void        *ext;   /* type specific data allocated on demand */
   uv_handle_t  handle;
 } lluv_handle_t;
 
@@ -39,12 +40,23 @@ typedef struct lluv_handle_tag{
 
 LLUV_INTERNAL void lluv_handle_initlib(lua_State *L, int nup, int safe);
 
-LLUV_INTERNAL int lluv_handle_index(lua_State *L);
+/* Create metatable for handles of `type` with methods from
+ * handle, `base` (may be NULL) and `meta` method tables.
+ * Use UV_UNKNOWN_HANDLE to create metatable which can be set
+ * only by lluv_handle_setmeta.
+ */
+LLUV_INTERNAL void lluv_handle_createmeta(lua_State *L, int nup, uv_handle_type type, const char *meta, const char *base);
+
+/* Set metatable created for `meta` to handle at `idx` */
+LLUV_INTERNAL void lluv_handle_setmeta(lua_State *L, int idx, const char *meta);
 
 LLUV_INTERNAL lluv_handle_t* lluv_handle_create(lua_State *L, uv_handle_type type, lluv_flags_t flags);
 
 LLUV_INTERNAL lluv_handle_t* lluv_check_handle(lua_State *L, int idx, lluv_flags_t flags);
 
+/* returns NULL if value is not a handle */
+LLUV_INTERNAL lluv_handle_t* lluv_test_handle(lua_State *L, int idx);
+
 LLUV_INTERNAL void lluv_handle_cleanup(lua_State *L, lluv_handle_t *handle, int idx);
 
 /* Convert uv_handle_t* to lluv_handle_t*
@@ -60,6 +72,11 @@ LLUV_INTERNAL int lluv_handle_find(lua_State *L, uv_handle_t *h);
 
 LLUV_INTERNAL int lluv_handle_pushself(lua_State *L, lluv_handle_t *handle);
 
+/* close handle which Lua object already unreachable and waits its finalizer.
+ * Close callback does cleanup and finalizer keeps object until it called.
+ */
+LLUV_INTERNAL void lluv_handle_close_unreachable(lluv_handle_t *handle);
+
 LLUV_INTERNAL void lluv_on_handle_start(uv_handle_t *arg);
 
 LLUV_INTERNAL void lluv_handle_lock(lua_State *L, lluv_handle_t *handle, lluv_flags_t lock);
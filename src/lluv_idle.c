@@ -18,10 +18,6 @@
 #define LLUV_IDLE_NAME LLUV_PREFIX" Idle"
 static const char *LLUV_IDLE = LLUV_IDLE_NAME;
 
-LLUV_INTERNAL int lluv_idle_index(lua_State *L){
-  return lluv__index(L, LLUV_IDLE, lluv_handle_index);
-}
-
 LLUV_IMPL_SAFE(lluv_idle_create){
   lluv_loop_t   *loop   = lluv_opt_loop_ex(L, 1, LLUV_FLAG_OPEN);
   lluv_handle_t *handle = lluv_handle_create(L, UV_IDLE, safe_flag | INHERITE_FLAGS(loop));
@@ -107,6 +103,7 @@ LLUV_INTERNAL void lluv_idle_initlib(lua_State *L, int nup, int safe){
   if(!lutil_createmetap(L, LLUV_IDLE, lluv_idle_methods, nup))
     lua_pop(L, nup);
   lua_pop(L, 1);
+  lluv_handle_createmeta(L, nup, UV_IDLE, LLUV_IDLE, NULL);
 
   luaL_setfuncs(L, lluv_functions[safe], nup);
 }
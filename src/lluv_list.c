@@ -12,85 +12,131 @@
 #include "lluv_utils.h"
 #include "lluv_list.h"
 #include <assert.h>
+#include <string.h>
+
+#define LLUV_LIST_INIT_SLOTS 32
+
+#define LLUV_LIST_INIT_ITEMS 16
 
 LLUV_INTERNAL void lluv_list_init(lua_State *L, lluv_list_t *lst){
-  lst->first = 0;
-  lst->last = -1;
-  lua_newtable(L);
-  lst->t = luaL_ref(L, LLUV_LUA_REGISTRY);
+  lua_createtable(L, LLUV_LIST_INIT_SLOTS, 0);
+  lst->t     = luaL_ref(L, LLUV_LUA_REGISTRY);
+  lst->vhead = lst->vlen = 0;
+  lst->vcap  = LLUV_LIST_INIT_SLOTS;
+  lst->items = NULL;
+  lst->head  = lst->len = lst->cap = 0;
 }
 
 LLUV_INTERNAL void lluv_list_close(lua_State *L, lluv_list_t *lst){
-  lst->first = 0;
-  lst->last = -1;
   luaL_unref(L, LLUV_LUA_REGISTRY, lst->t);
-  lst->t = LUA_NOREF;
+  lst->t     = LUA_NOREF;
+  lst->vhead = lst->vlen = lst->vcap = 0;
+  if(lst->items) lluv_free(L, lst->items);
+  lst->items = NULL;
+  lst->head  = lst->len = lst->cap = 0;
 }
 
-static void lluv_list_push_(lua_State *L, lluv_list_t *lst, lua_Integer i){
-  int top = lua_gettop(L);
+/* table with slots should be on top of stack */
+static void lluv_list_grow_slots(lua_State *L, lluv_list_t *lst, int n){
+  int i, cap = lst->vcap;
 
-  assert(!lua_isnoneornil(L, -1));
+  while(cap - lst->vlen < n) cap *= 2;
 
-  luaL_checkstack(L, 1, "too many arguments");
+  /* copy used slots to new table starting from first slot */
+  lua_createtable(L, cap, 0);
+  for(i = 0; i < lst->vlen; ++i){
+    lua_rawgeti(L, -2, ((lst->vhead + i) % lst->vcap) + 1);
+    lua_rawseti(L, -2, i + 1);
+  }
 
-  lua_rawgeti(L, LLUV_LUA_REGISTRY, lst->t);
-  lua_insert(L, -2);
+  lua_pushvalue(L, -1);
+  lua_rawseti(L, LLUV_LUA_REGISTRY, lst->t);
+  lua_remove(L, -2);
+
+  lst->vhead = 0;
+  lst->vcap  = cap;
+}
+
+static void lluv_list_grow_items(lua_State *L, lluv_list_t *lst){
+  size_t i, cap = lst->cap ? lst->cap * 2 : LLUV_LIST_INIT_ITEMS;
+  int *items = (int*)lluv_alloc(L, cap * sizeof(int));
+
+  if(!items){
+    luaL_error(L, "not enough memory");
+    return;
+  }
 
-  lua_rawseti(L, -2, i);
-  lua_pop(L, 1);
+  for(i = 0; i < lst->len; ++i){
+    items[i] = lst->items[(lst->head + i) % lst->cap];
+  }
 
-  assert(top == (1 + lua_gettop(L)));
+  if(lst->items) lluv_free(L, lst->items);
+  lst->items = items;
+  lst->head  = 0;
+  lst->cap   = cap;
 }
 
-static int lluv_list_pop_(lua_State *L, lluv_list_t *lst, lua_Integer i){
-  if(lst->first > lst->last) return 0;
+LLUV_INTERNAL void lluv_list_push_back(lua_State *L, lluv_list_t *lst, int n){
+  int i, first = lua_gettop(L) - n + 1;
 
-  assert((lst->first == i)||(lst->last == i));
+  assert(n > 0);
+  assert(first > 0);
+
+  if(lst->t == LUA_NOREF){ /* list closed */
+    lua_settop(L, first - 1);
+    return;
+  }
 
   luaL_checkstack(L, 3, "too many arguments");
 
-  lua_rawgeti(L, LLUV_LUA_REGISTRY, lst->t);
-  lua_rawgeti(L, -1, i);
+  if(lst->len == lst->cap) lluv_list_grow_items(L, lst);
 
-  assert(!lua_isnoneornil(L, -1));
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, lst->t);
+  if(lst->vcap - lst->vlen < n) lluv_list_grow_slots(L, lst, n);
 
-  lua_pushnil(L);
-  lua_rawseti(L, -3, i);
+  for(i = 0; i < n; ++i){
+    lua_pushvalue(L, first + i);
+    lua_rawseti(L, -2, ((lst->vhead + lst->vlen + i) % lst->vcap) + 1);
+  }
+  lua_settop(L, first - 1);
 
-  lua_remove(L, -2);
-  return 1;
+  lst->vlen += n;
+  lst->items[(lst->head + lst->len) % lst->cap] = n;
+  lst->len  += 1;
 }
 
-LLUV_INTERNAL void lluv_list_push_front(lua_State *L, lluv_list_t *lst){
-  lua_Integer i = lst->first - 1;
-  lluv_list_push_(L, lst, i);
-  lst->first = i;
-}
+LLUV_INTERNAL int lluv_list_pop_front(lua_State *L, lluv_list_t *lst){
+  int i, n, t;
 
-LLUV_INTERNAL void lluv_list_push_back(lua_State *L, lluv_list_t *lst){
-  lua_Integer i = lst->last + 1;
-  lluv_list_push_(L, lst, i);
-  lst->last = i;
-}
+  if(lst->len == 0) return 0;
 
-LLUV_INTERNAL int lluv_list_pop_front(lua_State *L, lluv_list_t *lst){
-  int i = lluv_list_pop_(L, lst, lst->first);
-  lst->first += i;
-  return i;
-}
+  n = lst->items[lst->head];
+
+  luaL_checkstack(L, n + 2, "too many arguments");
 
-LLUV_INTERNAL int lluv_list_pop_back(lua_State *L, lluv_list_t *lst){
-  int i = lluv_list_pop_(L, lst, lst->last);
-  lst->last -= i;
-  return i;
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, lst->t);
+  t = lua_gettop(L);
+
+  for(i = 0; i < n; ++i){
+    int slot = ((lst->vhead + i) % lst->vcap) + 1;
+    lua_rawgeti(L, t, slot);
+    lua_pushnil(L);
+    lua_rawseti(L, t, slot);
+  }
+  lua_remove(L, t);
+
+  lst->vhead = (lst->vhead + n) % lst->vcap;
+  lst->vlen -= n;
+  lst->head  = (lst->head + 1) % lst->cap;
+  lst->len  -= 1;
+
+  return n;
 }
 
 LLUV_INTERNAL size_t lluv_list_size(lua_State *L, lluv_list_t *lst){
-  return (size_t)(lst->last - lst->first + 1);
+  return lst->len;
 }
 
 LLUV_INTERNAL int lluv_list_empty(lua_State *L, lluv_list_t *lst){
-  return (lst->first > lst->last)?1:0;
+  return (lst->len == 0)?1:0;
 }
-
@@ -11,22 +11,29 @@
 #ifndef _LLUV_LIST_H_
 #define _LLUV_LIST_H_
 
+/* FIFO queue of value groups (e.g. function with its arguments).
+ * Values stored in ring of slots of single Lua table and
+ * group sizes in C ring buffer. So push/pop does not allocate.
+ */
 typedef struct lluv_list_tag{
-  lua_Integer first;
-  lua_Integer last;
-  int            t;
+  int     t;      /* table with value slots */
+  int     vhead;  /* first used slot */
+  int     vlen;   /* number of used slots */
+  int     vcap;   /* number of slots */
+  int    *items;  /* number of values in each group */
+  size_t  head;
+  size_t  len;
+  size_t  cap;
 } lluv_list_t;
 
 LLUV_INTERNAL void lluv_list_init(lua_State *L, lluv_list_t *lst);
 
 LLUV_INTERNAL void lluv_list_close(lua_State *L, lluv_list_t *lst);
 
-LLUV_INTERNAL void lluv_list_push_back(lua_State *L, lluv_list_t *lst);
-
-LLUV_INTERNAL void lluv_list_push_front(lua_State *L, lluv_list_t *lst);
-
-LLUV_INTERNAL int lluv_list_pop_back(lua_State *L, lluv_list_t *lst);
+/* move `n` values from top of stack as single group */
+LLUV_INTERNAL void lluv_list_push_back(lua_State *L, lluv_list_t *lst, int n);
 
+/* push values of first group and return number of them (0 if list empty) */
 LLUV_INTERNAL int lluv_list_pop_front(lua_State *L, lluv_list_t *lst);
 
 LLUV_INTERNAL size_t lluv_list_size(lua_State *L, lluv_list_t *lst);
@@ -14,6 +14,7 @@
 #include "lluv_handle.h"
 #include "lluv_list.h"
 #include <assert.h>
+#include <string.h>
 
 #ifndef LLUV_DEFER_DEPTH
 #  define LLUV_DEFER_DEPTH 10
@@ -63,6 +64,10 @@ LLUV_INTERNAL lluv_loop_t* lluv_ensure_loop_at(lua_State *L, int idx){
   return loop;
 }
 
+#define LLUV_TASKS_NONE    0
+#define LLUV_TASKS_READY   1
+#define LLUV_TASKS_CLOSING 2
+
 LLUV_INTERNAL int lluv_loop_create(lua_State *L, uv_loop_t *h, lluv_flags_t flags){
   lluv_loop_t *loop = lutil_newudatap(L, lluv_loop_t, LLUV_LOOP);
   loop->L            = L;
@@ -70,7 +75,15 @@ LLUV_INTERNAL int lluv_loop_create(lua_State *L, uv_loop_t *h, lluv_flags_t flag
   loop->handle->data = loop;
   loop->flags        = flags | LLUV_FLAG_OPEN;
   loop->level        = 0;
-  loop->buffer_size  = LLUV_BUFFER_SIZE;
+  memset(&loop->pool, 0, sizeof(loop->pool));
+  loop->pool.limit   = LLUV_BUFFER_POOL_LIMIT;
+  memset(&loop->reqs, 0, sizeof(loop->reqs));
+  loop->reqs.limit   = LLUV_REQ_POOL_LIMIT;
+  loop->prepare_state = LLUV_TASKS_NONE;
+  loop->tasks         = NULL;
+  loop->check_state   = LLUV_TASKS_NONE;
+  loop->check_tasks   = NULL;
+  loop->slack_timers  = NULL;
   lluv_list_init(L, &loop->defer);
 
   lua_pushvalue(L, -1);
@@ -112,28 +125,10 @@ LLUV_INTERNAL void lluv_loop_pushself(lua_State *L, lluv_loop_t *loop){
   assert(loop == lua_touserdata(L, -1));
 }
 
-static int lluv_defer_call(lua_State *L){
-  int i, n = lua_tointeger(L, lua_upvalueindex(1));
-  luaL_checkstack(L, n, "too many arguments");
-
-  assert(lua_isfunction(L, lua_upvalueindex(2)));
-  assert(!lua_isnone(L, lua_upvalueindex(n + 1)));
-
-  for(i = 2; i <= n+1; ++i)lua_pushvalue(L, lua_upvalueindex(i));
-
-  lua_call(L, n - 1, 0);
-  return 0;
-}
-
 LLUV_INTERNAL void lluv_loop_defer_call(lua_State *L, lluv_loop_t *loop, int nargs){
   assert(lua_isfunction(L, -1-nargs));
 
-  luaL_checkstack(L, 1, "too many arguments");
-  lua_pushinteger(L, nargs+1);
-  lua_insert(L, -2-nargs);
-
-  lua_pushcclosure(L, lluv_defer_call, nargs + 2);
-  lluv_list_push_back(L, &loop->defer);
+  lluv_list_push_back(L, &loop->defer, nargs + 1);
 }
 
 LLUV_INTERNAL int lluv_loop_defer_proceed(lua_State *L, lluv_loop_t *loop){
@@ -143,9 +138,9 @@ LLUV_INTERNAL int lluv_loop_defer_proceed(lua_State *L, lluv_loop_t *loop){
     size_t s = lluv_list_size(L, &loop->defer);
     for(; s != 0; --s){
       int err = lluv_list_pop_front(L, &loop->defer);
-      assert(err == 1);
-      assert((top+1) == lua_gettop(L));
-      err = lluv_lua_call(L, 0, 0);
+      assert(err > 0);
+      assert((top+err) == lua_gettop(L));
+      err = lluv_lua_call(L, err - 1, 0);
       assert(top == lua_gettop(L));
       if(err) return err; 
     }
@@ -153,6 +148,324 @@ LLUV_INTERNAL int lluv_loop_defer_proceed(lua_State *L, lluv_loop_t *loop){
   return 0;
 }
 
+//{ Loop tasks
+
+LLUV_INTERNAL void lluv_loop_task_init(lluv_loop_task_t *task, lluv_loop_task_cb cb){
+  task->next = NULL;
+  task->prev = NULL;
+  task->cb   = cb;
+}
+
+LLUV_INTERNAL void lluv_loop_task_cancel(lluv_loop_task_t *task){
+  if(!task->prev) return;
+
+  *task->prev = task->next;
+  if(task->next) task->next->prev = task->prev;
+
+  task->next = NULL;
+  task->prev = NULL;
+}
+
+static void lluv_loop_tasks_push(lluv_loop_task_t **head, lluv_loop_task_t *task){
+  task->next = *head;
+  if(task->next) task->next->prev = &task->next;
+  task->prev = head;
+  *head      = task;
+}
+
+static void lluv_loop_tasks_run(lluv_loop_t *loop, lluv_loop_task_t **head){
+  lua_State        *L = loop->L;
+  lluv_loop_task_t *pending, *task;
+
+  /* tasks queued from callbacks run on next iteration */
+  pending = *head;
+  if(pending) pending->prev = &pending;
+  *head = NULL;
+
+  while((task = pending)){
+    lluv_loop_task_cancel(task);
+    task->cb(L, task);
+    LLUV_CHECK_LOOP_CB_INVARIANT(L);
+  }
+}
+
+static void lluv_loop_on_prepare(uv_prepare_t *arg){
+  lluv_loop_t *loop = (lluv_loop_t*)arg->data;
+  lua_State   *L    = loop->L;
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  lluv_loop_tasks_run(loop, &loop->tasks);
+
+  if(!loop->tasks) uv_prepare_stop(arg);
+
+  lluv_loop_defer_proceed(L, loop);
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+static void lluv_loop_on_check(uv_check_t *arg){
+  lluv_loop_t *loop = (lluv_loop_t*)arg->data;
+  lua_State   *L    = loop->L;
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  lluv_loop_tasks_run(loop, &loop->check_tasks);
+
+  if(!loop->check_tasks) uv_check_stop(arg);
+
+  lluv_loop_defer_proceed(L, loop);
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+static void lluv_loop_on_prepare_close(uv_handle_t *arg){
+  lluv_loop_t *loop = (lluv_loop_t*)arg->data;
+  loop->prepare_state = LLUV_TASKS_NONE;
+}
+
+static void lluv_loop_on_check_close(uv_handle_t *arg){
+  lluv_loop_t *loop = (lluv_loop_t*)arg->data;
+  loop->check_state = LLUV_TASKS_NONE;
+}
+
+static void lluv_loop_internal_close(lluv_loop_t *loop, uv_handle_t *h){
+  if(h == (uv_handle_t*)&loop->prepare){
+    if(loop->prepare_state != LLUV_TASKS_READY) return;
+
+    while(loop->tasks) lluv_loop_task_cancel(loop->tasks);
+
+    loop->prepare_state = LLUV_TASKS_CLOSING;
+    uv_close(h, lluv_loop_on_prepare_close);
+  }
+  else{
+    if(loop->check_state != LLUV_TASKS_READY) return;
+
+    while(loop->check_tasks) lluv_loop_task_cancel(loop->check_tasks);
+
+    loop->check_state = LLUV_TASKS_CLOSING;
+    uv_close(h, lluv_loop_on_check_close);
+  }
+}
+
+LLUV_INTERNAL int lluv_loop_task_queue(lluv_loop_t *loop, lluv_loop_task_t *task){
+  int err;
+
+  if(task->prev) return 0;
+
+  if(loop->prepare_state == LLUV_TASKS_CLOSING) return UV_ECANCELED;
+
+  if(loop->prepare_state == LLUV_TASKS_NONE){
+    err = uv_prepare_init(loop->handle, &loop->prepare);
+    if(err < 0) return err;
+    loop->prepare.data  = loop;
+    loop->prepare_state = LLUV_TASKS_READY;
+  }
+
+  err = uv_prepare_start(&loop->prepare, lluv_loop_on_prepare);
+  if(err < 0) return err;
+
+  lluv_loop_tasks_push(&loop->tasks, task);
+
+  return 0;
+}
+
+LLUV_INTERNAL int lluv_loop_check_task_queue(lluv_loop_t *loop, lluv_loop_task_t *task){
+  int err;
+
+  if(task->prev) return 0;
+
+  if(loop->check_state == LLUV_TASKS_CLOSING) return UV_ECANCELED;
+
+  if(loop->check_state == LLUV_TASKS_NONE){
+    err = uv_check_init(loop->handle, &loop->check);
+    if(err < 0) return err;
+    loop->check.data  = loop;
+    loop->check_state = LLUV_TASKS_READY;
+  }
+
+  err = uv_check_start(&loop->check, lluv_loop_on_check);
+  if(err < 0) return err;
+
+  lluv_loop_tasks_push(&loop->check_tasks, task);
+
+  return 0;
+}
+
+LLUV_INTERNAL int lluv_loop_is_internal_handle(uv_handle_t *h){
+  lluv_loop_t *loop = lluv_loop_byptr(h->loop);
+  return (h == (uv_handle_t*)&loop->prepare) || (h == (uv_handle_t*)&loop->check);
+}
+
+static void lluv_loop_on_walk_count(uv_handle_t* handle, void* arg){
+  if(!lluv_loop_is_internal_handle(handle)) *(size_t*)arg += 1;
+}
+
+//}
+
+//{ Read buffers pool
+
+/* libuv always suggests 64KiB for stream and udp reads
+ * so pool keeps only buffers of LLUV_BUFFER_SIZE.
+ * Smaller requests get pooled buffer, bigger ones bypass pool.
+ */
+
+typedef struct lluv_buffer_header_tag{
+  void   *next;
+  size_t  size;
+}lluv_buffer_header_t;
+
+static void lluv_buffer_pool_trim(lluv_buffer_pool_t *pool, size_t limit){
+  while((pool->retained > limit) && pool->free){
+    lluv_buffer_header_t *hdr = (lluv_buffer_header_t*)pool->free;
+    pool->free      = hdr->next;
+    pool->count    -= 1;
+    pool->retained -= LLUV_BUFFER_SIZE;
+    lluv_free(NULL, hdr);
+  }
+}
+
+LLUV_INTERNAL uv_buf_t lluv_loop_buffer_alloc(lluv_loop_t *loop, size_t size){
+  lluv_buffer_pool_t   *pool = &loop->pool;
+  lluv_buffer_header_t *hdr  = NULL;
+
+  if(size <= LLUV_BUFFER_SIZE){
+    size = LLUV_BUFFER_SIZE;
+    hdr  = (lluv_buffer_header_t*)pool->free;
+    if(hdr){
+      pool->free      = hdr->next;
+      pool->count    -= 1;
+      pool->retained -= size;
+      pool->reuses   += 1;
+    }
+  }
+
+  if(!hdr){
+    hdr = (lluv_buffer_header_t*)lluv_alloc(loop->L, sizeof(lluv_buffer_header_t) + size);
+    if(!hdr) return lluv_buf_init(NULL, 0); /* libuv reports UV_ENOBUFS */
+    pool->allocs += 1;
+  }
+
+  hdr->next = NULL;
+  hdr->size = size;
+  pool->in_use += 1;
+
+  return lluv_buf_init((char*)(hdr + 1), size);
+}
+
+LLUV_INTERNAL void lluv_loop_buffer_free(lluv_loop_t *loop, const uv_buf_t *buf){
+  lluv_buffer_pool_t   *pool = &loop->pool;
+  lluv_buffer_header_t *hdr  = ((lluv_buffer_header_t*)buf->base) - 1;
+
+  assert(pool->in_use > 0);
+  pool->in_use -= 1;
+
+  if((hdr->size == LLUV_BUFFER_SIZE) && (pool->retained + LLUV_BUFFER_SIZE <= pool->limit)){
+    hdr->next       = pool->free;
+    pool->free      = hdr;
+    pool->count    += 1;
+    pool->retained += LLUV_BUFFER_SIZE;
+    return;
+  }
+
+  lluv_free(loop->L, hdr);
+}
+
+static int lluv_loop_buffer_stats(lua_State *L){
+  lluv_loop_t* loop = lluv_check_loop(L, 1, 0);
+  lluv_buffer_pool_t *pool = &loop->pool;
+
+  lua_newtable(L);
+  lutil_pushint64(L, pool->limit);    lua_setfield(L, -2, "limit");
+  lutil_pushint64(L, pool->retained); lua_setfield(L, -2, "retained");
+  lutil_pushint64(L, pool->in_use);   lua_setfield(L, -2, "in_use");
+  lutil_pushint64(L, pool->allocs);   lua_setfield(L, -2, "allocs");
+  lutil_pushint64(L, pool->reuses);   lua_setfield(L, -2, "reuses");
+  lutil_pushint64(L, pool->count);    lua_setfield(L, -2, "free");
+
+  return 1;
+}
+
+static int lluv_loop_buffer_pool_limit(lua_State *L){
+  lluv_loop_t* loop = lluv_check_loop(L, 1, LLUV_FLAG_OPEN);
+
+  if(!lua_isnoneornil(L, 2)){
+    int64_t limit = lutil_checkint64(L, 2);
+    luaL_argcheck(L, limit >= 0, 2, "negative limit");
+    loop->pool.limit = (size_t)limit;
+    lluv_buffer_pool_trim(&loop->pool, loop->pool.limit);
+  }
+
+  lutil_pushint64(L, loop->pool.limit);
+  return 1;
+}
+
+//}
+
+//{ Requests pool
+
+/* idle requests are linked through their first pointer sized word */
+
+static void lluv_req_pool_trim(lluv_req_pool_t *pool, size_t limit){
+  size_t type;
+
+  for(type = 0; type < UV_REQ_TYPE_MAX; ++type){
+    while((pool->count[type] > limit) && pool->free[type]){
+      void *ptr = pool->free[type];
+      pool->free[type]   = *(void**)ptr;
+      pool->count[type] -= 1;
+      lluv_free(NULL, ptr);
+    }
+  }
+}
+
+LLUV_INTERNAL void* lluv_loop_req_alloc(lluv_loop_t *loop, uv_req_type type, size_t size){
+  lluv_req_pool_t *pool = &loop->reqs;
+  void *ptr = pool->free[type];
+
+  if(ptr){
+    pool->free[type]   = *(void**)ptr;
+    pool->count[type] -= 1;
+    pool->reuses      += 1;
+    return ptr;
+  }
+
+  pool->allocs += 1;
+  return lluv_alloc(loop->L, size);
+}
+
+LLUV_INTERNAL void lluv_loop_req_free(lluv_loop_t *loop, uv_req_type type, void *ptr){
+  lluv_req_pool_t *pool = &loop->reqs;
+
+  if(pool->count[type] < pool->limit){
+    *(void**)ptr       = pool->free[type];
+    pool->free[type]   = ptr;
+    pool->count[type] += 1;
+    return;
+  }
+
+  lluv_free(loop->L, ptr);
+}
+
+static int lluv_loop_req_stats(lua_State *L){
+  lluv_loop_t* loop = lluv_check_loop(L, 1, 0);
+  lluv_req_pool_t *pool = &loop->reqs;
+  size_t type, idle = 0;
+
+  for(type = 0; type < UV_REQ_TYPE_MAX; ++type)
+    idle += pool->count[type];
+
+  lua_newtable(L);
+  lutil_pushint64(L, pool->limit);  lua_setfield(L, -2, "limit");
+  lutil_pushint64(L, idle);         lua_setfield(L, -2, "idle");
+  lutil_pushint64(L, pool->allocs); lua_setfield(L, -2, "allocs");
+  lutil_pushint64(L, pool->reuses); lua_setfield(L, -2, "reuses");
+
+  return 1;
+}
+
+//}
+
 static int lluv_loop_new_impl(lua_State *L, lluv_flags_t flags){
   uv_loop_t *loop = lluv_alloc_t(L, uv_loop_t);
   int err = uv_loop_init(loop);
@@ -180,6 +493,11 @@ static void lluv_loop_on_walk_close(uv_handle_t* handle, void* arg){
    /* in any case we should call uv_run for this handle */
   ctx->count += 1;
 
+  if(lluv_loop_is_internal_handle(handle)){
+    lluv_loop_internal_close(lluv_loop_byptr(handle->loop), handle);
+    return;
+  }
+
   LLUV_CHECK_LOOP_CB_INVARIANT(L);
 
   if(uv_is_closing(handle)){
@@ -188,12 +506,9 @@ static void lluv_loop_on_walk_close(uv_handle_t* handle, void* arg){
 
   lluv_handle_pushself(L, lluv_handle_byptr(handle));
   if(lua_isnil(L, -1)){
-    /* This handle create some one else or
-     * someone corrupt registry
-     * but still we need close it
-     */
+    /* Lua object already unreachable and waits its finalizer */
     lua_pop(L, 1);
-    uv_close(handle, NULL);
+    lluv_handle_close_unreachable(lluv_handle_byptr(handle));
     return;
   }
 
@@ -271,6 +586,13 @@ static int lluv_loop_close_impl(lua_State *L, int ignore_error, int close_handle
     close_handle = lua_toboolean(L, 2);
   }
 
+  if((!close_handle) && ((loop->prepare_state != LLUV_TASKS_NONE) || (loop->check_state != LLUV_TASKS_NONE))){
+    /* internal handles are closed only if there no user handles */
+    size_t count = 0;
+    uv_walk(loop->handle, lluv_loop_on_walk_count, &count);
+    close_handle = (count == 0);
+  }
+
   if(close_handle){
     int ret = lluv_loop_close_all_handles(L);
     if(!ignore_error){
@@ -302,6 +624,12 @@ static int lluv_loop_close_impl(lua_State *L, int ignore_error, int close_handle
 
   loop->handle = NULL;
   lluv_list_close(L, &loop->defer);
+
+  loop->pool.limit = 0;
+  lluv_buffer_pool_trim(&loop->pool, 0);
+
+  loop->reqs.limit = 0;
+  lluv_req_pool_trim(&loop->reqs, 0);
   return 0;
 }
 
@@ -468,8 +796,15 @@ static int lluv_loop_defer(lua_State *L){
 static void lluv_loop_on_walk(uv_handle_t* handle, void* arg){
   lua_State *L = (lua_State*)arg;
 
+  if(lluv_loop_is_internal_handle(handle)) return;
+
   lua_settop(L, 2); lua_pushvalue(L, -1);
   lluv_handle_pushself(L, lluv_handle_byptr(handle));
+  /* handle already unreachable and waits for its finalizer */
+  if(lua_isnil(L, -1)){
+    lua_pop(L, 2);
+    return;
+  }
   lua_call(L, 1, 0);
 }
 
@@ -479,8 +814,11 @@ static void lluv_loop_on_collect(uv_handle_t* handle, void* arg){
   assert(lua_gettop(L) == 2);
   assert(lua_istable(L, 2));
 
+  if(lluv_loop_is_internal_handle(handle)) return;
+
   lluv_handle_pushself(L, lluv_handle_byptr(handle));
-  lua_rawseti(L, 2, lua_rawlen(L, 2) + 1);
+  if(lua_isnil(L, -1)) lua_pop(L, 1);
+  else lua_rawseti(L, 2, lua_rawlen(L, 2) + 1);
 
   assert(lua_gettop(L) == 2);
 }
@@ -520,7 +858,10 @@ static const struct luaL_Reg lluv_loop_methods[] = {
   { "fileno",       lluv_loop_fileno       },
   { "poll_timeout", lluv_loop_poll_timeout },
   { "update_time",  lluv_loop_update_time  },
-  
+  { "buffer_stats", lluv_loop_buffer_stats },
+
+  { "buffer_pool_limit", lluv_loop_buffer_pool_limit },
+  { "req_stats",         lluv_loop_req_stats         },
   { "close_all_handles", lluv_loop_close_all_handles },
 
   {NULL,NULL}
@@ -20,14 +20,59 @@
 
 #define LLUV_BUFFER_SIZE 65536
 
+#ifndef LLUV_BUFFER_POOL_LIMIT
+#  define LLUV_BUFFER_POOL_LIMIT (16 * LLUV_BUFFER_SIZE)
+#endif
+
+typedef struct lluv_buffer_pool_tag{
+  void        *free;     /* idle LLUV_BUFFER_SIZE buffers */
+  size_t       count;    /* number of idle buffers */
+  size_t       retained; /* bytes kept in free lists */
+  size_t       limit;    /* max bytes kept in free lists */
+  size_t       in_use;   /* buffers owned by libuv or callbacks */
+  size_t       allocs;   /* buffers allocated from heap */
+  size_t       reuses;   /* buffers taken from free lists */
+}lluv_buffer_pool_t;
+
+/* max number of idle requests kept per request type */
+#ifndef LLUV_REQ_POOL_LIMIT
+#  define LLUV_REQ_POOL_LIMIT 256
+#endif
+
+typedef struct lluv_req_pool_tag{
+  void        *free[UV_REQ_TYPE_MAX];
+  size_t       count[UV_REQ_TYPE_MAX];
+  size_t       limit;    /* max number of idle requests per type */
+  size_t       allocs;   /* requests allocated from heap */
+  size_t       reuses;   /* requests taken from free lists */
+}lluv_req_pool_t;
+
+typedef struct lluv_loop_task_tag lluv_loop_task_t;
+
+typedef void (*lluv_loop_task_cb)(lua_State *L, lluv_loop_task_t *task);
+
+/* Task queued to run once before (prepare) or after (check) loop polls for I/O */
+struct lluv_loop_task_tag{
+  lluv_loop_task_t  *next;
+  lluv_loop_task_t **prev; /* NULL if task not queued */
+  lluv_loop_task_cb  cb;
+};
+
 typedef struct lluv_loop_tag{
   uv_loop_t   *handle;/* read only */
   lluv_flags_t flags; /* read only */
   lua_State   *L;
   lluv_list_t  defer;
   int8_t       level;
-  size_t       buffer_size;
-  char         buffer[LLUV_BUFFER_SIZE];
+  lluv_buffer_pool_t pool;
+  lluv_req_pool_t    reqs;
+  uv_prepare_t       prepare; /* internal handle to proceed tasks */
+  int8_t             prepare_state;
+  lluv_loop_task_t  *tasks;
+  uv_check_t         check;   /* internal handle to proceed tasks after I/O */
+  int8_t             check_state;
+  lluv_loop_task_t  *check_tasks;
+  struct lluv_timer_slack_tag *slack_timers; /* coalesced timer groups */
 }lluv_loop_t;
 
 LLUV_INTERNAL void lluv_loop_initlib(lua_State *L, int nup);
@@ -56,6 +101,24 @@ LLUV_INTERNAL void lluv_loop_defer_call(lua_State *L, lluv_loop_t *loop, int nar
 
 LLUV_INTERNAL int lluv_loop_defer_proceed(lua_State *L, lluv_loop_t *loop);
 
+LLUV_INTERNAL uv_buf_t lluv_loop_buffer_alloc(lluv_loop_t *loop, size_t size);
+
+LLUV_INTERNAL void lluv_loop_buffer_free(lluv_loop_t *loop, const uv_buf_t *buf);
+
+LLUV_INTERNAL void lluv_loop_task_init(lluv_loop_task_t *task, lluv_loop_task_cb cb);
+
+LLUV_INTERNAL int lluv_loop_task_queue(lluv_loop_t *loop, lluv_loop_task_t *task);
+
+LLUV_INTERNAL int lluv_loop_check_task_queue(lluv_loop_t *loop, lluv_loop_task_t *task);
+
+LLUV_INTERNAL void lluv_loop_task_cancel(lluv_loop_task_t *task);
+
+LLUV_INTERNAL int lluv_loop_is_internal_handle(uv_handle_t *h);
+
+LLUV_INTERNAL void* lluv_loop_req_alloc(lluv_loop_t *loop, uv_req_type type, size_t size);
+
+LLUV_INTERNAL void lluv_loop_req_free(lluv_loop_t *loop, uv_req_type type, void *ptr);
+
 #define LLUV_CHECK_LOOP_CB_INVARIANT(L) \
   assert("Some one use invalid callback handler" && (lua_gettop(L) == LLUV_CALLBACK_TOP_SIZE)); \
   assert("Invalid number of upvalues" && (lua_isnone(L, LLUV_NONE_MARK_INDEX)));                \
@@ -20,10 +20,6 @@
 #define LLUV_PIPE_NAME LLUV_PREFIX" Pipe"
 static const char *LLUV_PIPE = LLUV_PIPE_NAME;
 
-LLUV_INTERNAL int lluv_pipe_index(lua_State *L){
-  return lluv__index(L, LLUV_PIPE, lluv_stream_index);
-}
-
 LLUV_IMPL_SAFE_(lluv_pipe_create){
   lluv_loop_t *loop  = lluv_opt_loop(L, 1, LLUV_FLAG_OPEN);
   int ipc = lua_toboolean(L, loop ? 2 : 1);
@@ -262,6 +258,7 @@ LLUV_INTERNAL void lluv_pipe_initlib(lua_State *L, int nup, int safe){
   if(!lutil_createmetap(L, LLUV_PIPE, lluv_pipe_methods, nup))
     lua_pop(L, nup);
   lua_pop(L, 1);
+  lluv_stream_createmeta(L, nup, UV_NAMED_PIPE, LLUV_PIPE);
 
   luaL_setfuncs(L, lluv_functions[safe], nup);
 }
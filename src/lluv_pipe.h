@@ -13,8 +13,6 @@
 
 LLUV_INTERNAL void lluv_pipe_initlib(lua_State *L, int nup, int safe);
 
-LLUV_INTERNAL int lluv_pipe_index(lua_State *L);
-
 LLUV_INTERNAL int lluv_pipe_create_safe(lua_State *L);
 
 LLUV_INTERNAL int lluv_pipe_create_unsafe(lua_State *L);
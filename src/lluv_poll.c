@@ -18,10 +18,6 @@
 #define LLUV_POLL_NAME LLUV_PREFIX" Poll"
 static const char *LLUV_POLL = LLUV_POLL_NAME;
 
-LLUV_INTERNAL int lluv_poll_index(lua_State *L){
-  return lluv__index(L, LLUV_POLL, lluv_handle_index);
-}
-
 LLUV_IMPL_SAFE(lluv_poll_create){
   lluv_loop_t *loop  = lluv_opt_loop(L, 1, LLUV_FLAG_OPEN);
   int fd = luaL_checkint(L, loop ? 2 : 1);
@@ -71,7 +67,7 @@ static void lluv_on_poll_start(uv_poll_t *arg, int status, int events){
   assert(!lua_isnil(L, -1)); /* is callble */
 
   lluv_handle_pushself(L, handle);
-  lluv_push_status(L, status);
+  lluv_push_status_ex(L, handle->flags, status);
   lua_pushinteger(L, events);
 
   LLUV_HANDLE_CALL_CB(L, handle, 3);
@@ -161,6 +157,7 @@ LLUV_INTERNAL void lluv_poll_initlib(lua_State *L, int nup, int safe){
   if(!lutil_createmetap(L, LLUV_POLL, lluv_poll_methods, nup))
     lua_pop(L, nup);
   lua_pop(L, 1);
+  lluv_handle_createmeta(L, nup, UV_POLL, LLUV_POLL, NULL);
 
   luaL_setfuncs(L, lluv_poll_functions[safe], nup);
   lluv_register_constants(L, lluv_poll_constants);
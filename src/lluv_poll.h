@@ -13,6 +13,4 @@
 
 LLUV_INTERNAL void lluv_poll_initlib(lua_State *L, int nup, int safe);
 
-LLUV_INTERNAL int lluv_poll_index(lua_State *L);
-
 #endif
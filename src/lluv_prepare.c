@@ -18,10 +18,6 @@
 #define LLUV_PREPARE_NAME LLUV_PREFIX" Prepare"
 static const char *LLUV_PREPARE = LLUV_PREPARE_NAME;
 
-LLUV_INTERNAL int lluv_prepare_index(lua_State *L){
-  return lluv__index(L, LLUV_PREPARE, lluv_handle_index);
-}
-
 LLUV_IMPL_SAFE(lluv_prepare_create){
   lluv_loop_t   *loop   = lluv_opt_loop_ex(L, 1, LLUV_FLAG_OPEN);
   lluv_handle_t *handle = lluv_handle_create(L, UV_PREPARE, safe_flag | INHERITE_FLAGS(loop));
@@ -99,6 +95,7 @@ LLUV_INTERNAL void lluv_prepare_initlib(lua_State *L, int nup, int safe){
   if(!lutil_createmetap(L, LLUV_PREPARE, lluv_prepare_methods, nup))
     lua_pop(L, nup);
   lua_pop(L, 1);
+  lluv_handle_createmeta(L, nup, UV_PREPARE, LLUV_PREPARE, NULL);
 
   luaL_setfuncs(L, lluv_functions[safe], nup);
 }
@@ -13,6 +13,4 @@
 
 LLUV_INTERNAL void lluv_prepare_initlib(lua_State *L, int nup, int safe);
 
-LLUV_INTERNAL int lluv_prepare_index(lua_State *L);
-
 #endif
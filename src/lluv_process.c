@@ -455,10 +455,6 @@ static int lluv_fill_process_options_(lua_State *L){
   return 1;
 }
 
-LLUV_INTERNAL int lluv_process_index(lua_State *L){
-  return lluv__index(L, LLUV_PROCESS, lluv_handle_index);
-}
-
 static lluv_handle_t* lluv_check_process(lua_State *L, int idx, lluv_flags_t flags){
   lluv_handle_t *handle = lluv_check_handle(L, idx, flags);
   luaL_argcheck (L, LLUV_H(handle, uv_handle_t)->type == UV_PROCESS, idx, LLUV_PROCESS_NAME" expected");
@@ -609,6 +605,7 @@ LLUV_INTERNAL void lluv_process_initlib(lua_State *L, int nup, int safe){
   if(!lutil_createmetap(L, LLUV_PROCESS, lluv_process_methods, nup))
     lua_pop(L, nup);
   lua_pop(L, 1);
+  lluv_handle_createmeta(L, nup, UV_PROCESS, LLUV_PROCESS, NULL);
 
   lutil_pushnvalues(L, nup);
   if(!lutil_createmetap(L, LLUV_OS_HANDLE, lluv_os_handle_methods, nup))
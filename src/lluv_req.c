@@ -10,16 +10,28 @@
 
 #include "lluv.h"
 #include "lluv_req.h"
+#include "lluv_loop.h"
 #include <assert.h>
 
 
 LLUV_INTERNAL lluv_req_t* lluv_req_new(lua_State *L, uv_req_type type, lluv_handle_t *h){
-  size_t extra_size = uv_req_size(type) - sizeof(uv_req_t);
-  lluv_req_t *req = (lluv_req_t*)lluv_alloc(L, sizeof(lluv_req_t) + extra_size);
+  size_t size = sizeof(lluv_req_t) + uv_req_size(type) - sizeof(uv_req_t);
+  lluv_req_t *req;
+
+  /* requests bound to handle are reused via loop pool */
+  if(h) req = (lluv_req_t*)lluv_loop_req_alloc(lluv_loop_by_handle(&h->handle), type, size);
+  else  req = (lluv_req_t*)lluv_alloc(L, size);
 
   req->req.data = req;
   req->handle   = h;
-  req->cb       = luaL_ref(L, LLUV_LUA_REGISTRY);
+  req->type     = type;
+  if(lua_isnil(L, -1)){
+    lua_pop(L, 1);
+    req->cb = LUA_NOREF;
+  }
+  else{
+    req->cb = luaL_ref(L, LLUV_LUA_REGISTRY);
+  }
   req->arg      = LUA_NOREF;
   req->ctx      = LUA_NOREF;
 
@@ -29,13 +41,19 @@ LLUV_INTERNAL lluv_req_t* lluv_req_new(lua_State *L, uv_req_type type, lluv_hand
 }
 
 LLUV_INTERNAL void lluv_req_free(lua_State *L, lluv_req_t *req){
-  luaL_unref(L, LLUV_LUA_REGISTRY, req->cb);
-  luaL_unref(L, LLUV_LUA_REGISTRY, req->arg);
-  luaL_unref(L, LLUV_LUA_REGISTRY, req->ctx);
-  if(req->handle){
-    lluv_handle_unlock(L, req->handle, LLUV_LOCK_REQ);
+  lluv_handle_t *h = req->handle;
+
+  if(req->cb  != LUA_NOREF) luaL_unref(L, LLUV_LUA_REGISTRY, req->cb);
+  if(req->arg != LUA_NOREF) luaL_unref(L, LLUV_LUA_REGISTRY, req->arg);
+  if(req->ctx != LUA_NOREF) luaL_unref(L, LLUV_LUA_REGISTRY, req->ctx);
+
+  if(h){
+    lluv_loop_req_free(lluv_loop_by_handle(&h->handle), req->type, req);
+    lluv_handle_unlock(L, h, LLUV_LOCK_REQ);
+  }
+  else{
+    lluv_free(L, req);
   }
-  lluv_free(L, req);
 }
 
 LLUV_INTERNAL lluv_req_t* lluv_req_byptr(uv_req_t *r){
@@ -46,20 +64,15 @@ LLUV_INTERNAL lluv_req_t* lluv_req_byptr(uv_req_t *r){
 }
 
 LLUV_INTERNAL void lluv_req_ref(lua_State *L, lluv_req_t *req){
-  luaL_unref(L, LLUV_LUA_REGISTRY, req->arg);
+  if(req->arg != LUA_NOREF) luaL_unref(L, LLUV_LUA_REGISTRY, req->arg);
   req->arg = luaL_ref(L, LLUV_LUA_REGISTRY);
 }
 
 LLUV_INTERNAL void lluv_req_ref_ctx(lua_State *L, lluv_req_t *req){
-  luaL_unref(L, LLUV_LUA_REGISTRY, req->ctx);
+  if(req->ctx != LUA_NOREF) luaL_unref(L, LLUV_LUA_REGISTRY, req->ctx);
   req->ctx = luaL_ref(L, LLUV_LUA_REGISTRY);
 }
 
 LLUV_INTERNAL int lluv_req_has_cb(lua_State *L, lluv_req_t *req){
-  int res;
-  lua_rawgeti(L, LLUV_LUA_REGISTRY, req->cb);
-  res = lua_isnil(L, -1);
-  lua_pop(L, 1);
-
-  return res;
+  return req->cb != LUA_NOREF;
 }
\ No newline at end of file
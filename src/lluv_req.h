@@ -19,6 +19,7 @@ typedef struct lluv_req_tag{
   int           cb;
   int           arg;
   int           ctx;
+  uv_req_type   type;
   uv_req_t      req;
 } lluv_req_t;
 
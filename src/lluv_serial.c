@@ -0,0 +1,392 @@
+/******************************************************************************
+* Author: Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Copyright (C) 2014-2016 Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Licensed according to the included 'LICENSE' document
+*
+* This file is part of lua-lluv library.
+******************************************************************************/
+
+#include "lluv.h"
+#include "lluv_utils.h"
+#include "lluv_serial.h"
+#include "lluv_async.h"
+#include <assert.h>
+#include <string.h>
+
+#define LLUV_SERIAL_NIL     0
+#define LLUV_SERIAL_FALSE   1
+#define LLUV_SERIAL_TRUE    2
+#define LLUV_SERIAL_INTEGER 3
+#define LLUV_SERIAL_NUMBER  4
+#define LLUV_SERIAL_STRING  5
+#define LLUV_SERIAL_TABLE   6
+#define LLUV_SERIAL_END     7
+#define LLUV_SERIAL_CHANNEL 8
+
+#define LLUV_SERIAL_MAX_DEPTH 64
+
+//{ Buffer
+
+LLUV_INTERNAL void lluv_sbuf_init(lluv_sbuf_t *buf){
+  buf->data = NULL;
+  buf->size = buf->cap = 0;
+}
+
+LLUV_INTERNAL void lluv_sbuf_free(lluv_sbuf_t *buf){
+  if(buf->data) lluv_free(NULL, buf->data);
+  lluv_sbuf_init(buf);
+}
+
+static int lluv_sbuf_reserve(lluv_sbuf_t *buf, size_t size){
+  size_t cap = buf->cap ? buf->cap : 64;
+  char *data;
+
+  if(buf->cap - buf->size >= size) return 0;
+
+  while(cap - buf->size < size){
+    if(cap * 2 < cap) return UV_ENOMEM;
+    cap *= 2;
+  }
+
+  data = (char*)lluv_alloc(NULL, cap);
+  if(!data) return UV_ENOMEM;
+
+  if(buf->data){
+    memcpy(data, buf->data, buf->size);
+    lluv_free(NULL, buf->data);
+  }
+
+  buf->data = data;
+  buf->cap  = cap;
+  return 0;
+}
+
+LLUV_INTERNAL int lluv_sbuf_append(lluv_sbuf_t *buf, const void *data, size_t size){
+  int err = lluv_sbuf_reserve(buf, size);
+  if(err < 0) return err;
+
+  memcpy(buf->data + buf->size, data, size);
+  buf->size += size;
+  return 0;
+}
+
+static int lluv_sbuf_append_byte(lluv_sbuf_t *buf, unsigned char c){
+  return lluv_sbuf_append(buf, &c, 1);
+}
+
+static int lluv_sbuf_append_varint(lluv_sbuf_t *buf, uint64_t v){
+  unsigned char tmp[10]; size_t n = 0;
+  do{
+    tmp[n] = (unsigned char)(v & 0x7F);
+    v >>= 7;
+    if(v) tmp[n] |= 0x80;
+    ++n;
+  }while(v);
+  return lluv_sbuf_append(buf, tmp, n);
+}
+
+//}
+
+//{ Encode
+
+static const char *LLUV_SERIAL_ERR_TYPE  = "can not serialize value of unsupported type";
+static const char *LLUV_SERIAL_ERR_DEPTH = "too deep nested tables (or table with cycles)";
+static const char *LLUV_SERIAL_ERR_MEM   = "not enough memory";
+
+static int lluv_serial_encode_value(lua_State *L, int idx, lluv_sbuf_t *buf, int depth, const char **msg){
+  int err = 0;
+
+  switch(lua_type(L, idx)){
+    case LUA_TNIL:
+      err = lluv_sbuf_append_byte(buf, LLUV_SERIAL_NIL);
+      break;
+
+    case LUA_TBOOLEAN:
+      err = lluv_sbuf_append_byte(buf, lua_toboolean(L, idx) ? LLUV_SERIAL_TRUE : LLUV_SERIAL_FALSE);
+      break;
+
+    case LUA_TNUMBER:
+#if LUA_VERSION_NUM >= 503
+      if(lua_isinteger(L, idx)){
+        int64_t v = (int64_t)lua_tointeger(L, idx);
+        err = lluv_sbuf_append_byte(buf, LLUV_SERIAL_INTEGER);
+        if(!err) err = lluv_sbuf_append(buf, &v, sizeof(v));
+        break;
+      }
+#endif
+      {
+        double v = (double)lua_tonumber(L, idx);
+        err = lluv_sbuf_append_byte(buf, LLUV_SERIAL_NUMBER);
+        if(!err) err = lluv_sbuf_append(buf, &v, sizeof(v));
+      }
+      break;
+
+    case LUA_TSTRING:{
+      size_t len; const char *str = lua_tolstring(L, idx, &len);
+      err = lluv_sbuf_append_byte(buf, LLUV_SERIAL_STRING);
+      if(!err) err = lluv_sbuf_append_varint(buf, len);
+      if(!err) err = lluv_sbuf_append(buf, str, len);
+      break;
+    }
+
+    case LUA_TTABLE:
+      if(depth >= LLUV_SERIAL_MAX_DEPTH){
+        *msg = LLUV_SERIAL_ERR_DEPTH;
+        return UV_EINVAL;
+      }
+
+      if(!lua_checkstack(L, 3)){
+        *msg = LLUV_SERIAL_ERR_MEM;
+        return UV_ENOMEM;
+      }
+
+      idx = lua_absindex(L, idx);
+      err = lluv_sbuf_append_byte(buf, LLUV_SERIAL_TABLE);
+      if(err) break;
+
+      lua_pushnil(L);
+      while(lua_next(L, idx)){
+        err = lluv_serial_encode_value(L, -2, buf, depth + 1, msg);
+        if(!err) err = lluv_serial_encode_value(L, -1, buf, depth + 1, msg);
+        lua_pop(L, 1);
+        if(err){
+          lua_pop(L, 1);
+          return err;
+        }
+      }
+
+      err = lluv_sbuf_append_byte(buf, LLUV_SERIAL_END);
+      break;
+
+    case LUA_TUSERDATA:{
+      void *ch = lluv_channel_serial_ref(L, idx);
+      if(ch){
+        err = lluv_sbuf_append_byte(buf, LLUV_SERIAL_CHANNEL);
+        if(!err) err = lluv_sbuf_append(buf, &ch, sizeof(ch));
+        if(err) lluv_channel_serial_release(ch);
+        break;
+      }
+    }
+    /* fallthrough */
+
+    default:
+      *msg = LLUV_SERIAL_ERR_TYPE;
+      return UV_EINVAL;
+  }
+
+  if(err < 0) *msg = LLUV_SERIAL_ERR_MEM;
+  return err;
+}
+
+LLUV_INTERNAL int lluv_serial_encode(lua_State *L, int first, int last, lluv_sbuf_t *buf, const char **msg){
+  int i, err;
+
+  if(first < 0) first = lua_absindex(L, first);
+  if(last  < 0) last  = lua_absindex(L, last);
+
+  err = lluv_sbuf_append_varint(buf, (last >= first) ? (last - first + 1) : 0);
+  if(err < 0){
+    *msg = LLUV_SERIAL_ERR_MEM;
+    return err;
+  }
+
+  for(i = first; i <= last; ++i){
+    err = lluv_serial_encode_value(L, i, buf, 0, msg);
+    if(err < 0) return err;
+  }
+
+  return 0;
+}
+
+//}
+
+//{ Decode
+
+typedef struct lluv_serial_reader_tag{
+  const unsigned char *p;
+  const unsigned char *e;
+} lluv_serial_reader_t;
+
+static int lluv_serial_read_varint(lluv_serial_reader_t *r, uint64_t *v){
+  int shift = 0;
+  *v = 0;
+  while(r->p < r->e){
+    unsigned char c = *r->p++;
+    if(shift > 63) return -1;
+    *v |= (uint64_t)(c & 0x7F) << shift;
+    if(!(c & 0x80)) return 0;
+    shift += 7;
+  }
+  return -1;
+}
+
+static int lluv_serial_decode_value(lua_State *L, lluv_serial_reader_t *r, int depth){
+  unsigned char tag;
+
+  if(r->p >= r->e) return -1;
+  if(!lua_checkstack(L, 3)) return -1;
+
+  tag = *r->p++;
+  switch(tag){
+    case LLUV_SERIAL_NIL:   lua_pushnil(L);        return 0;
+    case LLUV_SERIAL_FALSE: lua_pushboolean(L, 0); return 0;
+    case LLUV_SERIAL_TRUE:  lua_pushboolean(L, 1); return 0;
+
+    case LLUV_SERIAL_INTEGER:{
+      int64_t v;
+      if((size_t)(r->e - r->p) < sizeof(v)) return -1;
+      memcpy(&v, r->p, sizeof(v)); r->p += sizeof(v);
+#if LUA_VERSION_NUM >= 503
+      lua_pushinteger(L, (lua_Integer)v);
+#else
+      lua_pushnumber(L, (lua_Number)v);
+#endif
+      return 0;
+    }
+
+    case LLUV_SERIAL_NUMBER:{
+      double v;
+      if((size_t)(r->e - r->p) < sizeof(v)) return -1;
+      memcpy(&v, r->p, sizeof(v)); r->p += sizeof(v);
+      lua_pushnumber(L, (lua_Number)v);
+      return 0;
+    }
+
+    case LLUV_SERIAL_STRING:{
+      uint64_t len;
+      if(lluv_serial_read_varint(r, &len)) return -1;
+      if((uint64_t)(r->e - r->p) < len) return -1;
+      lua_pushlstring(L, (const char*)r->p, (size_t)len);
+      r->p += len;
+      return 0;
+    }
+
+    case LLUV_SERIAL_CHANNEL:{
+      void *ch;
+      if((size_t)(r->e - r->p) < sizeof(ch)) return -1;
+      memcpy(&ch, r->p, sizeof(ch)); r->p += sizeof(ch);
+      lluv_channel_serial_push(L, ch);
+      return 0;
+    }
+
+    case LLUV_SERIAL_TABLE:
+      if(depth >= LLUV_SERIAL_MAX_DEPTH) return -1;
+      lua_newtable(L);
+      for(;;){
+        if(r->p >= r->e) return -1;
+        if(*r->p == LLUV_SERIAL_END){
+          r->p++;
+          return 0;
+        }
+        if(lluv_serial_decode_value(L, r, depth + 1)) return -1;
+        if(lua_isnil(L, -1)) return -1;
+        if(lluv_serial_decode_value(L, r, depth + 1)) return -1;
+        lua_rawset(L, -3);
+      }
+  }
+
+  return -1;
+}
+
+LLUV_INTERNAL int lluv_serial_decode(lua_State *L, const char *data, size_t size){
+  int top = lua_gettop(L);
+  lluv_serial_reader_t r;
+  uint64_t i, n;
+
+  r.p = (const unsigned char*)data;
+  r.e = r.p + size;
+
+  if(lluv_serial_read_varint(&r, &n) || (n > (uint64_t)size) || !lua_checkstack(L, (int)n + 1)) return -1;
+
+  for(i = 0; i < n; ++i){
+    if(lluv_serial_decode_value(L, &r, 0)){
+      lua_settop(L, top);
+      return -1;
+    }
+  }
+
+  return (int)n;
+}
+
+/* values are stored in prefix order so it possible
+ * just scan buffer without nesting
+ */
+LLUV_INTERNAL void lluv_serial_release(const char *data, size_t size){
+  lluv_serial_reader_t r;
+  uint64_t n;
+
+  r.p = (const unsigned char*)data;
+  r.e = r.p + size;
+
+  if(lluv_serial_read_varint(&r, &n)) return;
+
+  while(r.p < r.e){
+    switch(*r.p++){
+      case LLUV_SERIAL_NIL:
+      case LLUV_SERIAL_FALSE:
+      case LLUV_SERIAL_TRUE:
+      case LLUV_SERIAL_TABLE:
+      case LLUV_SERIAL_END:
+        break;
+
+      case LLUV_SERIAL_INTEGER:
+      case LLUV_SERIAL_NUMBER:
+        if((size_t)(r.e - r.p) < 8) return;
+        r.p += 8;
+        break;
+
+      case LLUV_SERIAL_STRING:{
+        uint64_t len;
+        if(lluv_serial_read_varint(&r, &len)) return;
+        if((uint64_t)(r.e - r.p) < len) return;
+        r.p += len;
+        break;
+      }
+
+      case LLUV_SERIAL_CHANNEL:{
+        void *ch;
+        if((size_t)(r.e - r.p) < sizeof(ch)) return;
+        memcpy(&ch, r.p, sizeof(ch)); r.p += sizeof(ch);
+        lluv_channel_serial_release(ch);
+        break;
+      }
+
+      default:
+        return;
+    }
+  }
+}
+
+//}
+
+//{ Code
+
+static int lluv_serial_code_writer(lua_State *L, const void *p, size_t sz, void *ud){
+  (void)L;
+  return lluv_sbuf_append((lluv_sbuf_t*)ud, p, sz) ? 1 : 0;
+}
+
+LLUV_INTERNAL int lluv_serial_code(lua_State *L, int idx, lluv_sbuf_t *buf){
+  int err;
+
+  if(lua_type(L, idx) == LUA_TSTRING){
+    size_t len; const char *code = lua_tolstring(L, idx, &len);
+    return lluv_sbuf_append(buf, code, len);
+  }
+
+  if(lua_type(L, idx) != LUA_TFUNCTION) return UV_EINVAL;
+
+  lua_pushvalue(L, idx);
+#if LUA_VERSION_NUM >= 503
+  err = lua_dump(L, lluv_serial_code_writer, buf, 0);
+#else
+  err = lua_dump(L, lluv_serial_code_writer, buf);
+#endif
+  lua_pop(L, 1);
+
+  return err ? UV_EINVAL : 0;
+}
+
+//}
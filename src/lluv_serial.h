@@ -0,0 +1,53 @@
+/******************************************************************************
+* Author: Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Copyright (C) 2014-2016 Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Licensed according to the included 'LICENSE' document
+*
+* This file is part of lua-lluv library.
+******************************************************************************/
+
+#ifndef _LLUV_SERIAL_H_
+#define _LLUV_SERIAL_H_
+
+#include "lluv.h"
+
+/* Compact binary serializer to pass values between Lua states.
+ * Supports nil, boolean, number, string, channels and tables of them.
+ * Buffers allocated with lluv_alloc so they can be passed
+ * between threads.
+ *
+ * Serialized channel holds reference to it. So each buffer have to be
+ * decoded exactly once or released with `lluv_serial_release`.
+ */
+
+typedef struct lluv_sbuf_tag{
+  char   *data;
+  size_t  size;
+  size_t  cap;
+} lluv_sbuf_t;
+
+LLUV_INTERNAL void lluv_sbuf_init(lluv_sbuf_t *buf);
+
+LLUV_INTERNAL void lluv_sbuf_free(lluv_sbuf_t *buf);
+
+LLUV_INTERNAL int lluv_sbuf_append(lluv_sbuf_t *buf, const void *data, size_t size);
+
+/* serialize values from `first` to `last` stack index.
+ * returns 0 or error code and sets static error message
+ */
+LLUV_INTERNAL int lluv_serial_encode(lua_State *L, int first, int last, lluv_sbuf_t *buf, const char **msg);
+
+/* push deserialized values and returns number of them or -1 if data malformed */
+LLUV_INTERNAL int lluv_serial_decode(lua_State *L, const char *data, size_t size);
+
+/* release references stored in data which will never be decoded */
+LLUV_INTERNAL void lluv_serial_release(const char *data, size_t size);
+
+/* put Lua chunk to buffer. Value at `idx` can be string or function
+ * which will be dumped. Returns 0 or error code.
+ */
+LLUV_INTERNAL int lluv_serial_code(lua_State *L, int idx, lluv_sbuf_t *buf);
+
+#endif
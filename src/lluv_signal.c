@@ -24,10 +24,6 @@
 #define LLUV_SIGNAL_NAME LLUV_PREFIX" Signal"
 static const char *LLUV_SIGNAL = LLUV_SIGNAL_NAME;
 
-LLUV_INTERNAL int lluv_signal_index(lua_State *L){
-  return lluv__index(L, LLUV_SIGNAL, lluv_handle_index);
-}
-
 LLUV_IMPL_SAFE(lluv_signal_create){
   lluv_loop_t   *loop   = lluv_opt_loop_ex(L, 1, LLUV_FLAG_OPEN);
   lluv_handle_t *handle = lluv_handle_create(L, UV_SIGNAL, INHERITE_FLAGS(loop));
@@ -235,6 +231,7 @@ LLUV_INTERNAL void lluv_signal_initlib(lua_State *L, int nup, int safe){
   if(!lutil_createmetap(L, LLUV_SIGNAL, lluv_signal_methods, nup))
     lua_pop(L, nup);
   lua_pop(L, 1);
+  lluv_handle_createmeta(L, nup, UV_SIGNAL, LLUV_SIGNAL, NULL);
 
   luaL_setfuncs(L, lluv_functions[safe], nup);
   lluv_register_constants(L, lluv_signal_constants);
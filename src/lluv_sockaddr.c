@@ -0,0 +1,228 @@
+/******************************************************************************
+* Author: Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Copyright (C) 2014-2019 Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Licensed according to the included 'LICENSE' document
+*
+* This file is part of lua-lluv library.
+******************************************************************************/
+
+#include "lluv.h"
+#include "lluv_sockaddr.h"
+#include "lluv_error.h"
+#include "lluv_utils.h"
+#include <string.h>
+
+//{ Socket address
+
+/* Parsed address which can be used instead of host/port pair.
+ * Object stores only sockaddr_in6 size so it is cheap enough
+ * to create one per peer.
+ */
+
+#define LLUV_SOCKADDR_NAME LLUV_PREFIX" sockaddr"
+static const char *LLUV_SOCKADDR = LLUV_SOCKADDR_NAME;
+
+LLUV_INTERNAL size_t lluv_sockaddr_len(const struct sockaddr *sa){
+  return (sa->sa_family == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+}
+
+LLUV_INTERNAL void lluv_sockaddr_push(lua_State *L, const struct sockaddr *sa){
+  struct sockaddr_in6 *addr = lutil_newudatap(L, struct sockaddr_in6, LLUV_SOCKADDR);
+  memcpy(addr, sa, lluv_sockaddr_len(sa));
+}
+
+LLUV_INTERNAL struct sockaddr_storage *lluv_test_sockaddr(lua_State *L, int i){
+  if(lua_type(L, i) != LUA_TUSERDATA) return NULL;
+  if(!lutil_isudatap(L, i, LLUV_SOCKADDR)) return NULL;
+  return (struct sockaddr_storage *)lua_touserdata(L, i);
+}
+
+LLUV_INTERNAL struct sockaddr_storage *lluv_check_sockaddr(lua_State *L, int i){
+  struct sockaddr_storage *addr = (struct sockaddr_storage *)lutil_checkudatap (L, i, LLUV_SOCKADDR);
+  luaL_argcheck (L, addr != NULL, i, LLUV_SOCKADDR_NAME" expected");
+  return addr;
+}
+
+/* Host in binary form as passed by udp receive with `binary` address mode */
+static int lluv_sockaddr_from_binary(lua_State *L, struct sockaddr_storage *sa){
+  lua_Integer port = luaL_checkint(L, 2);
+  size_t len;
+
+  if((port < 0) || (port > 65535)) return UV_EINVAL;
+
+  memset(sa, 0, sizeof(*sa));
+
+  if(lua_type(L, 1) == LUA_TNUMBER){
+    struct sockaddr_in *addr = (struct sockaddr_in*)sa;
+    int64_t ip = lutil_checkint64(L, 1);
+    if((ip < 0) || (ip > 0xFFFFFFFF)) return UV_EINVAL;
+
+    addr->sin_family      = AF_INET;
+    addr->sin_addr.s_addr = htonl((uint32_t)ip);
+    addr->sin_port        = htons((unsigned short)port);
+    return 0;
+  }
+
+  if(lua_tolstring(L, 1, &len) && (len == sizeof(struct in6_addr))){
+    struct sockaddr_in6 *addr = (struct sockaddr_in6*)sa;
+    addr->sin6_family = AF_INET6;
+    addr->sin6_port   = htons((unsigned short)port);
+    memcpy(&addr->sin6_addr, lua_tostring(L, 1), len);
+    return 0;
+  }
+
+  return UV_EINVAL;
+}
+
+/* Textual address never contains control or non ASCII characters
+ * so such string can be only binary IPv6 address.
+ */
+static int lluv_sockaddr_is_binary(lua_State *L, int i){
+  size_t len; const unsigned char *str;
+
+  if(lua_type(L, i) == LUA_TNUMBER) return 1;
+  if(lua_type(L, i) != LUA_TSTRING) return 0;
+
+  str = (const unsigned char*)lua_tolstring(L, i, &len);
+  if(len != sizeof(struct in6_addr)) return 0;
+
+  while(len--){
+    if((str[len] < 0x20) || (str[len] > 0x7E)) return 1;
+  }
+
+  return 0;
+}
+
+LLUV_IMPL_SAFE(lluv_sockaddr_new){
+  struct sockaddr_storage sa;
+  int err;
+
+  if(lluv_test_sockaddr(L, 1)){
+    lluv_sockaddr_push(L, (struct sockaddr*)lua_touserdata(L, 1));
+    return 1;
+  }
+
+  if(lluv_sockaddr_is_binary(L, 1)) err = lluv_sockaddr_from_binary(L, &sa);
+  else{
+    err = lluv_check_addr(L, 1, &sa);
+    if(err < 0) err = (lluv_sockaddr_from_binary(L, &sa) < 0) ? err : 0;
+  }
+  if(err < 0){
+    lua_settop(L, 2);
+    lua_pushliteral(L, ":");lua_insert(L, -2);lua_concat(L, 3);
+    return lluv_fail(L, safe_flag, LLUV_ERR_UV, err, lua_tostring(L, -1));
+  }
+
+  lluv_sockaddr_push(L, (struct sockaddr*)&sa);
+  return 1;
+}
+
+static int lluv_sockaddr_host(lua_State *L){
+  struct sockaddr_storage *sa = lluv_check_sockaddr(L, 1);
+  lluv_push_addr(L, sa);
+  lua_settop(L, 2);
+  return 1;
+}
+
+static int lluv_sockaddr_port(lua_State *L){
+  struct sockaddr_storage *sa = lluv_check_sockaddr(L, 1);
+  lua_pushinteger(L, ntohs((sa->ss_family == AF_INET6) ?
+    ((struct sockaddr_in6*)sa)->sin6_port : ((struct sockaddr_in*)sa)->sin_port
+  ));
+  return 1;
+}
+
+static int lluv_sockaddr_family(lua_State *L){
+  struct sockaddr_storage *sa = lluv_check_sockaddr(L, 1);
+  if(sa->ss_family == AF_INET6) lua_pushliteral(L, "inet6");
+  else lua_pushliteral(L, "inet");
+  return 1;
+}
+
+static int lluv_sockaddr_unpack(lua_State *L){
+  struct sockaddr_storage *sa = lluv_check_sockaddr(L, 1);
+  return lluv_push_addr(L, sa);
+}
+
+LLUV_INTERNAL void lluv_sockaddr_push_string(lua_State *L, const struct sockaddr_storage *sa){
+  int top = lua_gettop(L);
+
+  lluv_push_addr(L, sa);
+  lua_settop(L, top + 2);
+  if(sa->ss_family == AF_INET6){
+    lua_pushliteral(L, "[");
+    lua_insert(L, top + 1);
+    lua_pushliteral(L, "]:");
+    lua_insert(L, top + 3);
+    lua_concat(L, 4);
+  }
+  else{
+    lua_pushliteral(L, ":");
+    lua_insert(L, top + 2);
+    lua_concat(L, 3);
+  }
+}
+
+static int lluv_sockaddr_to_s(lua_State *L){
+  struct sockaddr_storage *sa = lluv_check_sockaddr(L, 1);
+  lluv_sockaddr_push_string(L, sa);
+  return 1;
+}
+
+static int lluv_sockaddr_eq(lua_State *L){
+  struct sockaddr_storage *lhs = lluv_check_sockaddr(L, 1);
+  struct sockaddr_storage *rhs = lluv_check_sockaddr(L, 2);
+
+  if(lhs->ss_family != rhs->ss_family) lua_pushboolean(L, 0);
+  else if(lhs->ss_family == AF_INET6){
+    struct sockaddr_in6 *a = (struct sockaddr_in6*)lhs, *b = (struct sockaddr_in6*)rhs;
+    lua_pushboolean(L, (a->sin6_port == b->sin6_port) && (a->sin6_scope_id == b->sin6_scope_id) &&
+      (0 == memcmp(&a->sin6_addr, &b->sin6_addr, sizeof(a->sin6_addr)))
+    );
+  }
+  else{
+    struct sockaddr_in *a = (struct sockaddr_in*)lhs, *b = (struct sockaddr_in*)rhs;
+    lua_pushboolean(L, (a->sin_port == b->sin_port) &&
+      (0 == memcmp(&a->sin_addr, &b->sin_addr, sizeof(a->sin_addr)))
+    );
+  }
+
+  return 1;
+}
+
+static const struct luaL_Reg lluv_sockaddr_methods[] = {
+  { "__tostring",  lluv_sockaddr_to_s       },
+  { "__eq",        lluv_sockaddr_eq         },
+  { "host",        lluv_sockaddr_host       },
+  { "port",        lluv_sockaddr_port       },
+  { "family",      lluv_sockaddr_family     },
+  { "unpack",      lluv_sockaddr_unpack     },
+
+  {NULL,NULL}
+};
+
+//}
+
+static const struct luaL_Reg lluv_sockaddr_functions[][2] = {
+  {
+    { "sockaddr",    lluv_sockaddr_new_unsafe },
+
+    {NULL,NULL}
+  },
+  {
+    { "sockaddr",    lluv_sockaddr_new_safe   },
+
+    {NULL,NULL}
+  },
+};
+
+LLUV_INTERNAL void lluv_sockaddr_initlib(lua_State *L, int nup, int safe){
+  lutil_pushnvalues(L, nup);
+  if(!lutil_createmetap(L, LLUV_SOCKADDR, lluv_sockaddr_methods, nup))
+    lua_pop(L, nup);
+  lua_pop(L, 1);
+
+  luaL_setfuncs(L, lluv_sockaddr_functions[safe], nup);
+}
@@ -0,0 +1,30 @@
+/******************************************************************************
+* Author: Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Copyright (C) 2014-2019 Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Licensed according to the included 'LICENSE' document
+*
+* This file is part of lua-lluv library.
+******************************************************************************/
+
+#ifndef _LLUV_SOCKADDR_H_
+#define _LLUV_SOCKADDR_H_
+
+#include "lluv.h"
+
+LLUV_INTERNAL void lluv_sockaddr_initlib(lua_State *L, int nup, int safe);
+
+LLUV_INTERNAL size_t lluv_sockaddr_len(const struct sockaddr *sa);
+
+LLUV_INTERNAL void lluv_sockaddr_push(lua_State *L, const struct sockaddr *sa);
+
+/* push `host:port` or `[host]:port` string */
+LLUV_INTERNAL void lluv_sockaddr_push_string(lua_State *L, const struct sockaddr_storage *sa);
+
+/* returns NULL if value is not socket address object */
+LLUV_INTERNAL struct sockaddr_storage *lluv_test_sockaddr(lua_State *L, int i);
+
+LLUV_INTERNAL struct sockaddr_storage *lluv_check_sockaddr(lua_State *L, int i);
+
+#endif
@@ -16,13 +16,21 @@
 #include "lluv_loop.h"
 #include "lluv_error.h"
 #include "lluv_req.h"
+#include "lluv_fbuf.h"
+#include "lluv_fs.h"
 #include <assert.h>
+#include <string.h>
+
+#ifndef _WIN32
+#  include <errno.h>
+#  include <unistd.h>
+#endif
 
 #define LLUV_STREAM_NAME LLUV_PREFIX" Stream"
 static const char *LLUV_STREAM = LLUV_STREAM_NAME;
 
-LLUV_INTERNAL int lluv_stream_index(lua_State *L){
-  return lluv__index(L, LLUV_STREAM, lluv_handle_index);
+LLUV_INTERNAL void lluv_stream_createmeta(lua_State *L, int nup, uv_handle_type type, const char *meta){
+  lluv_handle_createmeta(L, nup, type, meta, LLUV_STREAM);
 }
 
 LLUV_INTERNAL lluv_handle_t* lluv_stream_create(lua_State *L, uv_handle_type type, lluv_flags_t flags){
@@ -40,6 +48,177 @@ LLUV_INTERNAL lluv_handle_t* lluv_check_stream(lua_State *L, int idx, lluv_flags
   return handle;
 }
 
+//{ Stream extension
+
+/* Per stream state used only by optional features.
+ * Allocated on first use and released with handle.
+ */
+typedef struct lluv_stream_ext_tag{
+  lluv_handle_t   *handle;
+
+  int              rbuf;      /* fixed buffer used as read target */
+  char            *rbuf_base;
+  size_t           rbuf_size;
+  size_t           rbuf_off;
+
+  lluv_loop_task_t flush;     /* flushes corked writes before loop poll */
+  unsigned char    corked;    /* gather writes until uncork */
+  unsigned char    auto_cork; /* gather writes until end of loop iteration */
+  unsigned char    try_write; /* write directly to socket if possible */
+  int              wdata;     /* strings of corked writes */
+  int              wdata_n;
+  int              wcbs;      /* callback/context pairs of corked writes */
+  int              wcbs_n;
+  uv_buf_t        *wbufs;
+  size_t           wbufs_n;
+  size_t           wbufs_cap;
+
+  size_t           wm_high;   /* write queue size to call on_full */
+  size_t           wm_low;    /* write queue size to call on_drain */
+  unsigned char    wm_full;
+  int              on_full;
+  int              on_drain;
+
+  struct lluv_stream_pipe_tag *pipe; /* active pipe_to */
+  size_t           piped;     /* active pipes writing to this stream */
+
+  struct lluv_stream_sendfile_tag *sendfile; /* sendfile in progress */
+
+  unsigned char    frame;     /* framing mode for start_read */
+  char             eol[8];
+  size_t           eol_len;
+  size_t           fsize;     /* fixed frame size */
+  size_t           fmax;      /* max frame size */
+  char            *fbuf;      /* reassembly buffer */
+  size_t           flen;
+  size_t           fcap;
+  size_t           fpos;      /* begin of unparsed data */
+  size_t           fscan;     /* eol search position from fpos */
+  lluv_loop_task_t frame_task;
+
+  unsigned char    batch;     /* batched read mode */
+  size_t          *bchunks;   /* chunk sizes for array mode */
+  size_t           bchunks_n;
+  size_t           bchunks_cap;
+  lluv_loop_task_t batch_task;
+}lluv_stream_ext_t;
+
+#define LLUV_STREAM_EXT(H) ((lluv_stream_ext_t*)(H)->ext)
+
+#define LLUV_STREAM_CORKED(E) ((E) && ((E)->corked || (E)->auto_cork))
+
+#define LLUV_STREAM_SENDFILE(E) ((E) && (E)->sendfile)
+
+static void lluv_stream_on_flush_task(lua_State *L, lluv_loop_task_t *task);
+
+static void lluv_stream_on_frame_task(lua_State *L, lluv_loop_task_t *task);
+
+static void lluv_stream_on_batch_task(lua_State *L, lluv_loop_task_t *task);
+
+static void lluv_stream_pipe_detach(lua_State *L, lluv_stream_ext_t *ext);
+
+static void lluv_stream_pipe_cancel(lua_State *L, lluv_handle_t *handle);
+
+static int lluv_stream_cork_flush(lua_State *L, lluv_handle_t *handle);
+
+static lluv_stream_ext_t *lluv_stream_ext(lua_State *L, lluv_handle_t *handle){
+  lluv_stream_ext_t *ext = LLUV_STREAM_EXT(handle);
+  if(ext) return ext;
+
+  ext = lluv_alloc_t(L, lluv_stream_ext_t);
+  ext->handle    = handle;
+  ext->rbuf      = LUA_NOREF;
+  ext->rbuf_base = NULL;
+  ext->rbuf_size = ext->rbuf_off = 0;
+
+  lluv_loop_task_init(&ext->flush, lluv_stream_on_flush_task);
+  ext->corked    = ext->auto_cork = 0;
+  ext->try_write = 0;
+  ext->wdata     = ext->wcbs      = LUA_NOREF;
+  ext->wdata_n   = ext->wcbs_n    = 0;
+  ext->wbufs     = NULL;
+  ext->wbufs_n   = ext->wbufs_cap = 0;
+
+  ext->wm_high   = ext->wm_low    = 0;
+  ext->wm_full   = 0;
+  ext->on_full   = ext->on_drain  = LUA_NOREF;
+
+  ext->pipe      = NULL;
+  ext->piped     = 0;
+
+  ext->sendfile  = NULL;
+
+  ext->frame     = 0;
+  ext->eol_len   = 0;
+  ext->fsize     = ext->fmax = 0;
+  ext->fbuf      = NULL;
+  ext->flen      = ext->fcap = ext->fpos = ext->fscan = 0;
+  lluv_loop_task_init(&ext->frame_task, lluv_stream_on_frame_task);
+
+  ext->batch     = 0;
+  ext->bchunks   = NULL;
+  ext->bchunks_n = ext->bchunks_cap = 0;
+  lluv_loop_task_init(&ext->batch_task, lluv_stream_on_batch_task);
+
+  handle->ext = ext;
+  return ext;
+}
+
+static void lluv_stream_release_rbuf(lua_State *L, lluv_handle_t *handle){
+  lluv_stream_ext_t *ext = LLUV_STREAM_EXT(handle);
+  if(!ext) return;
+
+  luaL_unref(L, LLUV_LUA_REGISTRY, ext->rbuf);
+  ext->rbuf      = LUA_NOREF;
+  ext->rbuf_base = NULL;
+  ext->rbuf_size = ext->rbuf_off = 0;
+}
+
+static void lluv_stream_release_frame(lua_State *L, lluv_handle_t *handle){
+  lluv_stream_ext_t *ext = LLUV_STREAM_EXT(handle);
+  if(!ext) return;
+
+  lluv_loop_task_cancel(&ext->frame_task);
+  lluv_loop_task_cancel(&ext->batch_task);
+  if(ext->fbuf) lluv_free(L, ext->fbuf);
+  if(ext->bchunks) lluv_free(L, ext->bchunks);
+  ext->frame = ext->batch = 0;
+  ext->fbuf  = NULL;
+  ext->flen  = ext->fcap = ext->fpos = ext->fscan = 0;
+  ext->bchunks = NULL;
+  ext->bchunks_n = ext->bchunks_cap = 0;
+}
+
+static void lluv_stream_release_corked(lua_State *L, lluv_stream_ext_t *ext){
+  lluv_loop_task_cancel(&ext->flush);
+
+  luaL_unref(L, LLUV_LUA_REGISTRY, ext->wdata);
+  luaL_unref(L, LLUV_LUA_REGISTRY, ext->wcbs);
+  ext->wdata   = ext->wcbs   = LUA_NOREF;
+  ext->wdata_n = ext->wcbs_n = 0;
+  ext->wbufs_n = 0;
+}
+
+LLUV_INTERNAL void lluv_stream_ext_free(lua_State *L, lluv_handle_t *handle){
+  lluv_stream_ext_t *ext = LLUV_STREAM_EXT(handle);
+  if(!ext) return;
+
+  lluv_stream_release_rbuf(L, handle);
+  lluv_stream_release_frame(L, handle);
+  lluv_stream_release_corked(L, ext);
+  if(ext->wbufs) lluv_free(L, ext->wbufs);
+
+  luaL_unref(L, LLUV_LUA_REGISTRY, ext->on_full);
+  luaL_unref(L, LLUV_LUA_REGISTRY, ext->on_drain);
+
+  lluv_stream_pipe_detach(L, ext);
+
+  handle->ext = NULL;
+  lluv_free_t(L, lluv_stream_ext_t, ext);
+}
+
+//}
+
 LLUV_INTERNAL void lluv_on_stream_req_cb(uv_req_t* arg, int status){
   lluv_req_t    *req    = lluv_req_byptr(arg);
   lluv_handle_t *handle = req->handle;
@@ -47,7 +226,7 @@ LLUV_INTERNAL void lluv_on_stream_req_cb(uv_req_t* arg, int status){
 
   LLUV_CHECK_LOOP_CB_INVARIANT(L);
 
-  if(!IS_(handle, OPEN)){
+  if(!IS_(handle, OPEN) || !lluv_req_has_cb(L, req)){
     lluv_req_free(L, req);
 
     LLUV_CHECK_LOOP_CB_INVARIANT(L);
@@ -66,7 +245,7 @@ LLUV_INTERNAL void lluv_on_stream_req_cb(uv_req_t* arg, int status){
     return;
   }
 
-  lluv_push_status(L, status);
+  lluv_push_status_ex(L, handle->flags, status);
   lua_insert(L, -2);
 
   LLUV_HANDLE_CALL_CB(L, handle, 3);
@@ -93,6 +272,9 @@ static int lluv_stream_shutdown(lua_State *L){
   else
     lluv_check_args_with_cb(L, 2);
 
+  /* corked data must be sent before shutdown */
+  lluv_stream_cork_flush(L, handle);
+
   req = lluv_req_new(L, UV_SHUTDOWN, handle);
 
   err = uv_shutdown(LLUV_R(req, shutdown), LLUV_H(handle, uv_stream_t), lluv_on_stream_shutdown_cb);
@@ -116,7 +298,7 @@ static void lluv_on_stream_connection_cb(uv_stream_t* arg, int status){
   assert(!lua_isnil(L, -1));
 
   lluv_handle_pushself(L, handle);
-  lluv_push_status(L, status);
+  lluv_push_status_ex(L, handle->flags, status);
 
   LLUV_HANDLE_CALL_CB(L, handle, 2);
 
@@ -277,7 +459,7 @@ static void lluv_on_stream_read_cb(uv_stream_t* arg, ssize_t nread, const uv_buf
     luaL_unref(L, LLUV_LUA_REGISTRY, LLUV_READ_CB(handle));
     LLUV_READ_CB(handle) = LUA_NOREF;
 
-    lluv_error_create(L, LLUV_ERR_UV, (uv_errno_t)nread, NULL);
+    lluv_error_push(L, handle->flags, LLUV_ERR_UV, (uv_errno_t)nread);
     lua_pushnil(L);
 
     lluv_handle_unlock(L, handle, LLUV_LOCK_READ);
@@ -288,227 +470,1751 @@ static void lluv_on_stream_read_cb(uv_stream_t* arg, ssize_t nread, const uv_buf
   LLUV_CHECK_LOOP_CB_INVARIANT(L);
 }
 
-static int lluv_stream_start_read(lua_State *L){
-  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
-  int err;
+/* Read directly into user provided fixed buffer.
+ * Buffer is reused for each read so callback have to
+ * consume data before it returns.
+ */
+static void lluv_stream_alloc_fbuf_cb(uv_handle_t* h, size_t suggested_size, uv_buf_t *buf){
+  lluv_handle_t     *handle = lluv_handle_byptr(h);
+  lluv_stream_ext_t *ext    = LLUV_STREAM_EXT(handle);
 
-  lluv_check_args_with_cb(L, 2);
-  LLUV_READ_CB(handle) = luaL_ref(L, LLUV_LUA_REGISTRY);
+  UNUSED_ARG(suggested_size);
 
-  err = uv_read_start(LLUV_H(handle, uv_stream_t), lluv_alloc_buffer_cb, lluv_on_stream_read_cb);
-  if(err >= 0) lluv_handle_lock(L, handle, LLUV_LOCK_READ);
-  return lluv_return(L, handle, LLUV_READ_CB(handle), err);
+  assert(ext && ext->rbuf_base);
+
+  *buf = lluv_buf_init(ext->rbuf_base + ext->rbuf_off, ext->rbuf_size - ext->rbuf_off);
 }
 
-static int lluv_stream_stop_read(lua_State *L){
-  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
-  int err;
+static void lluv_on_stream_read_fbuf_cb(uv_stream_t* arg, ssize_t nread, const uv_buf_t* buf){
+  lluv_handle_t *handle = lluv_handle_byptr((uv_handle_t*)arg);
+  lua_State *L = LLUV_HCALLBACK_L(handle);
+  lluv_stream_ext_t *ext;
 
-  lluv_check_none(L, 2);
+  UNUSED_ARG(buf);
 
-  err = uv_read_stop(LLUV_H(handle, uv_stream_t));
-  if(err < 0){
-    return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  if(!IS_(handle, OPEN)) return;
+
+  ext = LLUV_STREAM_EXT(handle);
+
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, LLUV_READ_CB(handle));
+  assert(!lua_isnil(L, -1));
+
+  lluv_handle_pushself(L, handle);
+
+  if(nread >= 0){
+    lua_pushnil(L);
+    lua_rawgeti(L, LLUV_LUA_REGISTRY, ext->rbuf);
+    lutil_pushint64(L, ext->rbuf_off);
+    lutil_pushint64(L, nread);
   }
+  else{
+    uv_read_stop(arg);
 
-  if(LLUV_READ_CB(handle) != LUA_NOREF){
-    lluv_handle_unlock(L, handle, LLUV_LOCK_READ);
     luaL_unref(L, LLUV_LUA_REGISTRY, LLUV_READ_CB(handle));
     LLUV_READ_CB(handle) = LUA_NOREF;
+
+    lluv_error_push(L, handle->flags, LLUV_ERR_UV, (uv_errno_t)nread);
+    lua_rawgeti(L, LLUV_LUA_REGISTRY, ext->rbuf);
+    lutil_pushint64(L, ext->rbuf_off);
+    lua_pushinteger(L, 0);
+
+    lluv_stream_release_rbuf(L, handle);
+    lluv_handle_unlock(L, handle, LLUV_LOCK_READ);
   }
 
-  lua_settop(L, 1);
-  return 1;
+  LLUV_HANDLE_CALL_CB(L, handle, 5);
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
 }
 
-//}
+/* start_read(fbuf, [offset,] cb) */
+static int lluv_stream_start_read_fbuf(lua_State *L, lluv_handle_t *handle){
+  lluv_fixed_buffer_t *buffer = lluv_check_fbuf(L, 2);
+  lluv_stream_ext_t   *ext;
+  int64_t off = 0;
+  int err;
 
-//{ Write
+  if(lua_gettop(L) > 3){
+    off = lutil_checkint64(L, 3);
+    lluv_check_args_with_cb(L, 4);
+  }
+  else{
+    lluv_check_args_with_cb(L, 3);
+  }
 
-static int lluv_stream_try_write(lua_State *L){
-  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
-  size_t len; const char *str = luaL_checklstring(L, 2, &len);
-  int err; uv_buf_t buf = lluv_buf_init((char*)str, len);
+  luaL_argcheck(L, (off >= 0) && (buffer->capacity > (size_t)off), 3, LLUV_PREFIX" out of index");
 
-  lluv_check_none(L, 3);
+  ext = lluv_stream_ext(L, handle);
 
-  err = uv_try_write(LLUV_H(handle, uv_stream_t), &buf, 1);
-  if(err < 0){
-    return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
+  /* data received by framed read have to be passed with single callback */
+  if(ext->flen - ext->fpos > buffer->capacity - (size_t)off){
+    lua_pop(L, 1);
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, UV_ENOBUFS, NULL);
   }
 
-  lua_pushinteger(L, err);
-  return 1;
-}
+  LLUV_READ_CB(handle) = luaL_ref(L, LLUV_LUA_REGISTRY);
 
-static void lluv_on_stream_write_cb(uv_write_t* arg, int status){
-  lluv_req_t    *req    = lluv_req_byptr((uv_req_t*)arg);
-  lluv_handle_t *handle = req->handle;
-  lua_State     *L      = LLUV_HCALLBACK_L(handle);
+  lluv_stream_release_rbuf(L, handle);
+  lua_pushvalue(L, 2);
+  ext->rbuf      = luaL_ref(L, LLUV_LUA_REGISTRY);
+  ext->rbuf_base = &buffer->data[0];
+  ext->rbuf_size = buffer->capacity;
+  ext->rbuf_off  = (size_t)off;
 
-  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+  err = uv_read_start(LLUV_H(handle, uv_stream_t), lluv_stream_alloc_fbuf_cb, lluv_on_stream_read_fbuf_cb);
+  if(err >= 0){
+    size_t len = ext->flen - ext->fpos;
 
-  if(!IS_(handle, OPEN)){
-    lluv_req_free(L, req);
+    lluv_handle_lock(L, handle, LLUV_LOCK_READ);
 
-    LLUV_CHECK_LOOP_CB_INVARIANT(L);
-    return;
+    /* deferred call done before next read to same buffer */
+    if(len){
+      memcpy(ext->rbuf_base + ext->rbuf_off, ext->fbuf + ext->fpos, len);
+      lua_rawgeti(L, LLUV_LUA_REGISTRY, LLUV_READ_CB(handle));
+      lua_pushvalue(L, 1);
+      lua_pushnil(L);
+      lua_pushvalue(L, 2);
+      lutil_pushint64(L, ext->rbuf_off);
+      lutil_pushint64(L, len);
+      lluv_loop_defer_call(L, lluv_loop_by_handle(&handle->handle), 5);
+    }
   }
+  else lluv_stream_release_rbuf(L, handle);
 
-  lua_rawgeti(L, LLUV_LUA_REGISTRY, req->cb);
-  lluv_handle_pushself(L, handle);
-  lua_rawgeti(L, LLUV_LUA_REGISTRY, req->ctx);
-  lluv_req_free(L, req);
+  lluv_stream_release_frame(L, handle);
 
-  if(lua_isnil(L, -3)){
-    lua_pop(L, 3);
+  return lluv_return(L, handle, LLUV_READ_CB(handle), err);
+}
 
-    LLUV_CHECK_LOOP_CB_INVARIANT(L);
-    return;
-  }
+/* Framed read. Data collected in reassembly buffer and
+ * callback called once for each complete message.
+ */
 
-  lluv_push_status(L, status);
-  lua_insert(L, -2);
+#define LLUV_FRAME_LINE   1
+#define LLUV_FRAME_U16BE  2
+#define LLUV_FRAME_U32BE  3
+#define LLUV_FRAME_VARINT 4
+#define LLUV_FRAME_FIXED  5
 
-  LLUV_HANDLE_CALL_CB(L, handle, 3);
+#ifndef LLUV_FRAME_MAX
+#  define LLUV_FRAME_MAX (16 * 1024 * 1024)
+#endif
 
-  LLUV_CHECK_LOOP_CB_INVARIANT(L);
-}
+static void lluv_stream_alloc_frame_cb(uv_handle_t* h, size_t suggested_size, uv_buf_t *buf){
+  lluv_handle_t     *handle = lluv_handle_byptr(h);
+  lluv_stream_ext_t *ext    = LLUV_STREAM_EXT(handle);
 
-static int lluv_stream_write_(lua_State *L, lluv_handle_t *handle, uv_buf_t *buf, size_t n){
-  int err; lluv_req_t *req;
+  assert(ext && (ext->frame || ext->batch));
 
-  if(lua_gettop(L) == 4){
-    int ctx;
-    lluv_check_callable(L, -2);
-    ctx = luaL_ref(L, LLUV_LUA_REGISTRY);
-    req = lluv_req_new(L, UV_WRITE, handle);
-    lluv_req_ref(L, req); /* string/table */
-    req->ctx = ctx;
-  }
-  else{
-    if(lua_gettop(L) == 2)
-      lua_settop(L, 3);
-    else
-      lluv_check_args_with_cb(L, 3);
+  if(ext->fcap - ext->flen < suggested_size){
+    size_t cap = ext->fcap ? ext->fcap : suggested_size;
+    char *fbuf;
 
-    req = lluv_req_new(L, UV_WRITE, handle);
-    lluv_req_ref(L, req); /* string/table */
-  }
+    while(cap - ext->flen < suggested_size) cap *= 2;
 
-  err = uv_write(LLUV_R(req, write), LLUV_H(handle, uv_stream_t), buf, n, lluv_on_stream_write_cb);
+    fbuf = (char*)lluv_alloc(NULL, cap);
+    if(!fbuf){
+      *buf = lluv_buf_init(NULL, 0); /* libuv reports UV_ENOBUFS */
+      return;
+    }
 
-  return lluv_return_req(L, handle, req, err);
+    if(ext->fbuf){
+      memcpy(fbuf, ext->fbuf, ext->flen);
+      lluv_free(NULL, ext->fbuf);
+    }
+
+    ext->fbuf = fbuf;
+    ext->fcap = cap;
+  }
+
+  *buf = lluv_buf_init(ext->fbuf + ext->flen, ext->fcap - ext->flen);
 }
 
-static int lluv_stream_write_t(lua_State *L, lluv_handle_t  *handle){
-  int i, n = lua_rawlen(L, 2);
-  uv_buf_t *buf;
-  
-  assert(lua_type(L, 2) == LUA_TTABLE);
+/* returns 1 if there complete frame, 0 if need more data or error code */
+static int lluv_stream_frame_next(lluv_stream_ext_t *ext, const char **msg, size_t *len){
+  const unsigned char *p = (const unsigned char*)ext->fbuf + ext->fpos;
+  size_t avail = ext->flen - ext->fpos, hdr = 0;
+  uint64_t size = 0;
+
+  switch(ext->frame){
+    case LLUV_FRAME_LINE:{
+      size_t i = ext->fscan, n = ext->eol_len;
+      while(i + n <= avail){
+        const unsigned char *e = memchr(p + i, (unsigned char)ext->eol[0], avail - n + 1 - i);
+        if(!e){
+          i = avail - n + 1;
+          break;
+        }
+        i = (size_t)(e - p);
+        if(memcmp(e, ext->eol, n) == 0){
+          if(i > ext->fmax) return UV_EMSGSIZE;
+          *msg = (const char*)p; *len = i;
+          ext->fpos += i + n;
+          ext->fscan = 0;
+          return 1;
+        }
+        ++i;
+      }
+      if(i > ext->fmax) return UV_EMSGSIZE;
+      ext->fscan = i;
+      return 0;
+    }
 
-  luaL_argcheck(L, n > 0, 2, "Empty array not supported");
-  
-  buf = (uv_buf_t*)lluv_alloca(sizeof(uv_buf_t) * n);
-  if(!buf){
-    return lluv_fail(L, handle->flags, LLUV_ERR_UV, ENOMEM, NULL); 
-  }
+    case LLUV_FRAME_U16BE:
+      hdr = 2;
+      if(avail < hdr) return 0;
+      size = ((uint64_t)p[0] << 8) | p[1];
+      break;
+
+    case LLUV_FRAME_U32BE:
+      hdr = 4;
+      if(avail < hdr) return 0;
+      size = ((uint64_t)p[0] << 24) | ((uint64_t)p[1] << 16) | ((uint64_t)p[2] << 8) | p[3];
+      break;
+
+    case LLUV_FRAME_VARINT:
+      for(;;){
+        if(hdr == avail) return 0;
+        if(hdr == 10) return UV_EPROTO;
+        size |= (uint64_t)(p[hdr] & 0x7F) << (7 * hdr);
+        if(!(p[hdr++] & 0x80)) break;
+      }
+      break;
 
-  for(i = 0; i < n; ++i){
-    size_t len; const char *str;
-    lua_rawgeti(L, 2, i + 1);
-    str = luaL_checklstring(L, -1, &len);
-    buf[i] = lluv_buf_init((char*)str, len);
-    lua_pop(L, 1);
+    case LLUV_FRAME_FIXED:
+      size = ext->fsize;
+      break;
+
+    default:
+      assert(0 && "unknown frame mode");
+      return 0;
   }
 
-  return lluv_stream_write_(L, handle, buf, n);
+  if(size > ext->fmax) return UV_EMSGSIZE;
+  if(avail - hdr < size) return 0;
+
+  *msg = (const char*)p + hdr; *len = (size_t)size;
+  ext->fpos += hdr + (size_t)size;
+  return 1;
 }
 
-static int lluv_stream_write(lua_State *L){
-  lluv_handle_t  *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
-  if(lua_type(L, 2) == LUA_TTABLE){
-    return lluv_stream_write_t(L, handle);
-  }
-  else{
-    size_t len; const char *str = luaL_checklstring(L, 2, &len);
-    uv_buf_t buf = lluv_buf_init((char*)str, len);
-    return lluv_stream_write_(L, handle, &buf, 1);
+static void lluv_stream_frame_compact(lluv_stream_ext_t *ext){
+  if(!ext->fbuf || !ext->fpos) return;
+
+  ext->flen -= ext->fpos;
+  if(ext->flen) memmove(ext->fbuf, ext->fbuf + ext->fpos, ext->flen);
+  ext->fpos = 0;
+
+  /* do not keep memory allocated for big messages */
+  if(!ext->flen && (ext->fcap > 4 * LLUV_BUFFER_SIZE)){
+    lluv_free(NULL, ext->fbuf);
+    ext->fbuf = NULL;
+    ext->fcap = 0;
   }
 }
 
-static int lluv_stream_write2(lua_State *L){
-  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
-  lluv_handle_t *src    = lluv_check_stream(L, 2, LLUV_FLAG_OPEN);
-  size_t len; const char *str;
-  int err; lluv_req_t *req;
-  uv_buf_t buf;
+static void lluv_stream_read_fail(lua_State *L, lluv_handle_t *handle, int err){
+  lluv_stream_ext_t *ext = LLUV_STREAM_EXT(handle);
 
-  if(lua_isfunction(L, 3)){
-    lua_pushliteral(L, ".");
-    lua_insert(L, 3);
-  }
-  str = luaL_checklstring(L, 3, &len);
-  buf = lluv_buf_init((char*)str, len);
+  uv_read_stop(LLUV_H(handle, uv_stream_t));
 
-  if(lua_gettop(L) == 3)
-    lua_settop(L, 4);
-  else
-    lluv_check_args_with_cb(L, 4);
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, LLUV_READ_CB(handle));
+  luaL_unref(L, LLUV_LUA_REGISTRY, LLUV_READ_CB(handle));
+  LLUV_READ_CB(handle) = LUA_NOREF;
 
-  req = lluv_req_new(L, UV_WRITE, handle);
-  lluv_req_ref(L, req); /* string */
+  lluv_handle_pushself(L, handle);
+  lluv_error_push(L, handle->flags, LLUV_ERR_UV, (uv_errno_t)err);
+
+  /* rest of data */
+  if(ext->flen > ext->fpos)
+    lua_pushlstring(L, ext->fbuf + ext->fpos, ext->flen - ext->fpos);
+  else
+    lua_pushnil(L);
 
-  err = uv_write2(LLUV_R(req, write), LLUV_H(handle, uv_stream_t), &buf, 1, LLUV_H(src, uv_stream_t), lluv_on_stream_write_cb);
+  lluv_stream_release_frame(L, handle);
+  lluv_handle_unlock(L, handle, LLUV_LOCK_READ);
 
-  return lluv_return_req(L, handle, req, err);
+  LLUV_HANDLE_CALL_CB(L, handle, 3);
 }
 
-//}
+/* Callback can stop reading, close stream or change framing mode */
+static void lluv_stream_frame_deliver(lua_State *L, lluv_handle_t *handle){
+  lluv_stream_ext_t *ext = LLUV_STREAM_EXT(handle);
+  const char *msg; size_t len;
 
-static int lluv_stream_is_readable(lua_State *L){
-  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
-  lua_settop(L, 1);
-  lua_pushboolean(L, uv_is_readable(LLUV_H(handle, uv_stream_t)));
-  return 1;
+  while(IS_(handle, OPEN) && (LLUV_READ_CB(handle) != LUA_NOREF) && ext->frame){
+    int ret = lluv_stream_frame_next(ext, &msg, &len);
+    if(ret == 0) break;
+
+    if(ret < 0){
+      lluv_stream_read_fail(L, handle, ret);
+      return;
+    }
+
+    lua_rawgeti(L, LLUV_LUA_REGISTRY, LLUV_READ_CB(handle));
+    lluv_handle_pushself(L, handle);
+    lua_pushnil(L);
+    lua_pushlstring(L, msg, len);
+
+    LLUV_HANDLE_CALL_CB(L, handle, 3);
+  }
+
+  if(IS_(handle, OPEN)) lluv_stream_frame_compact(ext);
 }
 
-static int lluv_stream_is_writable(lua_State *L){
-  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
-  lua_settop(L, 1);
-  lua_pushboolean(L, uv_is_writable(LLUV_H(handle, uv_stream_t)));
-  return 1;
+static void lluv_stream_on_frame_task(lua_State *L, lluv_loop_task_t *task){
+  lluv_stream_ext_t *ext = (lluv_stream_ext_t*)((char*)task - offsetof(lluv_stream_ext_t, frame_task));
+  lluv_stream_frame_deliver(L, ext->handle);
 }
 
-static int lluv_stream_set_blocking(lua_State *L){
-  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
-  int block = luaL_opt(L, lua_toboolean, 2, 1);
-  int err;
+static void lluv_on_stream_read_frame_cb(uv_stream_t* arg, ssize_t nread, const uv_buf_t* buf){
+  lluv_handle_t *handle = lluv_handle_byptr((uv_handle_t*)arg);
+  lua_State *L = LLUV_HCALLBACK_L(handle);
+  lluv_stream_ext_t *ext;
 
-  lua_settop(L, 1);
+  UNUSED_ARG(buf);
 
-  err = uv_stream_set_blocking(LLUV_H(handle, uv_stream_t), block);
-  if(err < 0){
-    return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  if(!IS_(handle, OPEN)) return;
+
+  ext = LLUV_STREAM_EXT(handle);
+
+  if(nread < 0){
+    lluv_stream_read_fail(L, handle, (int)nread);
+  }
+  else{
+    ext->flen += nread;
+    lluv_stream_frame_deliver(L, handle);
   }
 
-  return 1;
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
 }
 
-static int lluv_stream_get_write_queue_size(lua_State *L){
-  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
-  size_t queue_size;
+/* start_read({frame=...}, cb) */
+static int lluv_stream_start_read_frame(lua_State *L, lluv_handle_t *handle){
+  static const char *FRAMES[] = {"line", "u16be", "u32be", "varint", "fixed", NULL};
+  lluv_stream_ext_t *ext;
+  const char *eol = "\n"; size_t eol_len = 1;
+  int64_t size = 0, max = LLUV_FRAME_MAX;
+  int frame, err;
 
-  lua_settop(L, 1);
+  lluv_check_args_with_cb(L, 3);
 
-#if LLUV_UV_VER_GE(1,19,0)
-  queue_size = uv_stream_get_write_queue_size(LLUV_H(handle, uv_stream_t));
-#else
-  queue_size = LLUV_H(handle, uv_stream_t)->write_queue_size;
-#endif
+  lua_getfield(L, 2, "frame");
+  frame = luaL_checkoption(L, -1, NULL, FRAMES) + 1;
+  lua_pop(L, 1);
 
-  lutil_pushint64(L, queue_size);
+  lua_getfield(L, 2, "eol");
+  if(!lua_isnil(L, -1)) eol = luaL_checklstring(L, -1, &eol_len);
+  luaL_argcheck(L, (eol_len > 0) && (eol_len <= sizeof(ext->eol)), 2, "invalid eol");
+  lua_pop(L, 1);
+
+  lua_getfield(L, 2, "max");
+  if(!lua_isnil(L, -1)) max = lutil_checkint64(L, -1);
+  luaL_argcheck(L, max > 0, 2, "max should be positive");
+  lua_pop(L, 1);
+
+  if(frame == LLUV_FRAME_FIXED){
+    lua_getfield(L, 2, "size");
+    size = lutil_checkint64(L, -1);
+    luaL_argcheck(L, size > 0, 2, "size should be positive");
+    lua_pop(L, 1);
+  }
+
+  ext = lluv_stream_ext(L, handle);
+  lluv_stream_release_rbuf(L, handle);
+
+  ext->frame   = (unsigned char)frame;
+  memcpy(ext->eol, eol, eol_len);
+  ext->eol_len = eol_len;
+  ext->fsize   = (size_t)size;
+  ext->fmax    = (size_t)max;
+  ext->fscan   = 0;
+  ext->batch   = 0;
+  ext->bchunks_n = 0;
+  lluv_loop_task_cancel(&ext->batch_task);
+
+  LLUV_READ_CB(handle) = luaL_ref(L, LLUV_LUA_REGISTRY);
+
+  err = uv_read_start(LLUV_H(handle, uv_stream_t), lluv_stream_alloc_frame_cb, lluv_on_stream_read_frame_cb);
+  if(err >= 0){
+    lluv_handle_lock(L, handle, LLUV_LOCK_READ);
+    /* data received before stop_read */
+    if(ext->flen > ext->fpos){
+      lluv_loop_task_queue(lluv_loop_by_handle(&handle->handle), &ext->frame_task);
+    }
+  }
 
+  return lluv_return(L, handle, LLUV_READ_CB(handle), err);
+}
+
+/* Batched read. Data received during one loop iteration
+ * delivered with single callback from check phase.
+ */
+
+#define LLUV_BATCH_CONCAT 1
+#define LLUV_BATCH_ARRAY  2
+
+static int lluv_stream_batch_push_chunk(lluv_stream_ext_t *ext, size_t len){
+  if(ext->bchunks_n == ext->bchunks_cap){
+    size_t cap = ext->bchunks_cap ? ext->bchunks_cap * 2 : 16;
+    size_t *chunks = (size_t*)lluv_alloc(NULL, cap * sizeof(size_t));
+    if(!chunks) return UV_ENOMEM;
+
+    if(ext->bchunks){
+      memcpy(chunks, ext->bchunks, ext->bchunks_n * sizeof(size_t));
+      lluv_free(NULL, ext->bchunks);
+    }
+
+    ext->bchunks     = chunks;
+    ext->bchunks_cap = cap;
+  }
+
+  ext->bchunks[ext->bchunks_n++] = len;
+  return 0;
+}
+
+static void lluv_stream_batch_flush(lua_State *L, lluv_handle_t *handle){
+  lluv_stream_ext_t *ext = LLUV_STREAM_EXT(handle);
+
+  lluv_loop_task_cancel(&ext->batch_task);
+
+  if(!IS_(handle, OPEN) || (LLUV_READ_CB(handle) == LUA_NOREF) || !ext->batch) return;
+  if(ext->flen == 0) return;
+
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, LLUV_READ_CB(handle));
+  lluv_handle_pushself(L, handle);
+  lua_pushnil(L);
+
+  if(ext->batch == LLUV_BATCH_ARRAY){
+    size_t i, off = 0;
+    lua_createtable(L, (int)ext->bchunks_n, 0);
+    for(i = 0; i < ext->bchunks_n; ++i){
+      lua_pushlstring(L, ext->fbuf + off, ext->bchunks[i]);
+      lua_rawseti(L, -2, (int)i + 1);
+      off += ext->bchunks[i];
+    }
+  }
+  else{
+    lua_pushlstring(L, ext->fbuf, ext->flen);
+  }
+
+  ext->bchunks_n = 0;
+  ext->fpos = ext->flen;
+  lluv_stream_frame_compact(ext);
+
+  LLUV_HANDLE_CALL_CB(L, handle, 3);
+}
+
+static void lluv_stream_on_batch_task(lua_State *L, lluv_loop_task_t *task){
+  lluv_stream_ext_t *ext = (lluv_stream_ext_t*)((char*)task - offsetof(lluv_stream_ext_t, batch_task));
+  lluv_stream_batch_flush(L, ext->handle);
+}
+
+static void lluv_on_stream_read_batch_cb(uv_stream_t* arg, ssize_t nread, const uv_buf_t* buf){
+  lluv_handle_t *handle = lluv_handle_byptr((uv_handle_t*)arg);
+  lua_State *L = LLUV_HCALLBACK_L(handle);
+  lluv_stream_ext_t *ext;
+
+  UNUSED_ARG(buf);
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  if(!IS_(handle, OPEN)) return;
+
+  ext = LLUV_STREAM_EXT(handle);
+
+  if(nread > 0){
+    int err = 0;
+
+    ext->flen += nread;
+    if(ext->batch == LLUV_BATCH_ARRAY) err = lluv_stream_batch_push_chunk(ext, nread);
+
+    if(err >= 0){
+      err = lluv_loop_check_task_queue(lluv_loop_by_handle(&handle->handle), &ext->batch_task);
+    }
+
+    if(err < 0){
+      ext->flen -= nread;
+      nread = err;
+    }
+  }
+
+  if(nread < 0){
+    /* deliver data received before error */
+    lluv_stream_batch_flush(L, handle);
+
+    if(IS_(handle, OPEN) && (LLUV_READ_CB(handle) != LUA_NOREF)){
+      lluv_stream_read_fail(L, handle, (int)nread);
+    }
+  }
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+/* start_read({batch=...}, cb) */
+static int lluv_stream_start_read_batch(lua_State *L, lluv_handle_t *handle){
+  static const char *BATCHES[] = {"string", "array", NULL};
+  lluv_stream_ext_t *ext;
+  int batch, err;
+
+  lluv_check_args_with_cb(L, 3);
+
+  lua_getfield(L, 2, "frame");
+  luaL_argcheck(L, lua_isnil(L, -1), 2, "frame can not be used with batch");
+  lua_pop(L, 1);
+
+  lua_getfield(L, 2, "batch");
+  batch = luaL_checkoption(L, -1, NULL, BATCHES) + 1;
+  lua_pop(L, 1);
+
+  ext = lluv_stream_ext(L, handle);
+  lluv_stream_release_rbuf(L, handle);
+
+  /* unparsed data from framed read */
+  if(ext->fpos) lluv_stream_frame_compact(ext);
+  lluv_loop_task_cancel(&ext->frame_task);
+  ext->frame = 0;
+
+  ext->batch = (unsigned char)batch;
+  if(ext->batch == LLUV_BATCH_ARRAY && ext->flen && !ext->bchunks_n){
+    lluv_stream_batch_push_chunk(ext, ext->flen);
+  }
+
+  LLUV_READ_CB(handle) = luaL_ref(L, LLUV_LUA_REGISTRY);
+
+  err = uv_read_start(LLUV_H(handle, uv_stream_t), lluv_stream_alloc_frame_cb, lluv_on_stream_read_batch_cb);
+  if(err >= 0){
+    lluv_handle_lock(L, handle, LLUV_LOCK_READ);
+    /* data received before stop_read */
+    if(ext->flen){
+      lluv_loop_check_task_queue(lluv_loop_by_handle(&handle->handle), &ext->batch_task);
+    }
+  }
+
+  return lluv_return(L, handle, LLUV_READ_CB(handle), err);
+}
+
+static int lluv_stream_start_read(lua_State *L){
+  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
+  lluv_stream_ext_t *ext;
+  int err;
+
+  /* stream read by pipe_to */
+  if(LLUV_STREAM_EXT(handle) && LLUV_STREAM_EXT(handle)->pipe){
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, UV_EBUSY, NULL);
+  }
+
+  if(lua_type(L, 2) == LUA_TUSERDATA){
+    return lluv_stream_start_read_fbuf(L, handle);
+  }
+
+  if(lua_type(L, 2) == LUA_TTABLE){
+    int batch;
+    lua_getfield(L, 2, "batch");
+    batch = !lua_isnil(L, -1);
+    lua_pop(L, 1);
+    return batch ? lluv_stream_start_read_batch(L, handle) : lluv_stream_start_read_frame(L, handle);
+  }
+
+  lluv_check_args_with_cb(L, 2);
+  LLUV_READ_CB(handle) = luaL_ref(L, LLUV_LUA_REGISTRY);
+  lluv_stream_release_rbuf(L, handle);
+
+  /* data received by framed read but not delivered yet */
+  ext = LLUV_STREAM_EXT(handle);
+  if(ext && (ext->flen > ext->fpos))
+    lua_pushlstring(L, ext->fbuf + ext->fpos, ext->flen - ext->fpos);
+  else
+    lua_pushnil(L);
+  lluv_stream_release_frame(L, handle);
+
+  err = uv_read_start(LLUV_H(handle, uv_stream_t), lluv_alloc_buffer_cb, lluv_on_stream_read_cb);
+  if(err >= 0){
+    lluv_handle_lock(L, handle, LLUV_LOCK_READ);
+
+    /* deferred call done before next read callback */
+    if(!lua_isnil(L, -1)){
+      lua_rawgeti(L, LLUV_LUA_REGISTRY, LLUV_READ_CB(handle));
+      lua_pushvalue(L, 1);
+      lua_pushnil(L);
+      lua_pushvalue(L, -4);
+      lluv_loop_defer_call(L, lluv_loop_by_handle(&handle->handle), 3);
+    }
+  }
+  lua_pop(L, 1);
+
+  return lluv_return(L, handle, LLUV_READ_CB(handle), err);
+}
+
+static int lluv_stream_stop_read(lua_State *L){
+  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
+  int err;
+
+  lluv_check_none(L, 2);
+
+  if(LLUV_STREAM_EXT(handle) && LLUV_STREAM_EXT(handle)->pipe){
+    lluv_stream_pipe_cancel(L, handle);
+    lua_settop(L, 1);
+    return 1;
+  }
+
+  err = uv_read_stop(LLUV_H(handle, uv_stream_t));
+  if(err < 0){
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
+  }
+
+  if(LLUV_READ_CB(handle) != LUA_NOREF){
+    lluv_handle_unlock(L, handle, LLUV_LOCK_READ);
+    luaL_unref(L, LLUV_LUA_REGISTRY, LLUV_READ_CB(handle));
+    LLUV_READ_CB(handle) = LUA_NOREF;
+  }
+
+  lluv_stream_release_rbuf(L, handle);
+
+  lua_settop(L, 1);
+  return 1;
+}
+
+//}
+
+//{ Write
+
+static int lluv_stream_try_write(lua_State *L){
+  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
+  size_t len; const char *str = luaL_checklstring(L, 2, &len);
+  int err; uv_buf_t buf = lluv_buf_init((char*)str, len);
+
+  lluv_check_none(L, 3);
+
+  /* sendfile writes to socket from thread pool */
+  if(LLUV_STREAM_SENDFILE(LLUV_STREAM_EXT(handle))){
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, UV_EBUSY, NULL);
+  }
+
+  lluv_stream_cork_flush(L, handle);
+
+  err = uv_try_write(LLUV_H(handle, uv_stream_t), &buf, 1);
+  if(err < 0){
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
+  }
+
+  lua_pushinteger(L, err);
+  return 1;
+}
+
+static size_t lluv_stream_queue_size(lluv_handle_t *handle){
+#if LLUV_UV_VER_GE(1,19,0)
+  return uv_stream_get_write_queue_size(LLUV_H(handle, uv_stream_t));
+#else
+  return LLUV_H(handle, uv_stream_t)->write_queue_size;
+#endif
+}
+
+/* called after new data queued */
+static void lluv_stream_check_full(lua_State *L, lluv_handle_t *handle){
+  lluv_stream_ext_t *ext = LLUV_STREAM_EXT(handle);
+
+  if(!ext || !ext->wm_high || ext->wm_full) return;
+
+  if(lluv_stream_queue_size(handle) < ext->wm_high) return;
+
+  ext->wm_full = 1;
+
+  if(ext->on_full == LUA_NOREF) return;
+
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, ext->on_full);
+  lluv_handle_pushself(L, handle);
+  lluv_loop_defer_call(L, lluv_loop_by_handle(&handle->handle), 1);
+}
+
+/* called from write callbacks */
+static void lluv_stream_check_drain(lua_State *L, lluv_handle_t *handle){
+  lluv_stream_ext_t *ext = LLUV_STREAM_EXT(handle);
+
+  if(!ext || !ext->wm_full) return;
+
+  if(lluv_stream_queue_size(handle) > ext->wm_low) return;
+
+  ext->wm_full = 0;
+
+  if(ext->on_drain == LUA_NOREF) return;
+
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, ext->on_drain);
+  lluv_handle_pushself(L, handle);
+
+  LLUV_HANDLE_CALL_CB(L, handle, 1);
+}
+
+static void lluv_on_stream_write_cb(uv_write_t* arg, int status){
+  lluv_req_t    *req    = lluv_req_byptr((uv_req_t*)arg);
+  lluv_handle_t *handle = req->handle;
+  lua_State     *L      = LLUV_HCALLBACK_L(handle);
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  if(IS_(handle, OPEN)) lluv_stream_check_drain(L, handle);
+
+  if(!IS_(handle, OPEN) || !lluv_req_has_cb(L, req)){
+    lluv_req_free(L, req);
+
+    LLUV_CHECK_LOOP_CB_INVARIANT(L);
+    return;
+  }
+
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, req->cb);
+  lluv_handle_pushself(L, handle);
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, req->ctx);
+  lluv_req_free(L, req);
+
+  if(lua_isnil(L, -3)){
+    lua_pop(L, 3);
+
+    LLUV_CHECK_LOOP_CB_INVARIANT(L);
+    return;
+  }
+
+  lluv_push_status_ex(L, handle->flags, status);
+  lua_insert(L, -2);
+
+  LLUV_HANDLE_CALL_CB(L, handle, 3);
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+static void lluv_on_stream_write_corked_cb(uv_write_t* arg, int status){
+  lluv_req_t    *req    = lluv_req_byptr((uv_req_t*)arg);
+  lluv_handle_t *handle = req->handle;
+  lua_State     *L      = LLUV_HCALLBACK_L(handle);
+  int i;
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  if(IS_(handle, OPEN)) lluv_stream_check_drain(L, handle);
+
+  if(!IS_(handle, OPEN) || (req->ctx == LUA_NOREF)){
+    lluv_req_free(L, req);
+
+    LLUV_CHECK_LOOP_CB_INVARIANT(L);
+    return;
+  }
+
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, req->ctx);
+  lluv_req_free(L, req);
+
+  /* callbacks called in same order as writes were done */
+  for(i = 1; IS_(handle, OPEN); i += 2){
+    lua_rawgeti(L, -1, i);
+    if(lua_isnil(L, -1)){
+      lua_pop(L, 1);
+      break;
+    }
+    lluv_handle_pushself(L, handle);
+    lluv_push_status_ex(L, handle->flags, status);
+    lua_rawgeti(L, -4, i + 1);
+
+    LLUV_HANDLE_CALL_CB(L, handle, 3);
+  }
+  lua_pop(L, 1);
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+/* Send all corked writes using single write request.
+ * If there no callbacks to report error then it returns error code.
+ */
+static int lluv_stream_cork_flush(lua_State *L, lluv_handle_t *handle){
+  lluv_stream_ext_t *ext = LLUV_STREAM_EXT(handle);
+  lluv_req_t *req; int err, i;
+
+  if(!ext || !ext->wbufs_n) return 0;
+
+  if(!IS_(handle, OPEN) || uv_is_closing(LLUV_H(handle, uv_handle_t))){
+    lluv_stream_release_corked(L, ext);
+    return 0;
+  }
+
+  lluv_loop_task_cancel(&ext->flush);
+
+  lua_pushnil(L);
+  req = lluv_req_new(L, UV_WRITE, handle);
+  req->arg = ext->wdata;
+  req->ctx = ext->wcbs;
+  ext->wdata   = ext->wcbs   = LUA_NOREF;
+  ext->wdata_n = ext->wcbs_n = 0;
+
+  err = uv_write(LLUV_R(req, write), LLUV_H(handle, uv_stream_t),
+    ext->wbufs, ext->wbufs_n, lluv_on_stream_write_corked_cb
+  );
+  ext->wbufs_n = 0;
+
+  if(err >= 0){
+    lluv_stream_check_full(L, handle);
+    return 0;
+  }
+
+  if(req->ctx == LUA_NOREF){
+    lluv_req_free(L, req);
+    return err;
+  }
+
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, req->ctx);
+  lluv_req_free(L, req);
+
+  for(i = 1; ; i += 2){
+    lua_rawgeti(L, -1, i);
+    if(lua_isnil(L, -1)){
+      lua_pop(L, 1);
+      break;
+    }
+    lluv_handle_pushself(L, handle);
+    lluv_error_push(L, handle->flags, LLUV_ERR_UV, err);
+    lua_rawgeti(L, -4, i + 1);
+    lluv_loop_defer_call(L, lluv_loop_by_handle(&handle->handle), 3);
+  }
+  lua_pop(L, 1);
+
+  return 0;
+}
+
+static void lluv_stream_on_flush_task(lua_State *L, lluv_loop_task_t *task){
+  lluv_stream_ext_t *ext = (lluv_stream_ext_t*)((char*)task - offsetof(lluv_stream_ext_t, flush));
+  lluv_stream_cork_flush(L, ext->handle);
+}
+
+/* normalize stack to self, data, cb, ctx */
+static void lluv_stream_check_write_args(lua_State *L){
+  if(lua_gettop(L) == 4)
+    lluv_check_callable(L, 3);
+  else if(lua_gettop(L) == 2)
+    lua_settop(L, 4);
+  else{
+    lluv_check_args_with_cb(L, 3);
+    lua_settop(L, 4);
+  }
+}
+
+static int lluv_stream_cork_write(lua_State *L, lluv_handle_t *handle, uv_buf_t *buf, size_t n){
+  lluv_stream_ext_t *ext = LLUV_STREAM_EXT(handle);
+
+  lluv_stream_check_write_args(L);
+
+  if(ext->wbufs_n + n > ext->wbufs_cap){
+    size_t cap = ext->wbufs_cap ? ext->wbufs_cap : 16;
+    uv_buf_t *wbufs;
+
+    while(cap < ext->wbufs_n + n) cap *= 2;
+
+    wbufs = (uv_buf_t*)lluv_alloc(L, sizeof(uv_buf_t) * cap);
+    if(!wbufs){
+      return lluv_fail(L, handle->flags, LLUV_ERR_UV, UV_ENOMEM, NULL);
+    }
+
+    if(ext->wbufs){
+      memcpy(wbufs, ext->wbufs, sizeof(uv_buf_t) * ext->wbufs_n);
+      lluv_free(L, ext->wbufs);
+    }
+
+    ext->wbufs     = wbufs;
+    ext->wbufs_cap = cap;
+  }
+
+  memcpy(&ext->wbufs[ext->wbufs_n], buf, sizeof(uv_buf_t) * n);
+  ext->wbufs_n += n;
+
+  /* string/table */
+  if(ext->wdata == LUA_NOREF){
+    lua_newtable(L);
+    ext->wdata = luaL_ref(L, LLUV_LUA_REGISTRY);
+  }
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, ext->wdata);
+  lua_pushvalue(L, 2);
+  lua_rawseti(L, -2, ++ext->wdata_n);
+  lua_pop(L, 1);
+
+  if(!lua_isnil(L, 3)){
+    if(ext->wcbs == LUA_NOREF){
+      lua_newtable(L);
+      ext->wcbs = luaL_ref(L, LLUV_LUA_REGISTRY);
+    }
+    lua_rawgeti(L, LLUV_LUA_REGISTRY, ext->wcbs);
+    lua_pushvalue(L, 3); lua_rawseti(L, -2, ++ext->wcbs_n);
+    lua_pushvalue(L, 4); lua_rawseti(L, -2, ++ext->wcbs_n);
+    lua_pop(L, 1);
+  }
+
+  if(!ext->corked){
+    int err = lluv_loop_task_queue(lluv_loop_by_handle(&handle->handle), &ext->flush);
+    if(err < 0){
+      err = lluv_stream_cork_flush(L, handle);
+      if(err < 0) return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
+    }
+  }
+
+  lua_settop(L, 1);
+  return 1;
+}
+
+static int lluv_stream_cork(lua_State *L){
+  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
+  lluv_stream_ext_t *ext = lluv_stream_ext(L, handle);
+
+  ext->corked = 1;
+  lluv_loop_task_cancel(&ext->flush);
+
+  lua_settop(L, 1);
+  return 1;
+}
+
+static int lluv_stream_uncork(lua_State *L){
+  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
+  lluv_stream_ext_t *ext = LLUV_STREAM_EXT(handle);
+  int err;
+
+  if(ext) ext->corked = 0;
+
+  err = lluv_stream_cork_flush(L, handle);
+  if(err < 0){
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
+  }
+
+  lua_settop(L, 1);
+  return 1;
+}
+
+static int lluv_stream_set_try_write(lua_State *L){
+  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
+  lluv_stream_ext_t *ext = lluv_stream_ext(L, handle);
+
+  ext->try_write = lua_toboolean(L, 2) ? 1 : 0;
+
+  lua_settop(L, 1);
+  return 1;
+}
+
+static int lluv_stream_set_auto_cork(lua_State *L){
+  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
+  lluv_stream_ext_t *ext = lluv_stream_ext(L, handle);
+  int err = 0;
+
+  ext->auto_cork = lua_toboolean(L, 2) ? 1 : 0;
+
+  if(!ext->auto_cork && !ext->corked){
+    err = lluv_stream_cork_flush(L, handle);
+  }
+
+  if(err < 0){
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
+  }
+
+  lua_settop(L, 1);
+  return 1;
+}
+
+static int lluv_stream_write_(lua_State *L, lluv_handle_t *handle, uv_buf_t *buf, size_t n){
+  lluv_stream_ext_t *ext = LLUV_STREAM_EXT(handle);
+  int err; lluv_req_t *req;
+
+  if(LLUV_STREAM_CORKED(ext) && !LLUV_STREAM_SENDFILE(ext)){
+    return lluv_stream_cork_write(L, handle, buf, n);
+  }
+
+  /* try_write fails with EAGAIN if there pending writes, but completed
+   * writes may still wait for callbacks so check all handle requests.
+   */
+  if(ext && ext->try_write && (handle->lock_counter == 0)){
+    int written;
+
+    lluv_stream_check_write_args(L);
+
+    written = uv_try_write(LLUV_H(handle, uv_stream_t), buf, n);
+    if(written < 0) written = 0;
+
+    while(n && ((size_t)written >= buf->len)){
+      written -= buf->len;
+      ++buf; --n;
+    }
+
+    if(n == 0){
+      /* callback called same way as for regular write */
+      if(!lua_isnil(L, 3)){
+        lua_pushvalue(L, 3);
+        lua_pushvalue(L, 1);
+        lua_pushnil(L);
+        lua_pushvalue(L, 4);
+        lluv_loop_defer_call(L, lluv_loop_by_handle(&handle->handle), 3);
+      }
+      lua_settop(L, 1);
+      return 1;
+    }
+
+    buf->base += written;
+    buf->len  -= written;
+
+    /* restore original arguments for regular write */
+    if(lua_isnil(L, 3))      lua_settop(L, 2);
+    else if(lua_isnil(L, 4)) lua_settop(L, 3);
+  }
+
+  if(lua_gettop(L) == 4){
+    int ctx;
+    lluv_check_callable(L, -2);
+    ctx = luaL_ref(L, LLUV_LUA_REGISTRY);
+    req = lluv_req_new(L, UV_WRITE, handle);
+    lluv_req_ref(L, req); /* string/table */
+    req->ctx = ctx;
+  }
+  else{
+    if(lua_gettop(L) == 2)
+      lua_settop(L, 3);
+    else
+      lluv_check_args_with_cb(L, 3);
+
+    req = lluv_req_new(L, UV_WRITE, handle);
+    lluv_req_ref(L, req); /* string/table */
+  }
+
+  /* data can not be mixed with sendfile chunks */
+  if(LLUV_STREAM_SENDFILE(ext)) err = UV_EBUSY;
+  else err = uv_write(LLUV_R(req, write), LLUV_H(handle, uv_stream_t), buf, n, lluv_on_stream_write_cb);
+  if(err >= 0) lluv_stream_check_full(L, handle);
+
+  return lluv_return_req(L, handle, req, err);
+}
+
+static int lluv_stream_write_t(lua_State *L, lluv_handle_t  *handle){
+  int i, n = lua_rawlen(L, 2);
+  uv_buf_t *buf;
+  
+  assert(lua_type(L, 2) == LUA_TTABLE);
+
+  luaL_argcheck(L, n > 0, 2, "Empty array not supported");
+  
+  buf = (uv_buf_t*)lluv_alloca(sizeof(uv_buf_t) * n);
+  if(!buf){
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, ENOMEM, NULL); 
+  }
+
+  for(i = 0; i < n; ++i){
+    size_t len; const char *str;
+    lua_rawgeti(L, 2, i + 1);
+    str = luaL_checklstring(L, -1, &len);
+    buf[i] = lluv_buf_init((char*)str, len);
+    lua_pop(L, 1);
+  }
+
+  return lluv_stream_write_(L, handle, buf, n);
+}
+
+static int lluv_stream_write(lua_State *L){
+  lluv_handle_t  *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
+  if(lua_type(L, 2) == LUA_TTABLE){
+    return lluv_stream_write_t(L, handle);
+  }
+  else{
+    size_t len; const char *str = luaL_checklstring(L, 2, &len);
+    uv_buf_t buf = lluv_buf_init((char*)str, len);
+    return lluv_stream_write_(L, handle, &buf, 1);
+  }
+}
+
+static int lluv_stream_write2(lua_State *L){
+  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
+  lluv_handle_t *src    = lluv_check_stream(L, 2, LLUV_FLAG_OPEN);
+  size_t len; const char *str;
+  int err; lluv_req_t *req;
+  uv_buf_t buf;
+
+  if(lua_isfunction(L, 3)){
+    lua_pushliteral(L, ".");
+    lua_insert(L, 3);
+  }
+  str = luaL_checklstring(L, 3, &len);
+  buf = lluv_buf_init((char*)str, len);
+
+  if(lua_gettop(L) == 3)
+    lua_settop(L, 4);
+  else
+    lluv_check_args_with_cb(L, 4);
+
+  lluv_stream_cork_flush(L, handle);
+
+  req = lluv_req_new(L, UV_WRITE, handle);
+  lluv_req_ref(L, req); /* string */
+
+  if(LLUV_STREAM_SENDFILE(LLUV_STREAM_EXT(handle))) err = UV_EBUSY;
+  else err = uv_write2(LLUV_R(req, write), LLUV_H(handle, uv_stream_t), &buf, 1, LLUV_H(src, uv_stream_t), lluv_on_stream_write_cb);
+  if(err >= 0) lluv_stream_check_full(L, handle);
+
+  return lluv_return_req(L, handle, req, err);
+}
+
+//}
+
+//{ Pipe
+
+/* Pass data from one stream to another without Lua.
+ * Reading paused while destination write queue is above limit.
+ */
+
+#define LLUV_PIPE_LIMIT (4 * LLUV_BUFFER_SIZE)
+
+typedef struct lluv_stream_pipe_tag{
+  lluv_handle_t *src;       /* NULL if source handle was released */
+  lluv_handle_t *dst;
+  int            dst_ref;   /* keep destination alive */
+  int            cb;
+  size_t         limit;
+  size_t         pending;   /* write requests in progress */
+  unsigned char  paused;
+  unsigned char  done;      /* reading finished */
+  int            status;    /* first error */
+  uint64_t       nread;
+  uint64_t       nwritten;
+}lluv_stream_pipe_t;
+
+typedef struct lluv_stream_pipe_write_tag{
+  uv_write_t          req;
+  uv_buf_t            buf;  /* buffer from loop pool */
+  size_t              len;
+  lluv_stream_pipe_t *pipe;
+}lluv_stream_pipe_write_t;
+
+static void lluv_stream_pipe_free(lua_State *L, lluv_stream_pipe_t *pipe){
+  if(LLUV_STREAM_EXT(pipe->dst)) LLUV_STREAM_EXT(pipe->dst)->piped -= 1;
+  luaL_unref(L, LLUV_LUA_REGISTRY, pipe->cb);
+  luaL_unref(L, LLUV_LUA_REGISTRY, pipe->dst_ref);
+  lluv_free_t(L, lluv_stream_pipe_t, pipe);
+}
+
+/* source handle released while pipe still has writes in progress */
+static void lluv_stream_pipe_detach(lua_State *L, lluv_stream_ext_t *ext){
+  lluv_stream_pipe_t *pipe = ext->pipe;
+  if(!pipe) return;
+
+  ext->pipe  = NULL;
+  pipe->src  = NULL;
+  pipe->done = 1;
+
+  if(pipe->pending == 0) lluv_stream_pipe_free(L, pipe);
+}
+
+/* `defer` used when called not from libuv callback */
+static void lluv_stream_pipe_finish(lua_State *L, lluv_stream_pipe_t *pipe, int defer){
+  lluv_handle_t *src = pipe->src;
+
+  assert(pipe->done && (pipe->pending == 0));
+
+  if(!src){
+    lluv_stream_pipe_free(L, pipe);
+    return;
+  }
+
+  LLUV_STREAM_EXT(src)->pipe = NULL;
+
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, pipe->cb);
+  lluv_handle_pushself(L, src);
+  lluv_push_status_ex(L, src->flags, pipe->status);
+  lutil_pushint64(L, pipe->nread);
+  lutil_pushint64(L, pipe->nwritten);
+
+  lluv_stream_pipe_free(L, pipe);
+
+  if(lua_isnil(L, -5)){
+    lua_pop(L, 5);
+    lluv_handle_unlock(L, src, LLUV_LOCK_READ);
+    return;
+  }
+
+  if(defer){
+    lluv_loop_defer_call(L, lluv_loop_by_handle(&src->handle), 4);
+    lluv_handle_unlock(L, src, LLUV_LOCK_READ);
+    return;
+  }
+
+  lluv_handle_unlock(L, src, LLUV_LOCK_READ);
+
+  LLUV_HANDLE_CALL_CB(L, src, 4);
+}
+
+static void lluv_stream_pipe_stop(lua_State *L, lluv_stream_pipe_t *pipe, int status, int defer){
+  if((status < 0) && (pipe->status == 0)) pipe->status = status;
+
+  if(pipe->done) return;
+
+  pipe->done = 1;
+  if(pipe->src) uv_read_stop(LLUV_H(pipe->src, uv_stream_t));
+
+  if(pipe->pending == 0) lluv_stream_pipe_finish(L, pipe, defer);
+}
+
+static void lluv_stream_pipe_cancel(lua_State *L, lluv_handle_t *handle){
+  lluv_stream_pipe_stop(L, LLUV_STREAM_EXT(handle)->pipe, UV_ECANCELED, 1);
+}
+
+static void lluv_on_stream_pipe_read_cb(uv_stream_t* arg, ssize_t nread, const uv_buf_t* buf);
+
+static void lluv_on_stream_pipe_write_cb(uv_write_t* arg, int status){
+  lluv_stream_pipe_write_t *w      = (lluv_stream_pipe_write_t*)arg;
+  lluv_stream_pipe_t       *pipe   = w->pipe;
+  lluv_handle_t            *handle = pipe->dst;
+  lua_State                *L      = LLUV_HCALLBACK_L(handle);
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  if(IS_(handle, OPEN)) lluv_stream_check_drain(L, handle);
+
+  lluv_loop_buffer_free(lluv_loop_by_handle(&handle->handle), &w->buf);
+  if(status >= 0) pipe->nwritten += w->len;
+  lluv_free_t(L, lluv_stream_pipe_write_t, w);
+
+  pipe->pending -= 1;
+
+  /* destination is referenced by pipe */
+  lluv_handle_unlock(L, handle, LLUV_LOCK_REQ);
+
+  if(status < 0){
+    lluv_stream_pipe_stop(L, pipe, status, 0);
+  }
+  else if(pipe->done){
+    if(pipe->pending == 0) lluv_stream_pipe_finish(L, pipe, 0);
+  }
+  else if(pipe->paused && (lluv_stream_queue_size(handle) <= pipe->limit / 2)){
+    int err = uv_read_start(LLUV_H(pipe->src, uv_stream_t), lluv_alloc_buffer_cb, lluv_on_stream_pipe_read_cb);
+    pipe->paused = 0;
+    if(err < 0) lluv_stream_pipe_stop(L, pipe, err, 0);
+  }
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+static void lluv_on_stream_pipe_read_cb(uv_stream_t* arg, ssize_t nread, const uv_buf_t* buf){
+  lluv_handle_t      *handle = lluv_handle_byptr((uv_handle_t*)arg);
+  lua_State          *L      = LLUV_HCALLBACK_L(handle);
+  lluv_stream_pipe_t *pipe;
+  lluv_stream_pipe_write_t *w;
+  uv_buf_t wbuf;
+  int err;
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  pipe = IS_(handle, OPEN) ? LLUV_STREAM_EXT(handle)->pipe : NULL;
+
+  if((nread <= 0) || !pipe){
+    lluv_free_buffer((uv_handle_t*)arg, buf);
+    if(pipe && (nread < 0)){
+      lluv_stream_pipe_stop(L, pipe, (nread == UV_EOF) ? 0 : (int)nread, 0);
+    }
+
+    LLUV_CHECK_LOOP_CB_INVARIANT(L);
+    return;
+  }
+
+  pipe->nread += nread;
+
+  if(!IS_(pipe->dst, OPEN) || uv_is_closing(LLUV_H(pipe->dst, uv_handle_t))){
+    lluv_free_buffer((uv_handle_t*)arg, buf);
+    lluv_stream_pipe_stop(L, pipe, UV_ECANCELED, 0);
+
+    LLUV_CHECK_LOOP_CB_INVARIANT(L);
+    return;
+  }
+
+  w = lluv_alloc_t(L, lluv_stream_pipe_write_t);
+  if(!w){
+    lluv_free_buffer((uv_handle_t*)arg, buf);
+    lluv_stream_pipe_stop(L, pipe, UV_ENOMEM, 0);
+
+    LLUV_CHECK_LOOP_CB_INVARIANT(L);
+    return;
+  }
+
+  w->buf  = *buf;
+  w->len  = (size_t)nread;
+  w->pipe = pipe;
+  wbuf    = lluv_buf_init(buf->base, (size_t)nread);
+
+  err = uv_write(&w->req, LLUV_H(pipe->dst, uv_stream_t), &wbuf, 1, lluv_on_stream_pipe_write_cb);
+  if(err < 0){
+    lluv_free_buffer((uv_handle_t*)arg, buf);
+    lluv_free_t(L, lluv_stream_pipe_write_t, w);
+    lluv_stream_pipe_stop(L, pipe, err, 0);
+
+    LLUV_CHECK_LOOP_CB_INVARIANT(L);
+    return;
+  }
+
+  pipe->pending += 1;
+  lluv_handle_lock(L, pipe->dst, LLUV_LOCK_REQ);
+
+  lluv_stream_check_full(L, pipe->dst);
+
+  if(lluv_stream_queue_size(pipe->dst) >= pipe->limit){
+    uv_read_stop(arg);
+    pipe->paused = 1;
+  }
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+/* pipe_to(dst, [opts,] [cb]) */
+static int lluv_stream_pipe_to(lua_State *L){
+  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
+  lluv_handle_t *dst    = lluv_check_stream(L, 2, LLUV_FLAG_OPEN);
+  size_t limit = LLUV_PIPE_LIMIT;
+  lluv_stream_ext_t  *ext;
+  lluv_stream_pipe_t *pipe;
+  int err;
+
+  luaL_argcheck(L, handle->handle.loop == dst->handle.loop, 2, "streams should use same loop");
+
+  if(lua_istable(L, 3)){
+    lua_getfield(L, 3, "limit");
+    if(!lua_isnil(L, -1)){
+      int64_t v = lutil_checkint64(L, -1);
+      luaL_argcheck(L, v > 0, 3, "limit should be positive");
+      limit = (size_t)v;
+    }
+    lua_pop(L, 1);
+    lua_remove(L, 3);
+  }
+
+  if(lua_gettop(L) == 2)
+    lua_settop(L, 3);
+  else
+    lluv_check_args_with_cb(L, 3);
+
+  ext = lluv_stream_ext(L, handle);
+  if(ext->pipe || (handle->lock & LLUV_LOCK_READ) || LLUV_STREAM_SENDFILE(LLUV_STREAM_EXT(dst))){
+    lua_pop(L, 1);
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, UV_EBUSY, NULL);
+  }
+
+  pipe = lluv_alloc_t(L, lluv_stream_pipe_t);
+  lluv_stream_ext(L, dst)->piped += 1;
+  pipe->cb       = luaL_ref(L, LLUV_LUA_REGISTRY);
+  lua_pushvalue(L, 2);
+  pipe->dst_ref  = luaL_ref(L, LLUV_LUA_REGISTRY);
+  pipe->src      = handle;
+  pipe->dst      = dst;
+  pipe->limit    = limit;
+  pipe->pending  = 0;
+  pipe->paused   = pipe->done = 0;
+  pipe->status   = 0;
+  pipe->nread    = pipe->nwritten = 0;
+
+  err = uv_read_start(LLUV_H(handle, uv_stream_t), lluv_alloc_buffer_cb, lluv_on_stream_pipe_read_cb);
+  if(err < 0){
+    lua_rawgeti(L, LLUV_LUA_REGISTRY, pipe->cb);
+    lluv_stream_pipe_free(L, pipe);
+    if(lua_isnil(L, -1)){
+      lua_pop(L, 1);
+      return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
+    }
+    lua_pushvalue(L, 1);
+    lluv_error_push(L, handle->flags, LLUV_ERR_UV, err);
+    lua_pushinteger(L, 0);
+    lua_pushinteger(L, 0);
+    lluv_loop_defer_call(L, lluv_loop_by_handle(&handle->handle), 4);
+  }
+  else{
+    ext->pipe = pipe;
+    lluv_handle_lock(L, handle, LLUV_LOCK_READ);
+  }
+
+  lua_settop(L, 1);
+  return 1;
+}
+
+//}
+
+//{ Sendfile
+
+/* Send file content using uv_fs_sendfile in chunks.
+ * If socket can not accept whole chunk then next chunk is read to loop
+ * buffer and written with uv_write which waits until socket is writable.
+ */
+
+#ifndef LLUV_SENDFILE_CHUNK
+#  define LLUV_SENDFILE_CHUNK (1024 * 1024)
+#endif
+
+typedef struct lluv_stream_sendfile_tag{
+  uv_fs_t        fs;
+  uv_write_t     write;
+  lluv_handle_t *handle;
+  int            handle_ref; /* keep stream object alive */
+  uv_file        fd;
+  uv_os_fd_t     out;       /* own copy of socket descriptor */
+  int            file_ref;  /* keep file object alive */
+  int            cb;
+  int64_t        offset;
+  int64_t        remain;
+  uint64_t       sent;
+  uv_buf_t       buf;       /* loop buffer used to copy data */
+  size_t         len;       /* size of data in buffer */
+  unsigned char  copy;      /* next chunk should be copied */
+}lluv_stream_sendfile_t;
+
+static void lluv_stream_sendfile_step(lua_State *L, lluv_stream_sendfile_t *sf);
+
+static void lluv_stream_sendfile_free(lua_State *L, lluv_stream_sendfile_t *sf){
+#ifndef _WIN32
+  if(sf->out >= 0) close(sf->out);
+#endif
+  luaL_unref(L, LLUV_LUA_REGISTRY, sf->cb);
+  luaL_unref(L, LLUV_LUA_REGISTRY, sf->file_ref);
+  luaL_unref(L, LLUV_LUA_REGISTRY, sf->handle_ref);
+  lluv_free_t(L, lluv_stream_sendfile_t, sf);
+}
+
+static void lluv_stream_sendfile_finish(lua_State *L, lluv_stream_sendfile_t *sf, int status){
+  lluv_handle_t *handle = sf->handle;
+
+  /* extension already released if handle closed */
+  if(LLUV_STREAM_EXT(handle)) LLUV_STREAM_EXT(handle)->sendfile = NULL;
+
+  if(sf->buf.base){
+    lluv_loop_buffer_free(lluv_loop_by_handle(&handle->handle), &sf->buf);
+  }
+
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, sf->cb);
+  lluv_handle_pushself(L, handle);
+  lluv_push_status_ex(L, handle->flags, status);
+  lutil_pushint64(L, sf->sent);
+
+  lluv_stream_sendfile_free(L, sf);
+
+  if(lua_isnil(L, -4) || !IS_(handle, OPEN)){
+    lua_pop(L, 4);
+    lluv_handle_unlock(L, handle, LLUV_LOCK_REQ);
+    return;
+  }
+
+  lluv_handle_unlock(L, handle, LLUV_LOCK_REQ);
+
+  LLUV_HANDLE_CALL_CB(L, handle, 3);
+}
+
+static int lluv_stream_sendfile_closed(lluv_stream_sendfile_t *sf){
+  return !IS_(sf->handle, OPEN) || uv_is_closing(LLUV_H(sf->handle, uv_handle_t));
+}
+
+static void lluv_on_stream_sendfile_write_cb(uv_write_t* arg, int status){
+  lluv_stream_sendfile_t *sf = (lluv_stream_sendfile_t*)arg->data;
+  lua_State *L = LLUV_HCALLBACK_L(sf->handle);
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  if(sf->buf.base){
+    lluv_loop_buffer_free(lluv_loop_by_handle(&sf->handle->handle), &sf->buf);
+    sf->buf = lluv_buf_init(NULL, 0);
+  }
+
+  if(status < 0){
+    lluv_stream_sendfile_finish(L, sf, status);
+  }
+  else{
+    sf->offset += sf->len;
+    sf->remain -= sf->len;
+    sf->sent   += sf->len;
+    sf->len     = 0;
+    lluv_stream_sendfile_step(L, sf);
+  }
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+static void lluv_on_stream_sendfile_read_cb(uv_fs_t *arg){
+  lluv_stream_sendfile_t *sf = (lluv_stream_sendfile_t*)arg->data;
+  lua_State *L = LLUV_HCALLBACK_L(sf->handle);
+  ssize_t result = arg->result;
+  uv_buf_t buf;
+  int err;
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  uv_fs_req_cleanup(arg);
+
+  if((result <= 0) || lluv_stream_sendfile_closed(sf)){
+    /* zero means end of file */
+    lluv_stream_sendfile_finish(L, sf, (int)result);
+
+    LLUV_CHECK_LOOP_CB_INVARIANT(L);
+    return;
+  }
+
+  sf->len  = (size_t)result;
+  sf->copy = 0;
+  buf = lluv_buf_init(sf->buf.base, sf->len);
+
+  err = uv_write(&sf->write, LLUV_H(sf->handle, uv_stream_t), &buf, 1, lluv_on_stream_sendfile_write_cb);
+  if(err < 0) lluv_stream_sendfile_finish(L, sf, err);
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+static void lluv_on_stream_sendfile_cb(uv_fs_t *arg){
+  lluv_stream_sendfile_t *sf = (lluv_stream_sendfile_t*)arg->data;
+  lua_State *L = LLUV_HCALLBACK_L(sf->handle);
+  ssize_t result = arg->result;
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  uv_fs_req_cleanup(arg);
+
+  if(result > 0){
+    sf->offset += result;
+    sf->remain -= result;
+    sf->sent   += result;
+    /* socket buffer is full */
+    if((size_t)result < sf->len) sf->copy = 1;
+  }
+  sf->len = 0;
+
+  if(lluv_stream_sendfile_closed(sf)){
+    lluv_stream_sendfile_finish(L, sf, 0);
+  }
+  else if(result == UV_EAGAIN){
+    sf->copy = 1;
+    lluv_stream_sendfile_step(L, sf);
+  }
+  else if(result <= 0){
+    /* zero means end of file */
+    lluv_stream_sendfile_finish(L, sf, (int)result);
+  }
+  else{
+    lluv_stream_sendfile_step(L, sf);
+  }
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+static int lluv_stream_sendfile_submit(lua_State *L, lluv_stream_sendfile_t *sf){
+  lluv_loop_t *loop = lluv_loop_by_handle(&sf->handle->handle);
+  uv_buf_t buf;
+
+  if(!sf->copy){
+    sf->len = LLUV_SENDFILE_CHUNK;
+    if((int64_t)sf->len > sf->remain) sf->len = (size_t)sf->remain;
+    return uv_fs_sendfile(loop->handle, &sf->fs, (uv_file)sf->out, sf->fd, sf->offset, sf->len, lluv_on_stream_sendfile_cb);
+  }
+
+  sf->buf = lluv_loop_buffer_alloc(loop, LLUV_BUFFER_SIZE);
+  if(!sf->buf.base) return UV_ENOBUFS;
+
+  buf = sf->buf;
+  if((int64_t)buf.len > sf->remain) buf.len = (size_t)sf->remain;
+  return uv_fs_read(loop->handle, &sf->fs, sf->fd, &buf, 1, sf->offset, lluv_on_stream_sendfile_read_cb);
+}
+
+static void lluv_stream_sendfile_step(lua_State *L, lluv_stream_sendfile_t *sf){
+  int err = 0;
+
+  if((sf->remain != 0) && !lluv_stream_sendfile_closed(sf)){
+    err = lluv_stream_sendfile_submit(L, sf);
+    if(err >= 0) return;
+  }
+
+  lluv_stream_sendfile_finish(L, sf, err);
+}
+
+/* Data written before sendfile have to be sent first */
+static void lluv_on_stream_sendfile_barrier_cb(uv_write_t* arg, int status){
+  lluv_stream_sendfile_t *sf = (lluv_stream_sendfile_t*)arg->data;
+  lua_State *L = LLUV_HCALLBACK_L(sf->handle);
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  if(status < 0) lluv_stream_sendfile_finish(L, sf, status);
+  else lluv_stream_sendfile_step(L, sf);
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+/* sendfile(file, offset, length, [cb]) */
+static int lluv_stream_sendfile(lua_State *L){
+  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
+  uv_file        fd     = lluv_check_file_handle(L, 2);
+  int64_t        offset = lutil_checkint64(L, 3);
+  int64_t        length = lutil_checkint64(L, 4);
+  lluv_stream_ext_t *ext;
+  lluv_stream_sendfile_t *sf;
+  uv_os_fd_t out;
+  int err;
+
+  luaL_argcheck(L, offset >= 0, 3, "negative offset");
+  luaL_argcheck(L, length >= 0, 4, "negative length");
+
+  if(lua_gettop(L) == 4)
+    lua_settop(L, 5);
+  else
+    lluv_check_args_with_cb(L, 5);
+
+  /* only one writer can use socket while chunk sent from thread pool */
+  ext = lluv_stream_ext(L, handle);
+  if(ext->sendfile || ext->piped){
+    lua_pop(L, 1);
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, UV_EBUSY, NULL);
+  }
+
+  lluv_stream_cork_flush(L, handle);
+
+  sf = lluv_alloc_t(L, lluv_stream_sendfile_t);
+  if(!sf){
+    lua_pop(L, 1);
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, UV_ENOMEM, NULL);
+  }
+
+  err = uv_fileno(LLUV_H(handle, uv_handle_t), &out);
+
+#ifndef _WIN32
+  /* libuv closes socket with handle while thread pool may still
+   * send chunk, so descriptor could be reused by another file.
+   */
+  if(err >= 0){
+    out = dup(out);
+    if(out < 0) err = -errno;
+  }
+  else out = -1;
+#endif
+
+  sf->cb         = luaL_ref(L, LLUV_LUA_REGISTRY);
+  lua_pushvalue(L, 2);
+  sf->file_ref   = luaL_ref(L, LLUV_LUA_REGISTRY);
+  lua_pushvalue(L, 1);
+  sf->handle_ref = luaL_ref(L, LLUV_LUA_REGISTRY);
+  sf->handle     = handle;
+  sf->fd         = fd;
+  sf->out        = out;
+  sf->offset     = offset;
+  sf->remain     = length;
+  sf->sent       = 0;
+  sf->buf        = lluv_buf_init(NULL, 0);
+  sf->len        = 0;
+#ifdef _WIN32
+  /* uv_fs_sendfile does not support sockets */
+  sf->copy       = 1;
+#else
+  sf->copy       = 0;
+#endif
+  sf->fs.data    = sf;
+  sf->write.data = sf;
+
+  if((err >= 0) && (length > 0)){
+    if(lluv_stream_queue_size(handle) != 0){
+      uv_buf_t buf = lluv_buf_init(NULL, 0);
+      err = uv_write(&sf->write, LLUV_H(handle, uv_stream_t), &buf, 1, lluv_on_stream_sendfile_barrier_cb);
+    }
+    else{
+      err = lluv_stream_sendfile_submit(L, sf);
+    }
+
+    if(err >= 0){
+      ext->sendfile = sf;
+      lluv_handle_lock(L, handle, LLUV_LOCK_REQ);
+      lua_settop(L, 1);
+      return 1;
+    }
+  }
+
+  /* nothing to send or error */
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, sf->cb);
+  if(sf->buf.base){
+    lluv_loop_buffer_free(lluv_loop_by_handle(&handle->handle), &sf->buf);
+  }
+  lluv_stream_sendfile_free(L, sf);
+
+  if(lua_isnil(L, -1)){
+    lua_pop(L, 1);
+    if(err < 0) return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
+  }
+  else{
+    lua_pushvalue(L, 1);
+    lluv_push_status_ex(L, handle->flags, err);
+    lua_pushinteger(L, 0);
+    lluv_loop_defer_call(L, lluv_loop_by_handle(&handle->handle), 3);
+  }
+
+  lua_settop(L, 1);
+  return 1;
+}
+
+//}
+
+static int lluv_stream_is_readable(lua_State *L){
+  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
+  lua_settop(L, 1);
+  lua_pushboolean(L, uv_is_readable(LLUV_H(handle, uv_stream_t)));
+  return 1;
+}
+
+static int lluv_stream_is_writable(lua_State *L){
+  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
+  lua_settop(L, 1);
+  lua_pushboolean(L, uv_is_writable(LLUV_H(handle, uv_stream_t)));
+  return 1;
+}
+
+static int lluv_stream_set_blocking(lua_State *L){
+  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
+  int block = luaL_opt(L, lua_toboolean, 2, 1);
+  int err;
+
+  lua_settop(L, 1);
+
+  err = uv_stream_set_blocking(LLUV_H(handle, uv_stream_t), block);
+  if(err < 0){
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
+  }
+
+  return 1;
+}
+
+static int lluv_stream_get_write_queue_size(lua_State *L){
+  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
+  size_t queue_size;
+
+  lua_settop(L, 1);
+
+  queue_size = lluv_stream_queue_size(handle);
+
+  lutil_pushint64(L, queue_size);
+
+  return 1;
+}
+
+static int lluv_stream_set_write_watermarks(lua_State *L){
+  lluv_handle_t *handle = lluv_check_stream(L, 1, LLUV_FLAG_OPEN);
+  int64_t high = lutil_checkint64(L, 2);
+  int64_t low  = lutil_optint64(L, 3, high / 2);
+  lluv_stream_ext_t *ext;
+
+  luaL_argcheck(L, high >= 0, 2, "negative size");
+  luaL_argcheck(L, (low >= 0) && (low <= high), 3, "low watermark should be in range [0, high]");
+  if(!lua_isnoneornil(L, 4)) lluv_check_callable(L, 4);
+  if(!lua_isnoneornil(L, 5)) lluv_check_callable(L, 5);
+
+  ext = lluv_stream_ext(L, handle);
+
+  luaL_unref(L, LLUV_LUA_REGISTRY, ext->on_full);
+  luaL_unref(L, LLUV_LUA_REGISTRY, ext->on_drain);
+  ext->on_full = ext->on_drain = LUA_NOREF;
+
+  lua_settop(L, 5);
+  if(!lua_isnil(L, 5)) ext->on_drain = luaL_ref(L, LLUV_LUA_REGISTRY); else lua_pop(L, 1);
+  if(!lua_isnil(L, 4)) ext->on_full  = luaL_ref(L, LLUV_LUA_REGISTRY); else lua_pop(L, 1);
+
+  ext->wm_high = (size_t)high;
+  ext->wm_low  = (size_t)low;
+  ext->wm_full = 0;
+
+  if(ext->wm_high) lluv_stream_check_full(L, handle);
+
+  lua_settop(L, 1);
   return 1;
 }
 
@@ -527,6 +2233,13 @@ static const struct luaL_Reg lluv_stream_methods[] = {
   { "writable",             lluv_stream_is_writable           },
   { "set_blocking",         lluv_stream_set_blocking          },
   { "get_write_queue_size", lluv_stream_get_write_queue_size  },
+  { "set_write_watermarks", lluv_stream_set_write_watermarks  },
+  { "pipe_to",              lluv_stream_pipe_to               },
+  { "sendfile",             lluv_stream_sendfile              },
+  { "cork",                 lluv_stream_cork                  },
+  { "uncork",               lluv_stream_uncork                },
+  { "set_auto_cork",        lluv_stream_set_auto_cork         },
+  { "set_try_write",        lluv_stream_set_try_write         },
   
   {NULL,NULL}
 };
@@ -13,7 +13,8 @@
 
 LLUV_INTERNAL void lluv_stream_initlib(lua_State *L, int nup, int safe);
 
-LLUV_INTERNAL int lluv_stream_index(lua_State *L);
+/* Create handle metatable with stream methods */
+LLUV_INTERNAL void lluv_stream_createmeta(lua_State *L, int nup, uv_handle_type type, const char *meta);
 
 LLUV_INTERNAL lluv_handle_t* lluv_stream_create(lua_State *L, uv_handle_type type, lluv_flags_t flags);
 
@@ -23,4 +24,6 @@ LLUV_INTERNAL void lluv_on_stream_connect_cb(uv_connect_t* arg, int status);
 
 LLUV_INTERNAL void lluv_on_stream_req_cb(uv_req_t* arg, int status);
 
+LLUV_INTERNAL void lluv_stream_ext_free(lua_State *L, lluv_handle_t *handle);
+
 #endif
@@ -17,13 +17,23 @@
 #include "lluv_req.h"
 #include <assert.h>
 
+#ifndef _WIN32
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/socket.h>
+#endif
+
+#if LLUV_UV_VER_GE(1,49,0)
+#  define LLUV_TCP_REUSEPORT UV_TCP_REUSEPORT
+#else
+/* emulated flag. Not passed to libuv */
+#  define LLUV_TCP_REUSEPORT 0x10000
+#endif
+
 #define LLUV_TCP_NAME LLUV_PREFIX" tcp"
 static const char *LLUV_TCP = LLUV_TCP_NAME;
 
-LLUV_INTERNAL int lluv_tcp_index(lua_State *L){
-  return lluv__index(L, LLUV_TCP, lluv_stream_index);
-}
-
 LLUV_IMPL_SAFE_(lluv_tcp_create){
   lluv_loop_t   *loop   = lluv_opt_loop(L, 1, LLUV_FLAG_OPEN);
   lluv_handle_t *handle;
@@ -78,9 +88,44 @@ static int lluv_tcp_connect(lua_State *L){
   return lluv_return_req(L, handle, req, err);
 }
 
+#if !LLUV_UV_VER_GE(1,49,0)
+
+/* Set SO_REUSEPORT before bind.
+ * libuv creates socket only on bind so we may have to create it here.
+ */
+static int lluv_tcp_reuseport(lluv_handle_t *handle, const struct sockaddr *sa){
+#if defined(SO_REUSEPORT) && !defined(_WIN32)
+  uv_os_fd_t fd; int err, on = 1;
+
+  err = uv_fileno(LLUV_H(handle, uv_handle_t), &fd);
+  if(err == UV_EBADF){
+    fd = socket(sa->sa_family, SOCK_STREAM, 0);
+    if(fd < 0) return -errno;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    err = uv_tcp_open(LLUV_H(handle, uv_tcp_t), fd);
+    if(err < 0){
+      close(fd);
+      return err;
+    }
+  }
+  else if(err < 0) return err;
+
+  if(setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on))) return -errno;
+
+  return 0;
+#else
+  (void)handle; (void)sa;
+  return UV_ENOTSUP;
+#endif
+}
+
+#endif
+
 static int lluv_tcp_bind(lua_State *L){
   static const lluv_uv_const_t FLAGS[] = {
     { UV_TCP_IPV6ONLY ,   "ipv6only"   },
+    { LLUV_TCP_REUSEPORT, "reuseport"  },
 
     { 0, NULL }
   };
@@ -98,7 +143,7 @@ static int lluv_tcp_bind(lua_State *L){
   if(err < 0){
     lua_checkstack(L, 3);
 
-    lua_pushvalue(L, 2); lua_pushliteral(L, ":"); lua_pushvalue(L, 3); lua_concat(L, 3);
+    lluv_push_host_port(L, 2);
 
     if(!lua_isfunction(L, top)){
       return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, lua_tostring(L, -1));
@@ -113,11 +158,18 @@ static int lluv_tcp_bind(lua_State *L){
     return 1;
   }
 
+#if !LLUV_UV_VER_GE(1,49,0)
+  if(flags & LLUV_TCP_REUSEPORT){
+    flags &= ~LLUV_TCP_REUSEPORT;
+    err = lluv_tcp_reuseport(handle, (struct sockaddr *)&sa);
+  }
+  if(err >= 0)
+#endif
   err = uv_tcp_bind(LLUV_H(handle, uv_tcp_t), (struct sockaddr *)&sa, flags);
   if(err < 0){
     lua_checkstack(L, 3);
 
-    lua_pushvalue(L, 2); lua_pushliteral(L, ":"); lua_pushvalue(L, 3); lua_concat(L, 3);
+    lluv_push_host_port(L, 2);
 
     if(!lua_isfunction(L, top)){
       return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, lua_tostring(L, -1));
@@ -236,7 +288,8 @@ static const struct luaL_Reg lluv_tcp_methods[] = {
 };
 
 static const lluv_uv_const_t lluv_tcp_constants[] = {
-  { UV_TCP_IPV6ONLY,   "TCP_IPV6ONLY"   },
+  { UV_TCP_IPV6ONLY,    "TCP_IPV6ONLY"   },
+  { LLUV_TCP_REUSEPORT, "TCP_REUSEPORT"  },
 
 #if LLUV_UV_VER_GE(1,7,0)
   {AF_UNSPEC,          "AF_UNSPEC"      },
@@ -268,6 +321,7 @@ LLUV_INTERNAL void lluv_tcp_initlib(lua_State *L, int nup, int safe){
   if(!lutil_createmetap(L, LLUV_TCP, lluv_tcp_methods, nup))
     lua_pop(L, nup);
   lua_pop(L, 1);
+  lluv_stream_createmeta(L, nup, UV_TCP, LLUV_TCP);
 
   luaL_setfuncs(L, lluv_functions[safe], nup);
   lluv_register_constants(L, lluv_tcp_constants);
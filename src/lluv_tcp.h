@@ -13,8 +13,6 @@
 
 LLUV_INTERNAL void lluv_tcp_initlib(lua_State *L, int nup, int safe);
 
-LLUV_INTERNAL int lluv_tcp_index(lua_State *L);
-
 LLUV_INTERNAL int lluv_tcp_create_safe(lua_State *L);
 
 LLUV_INTERNAL int lluv_tcp_create_unsafe(lua_State *L);
@@ -0,0 +1,294 @@
+/******************************************************************************
+* Author: Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Copyright (C) 2014-2017 Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Licensed according to the included 'LICENSE' document
+*
+* This file is part of lua-lluv library.
+******************************************************************************/
+
+#include "lluv.h"
+#include "lluv_utils.h"
+#include "lluv_error.h"
+#include "lluv_serial.h"
+#include "lluv_thread.h"
+#include <lualib.h>
+#include <assert.h>
+#include <string.h>
+#ifndef _WIN32
+#  include <pthread.h>
+#endif
+
+/* Run Lua code in new OS thread.
+ * Each thread owns its own lua_State. If code loads lluv library
+ * then it gets its own default loop. Values passed to thread and
+ * returned from it are serialized. Threads communicate with channels.
+ *
+ * Thread state shared by Lua object and OS thread and freed by last one.
+ * Not joined thread detached when Lua object collected.
+ */
+
+#define LLUV_THREAD_NAME LLUV_PREFIX" Thread"
+static const char *LLUV_THREAD = LLUV_THREAD_NAME;
+
+#define LLUV_THREAD_NONE    0
+#define LLUV_THREAD_RUNNING 1
+#define LLUV_THREAD_JOINED  2
+
+typedef struct lluv_thread_tag{
+  uv_thread_t  tid;
+  lluv_flags_t flags;
+  int          state;
+  int          failed;
+  int          refs;   /* Lua object and running OS thread */
+  uv_mutex_t   mutex;
+  lluv_sbuf_t  code;
+  lluv_sbuf_t  data;   /* arguments and then results or error message */
+} lluv_thread_t;
+
+static lluv_thread_t *lluv_thread_new(void){
+  lluv_thread_t *t = lluv_alloc_t(NULL, lluv_thread_t);
+  if(!t) return NULL;
+
+  if(uv_mutex_init(&t->mutex) < 0){
+    lluv_free_t(NULL, lluv_thread_t, t);
+    return NULL;
+  }
+
+  t->state  = LLUV_THREAD_NONE;
+  t->failed = 0;
+  t->refs   = 1;
+  lluv_sbuf_init(&t->code);
+  lluv_sbuf_init(&t->data);
+
+  return t;
+}
+
+static void lluv_thread_unref(lluv_thread_t *t){
+  int refs;
+
+  uv_mutex_lock(&t->mutex);
+  refs = --t->refs;
+  uv_mutex_unlock(&t->mutex);
+
+  if(refs != 0) return;
+
+  if(!t->failed) lluv_serial_release(t->data.data, t->data.size);
+  lluv_sbuf_free(&t->data);
+  lluv_sbuf_free(&t->code);
+  uv_mutex_destroy(&t->mutex);
+  lluv_free_t(NULL, lluv_thread_t, t);
+}
+
+static void lluv_thread_fail(lluv_thread_t *t, const char *msg, size_t len){
+  lluv_serial_release(t->data.data, t->data.size);
+  t->failed = 1;
+  t->data.size = 0;
+  lluv_sbuf_append(&t->data, msg, len);
+}
+
+static void lluv_thread_fail_lua(lluv_thread_t *t, lua_State *L){
+  size_t len; const char *msg = lua_tolstring(L, -1, &len);
+  if(!msg) msg = "(error object is not a string)", len = strlen(msg);
+  lluv_thread_fail(t, msg, len);
+}
+
+static void lluv_thread_run(lluv_thread_t *t){
+  lua_State *L = luaL_newstate();
+  const char *msg;
+  int n;
+
+  if(!L){
+    msg = "can not create Lua state";
+    lluv_thread_fail(t, msg, strlen(msg));
+    return;
+  }
+
+  luaL_openlibs(L);
+
+  if(luaL_loadbuffer(L, t->code.data, t->code.size, "=thread")){
+    lluv_thread_fail_lua(t, L);
+    lua_close(L);
+    return;
+  }
+
+  n = lluv_serial_decode(L, t->data.data, t->data.size);
+  t->data.size = 0;
+  if(n < 0){
+    msg = "invalid arguments";
+    lluv_thread_fail(t, msg, strlen(msg));
+    lua_close(L);
+    return;
+  }
+
+  if(lua_pcall(L, n, LUA_MULTRET, 0)){
+    lluv_thread_fail_lua(t, L);
+    lua_close(L);
+    return;
+  }
+
+  if(lluv_serial_encode(L, 1, lua_gettop(L), &t->data, &msg)){
+    lluv_thread_fail(t, msg, strlen(msg));
+  }
+
+  lua_close(L);
+}
+
+static void lluv_thread_main(void *arg){
+  lluv_thread_t *t = (lluv_thread_t*)arg;
+  lluv_thread_run(t);
+  lluv_thread_unref(t);
+}
+
+static lluv_thread_t *lluv_check_thread(lua_State *L, int idx){
+  lluv_thread_t **t = (lluv_thread_t **)lutil_checkudatap (L, idx, LLUV_THREAD);
+  luaL_argcheck (L, t != NULL && *t != NULL, idx, LLUV_THREAD_NAME" expected");
+  return *t;
+}
+
+static void lluv_thread_wait(lluv_thread_t *t){
+  if(t->state != LLUV_THREAD_RUNNING) return;
+  uv_thread_join(&t->tid);
+  t->state = LLUV_THREAD_JOINED;
+}
+
+/* OS thread releases its resources when done */
+static void lluv_thread_detach(lluv_thread_t *t){
+  if(t->state != LLUV_THREAD_RUNNING) return;
+#ifdef _WIN32
+  CloseHandle(t->tid);
+#else
+  pthread_detach(t->tid);
+#endif
+  t->state = LLUV_THREAD_NONE;
+}
+
+/* thread(code, ...) */
+LLUV_IMPL_SAFE(lluv_thread_create){
+  lluv_thread_t **pt, *t;
+  const char *msg;
+  int err;
+
+  luaL_argcheck(L, lua_type(L, 1) == LUA_TSTRING || lua_type(L, 1) == LUA_TFUNCTION,
+    1, "string or function expected"
+  );
+
+  pt = lutil_newudatap(L, lluv_thread_t*, LLUV_THREAD);
+  *pt = t = lluv_thread_new();
+  if(!t){
+    return lluv_fail(L, safe_flag, LLUV_ERR_UV, UV_ENOMEM, NULL);
+  }
+  t->flags = safe_flag;
+
+  err = lluv_serial_code(L, 1, &t->code);
+  if(err < 0){
+    if(err == UV_ENOMEM) return lluv_fail(L, safe_flag, LLUV_ERR_UV, UV_ENOMEM, NULL);
+    return luaL_argerror(L, 1, "can not dump function");
+  }
+
+  if(lluv_serial_encode(L, 2, lua_gettop(L) - 1, &t->data, &msg)){
+    lluv_serial_release(t->data.data, t->data.size);
+    t->data.size = 0;
+    return luaL_error(L, "%s", msg);
+  }
+
+  t->refs = 2;
+  err = uv_thread_create(&t->tid, lluv_thread_main, t);
+  if(err < 0){
+    t->refs = 1;
+    lluv_serial_release(t->data.data, t->data.size);
+    t->data.size = 0;
+    return lluv_fail(L, safe_flag, LLUV_ERR_UV, (uv_errno_t)err, NULL);
+  }
+  t->state = LLUV_THREAD_RUNNING;
+
+  return 1;
+}
+
+/* returns true and values returned by thread function */
+static int lluv_thread_join(lua_State *L){
+  lluv_thread_t *t = lluv_check_thread(L, 1);
+  int n;
+
+  luaL_argcheck(L, t->state == LLUV_THREAD_RUNNING, 1, LLUV_THREAD_NAME" already joined");
+
+  lluv_thread_wait(t);
+
+  if(t->failed){
+    lluv_sbuf_append(&t->data, "", 1);
+    lua_pushstring(L, t->data.data);
+    lluv_sbuf_free(&t->data);
+    return lluv_fail(L, t->flags, LLUV_ERR_LIB, UV_EINVAL, lua_tostring(L, -1));
+  }
+
+  lua_settop(L, 1);
+  lua_pushboolean(L, 1);
+  n = lluv_serial_decode(L, t->data.data, t->data.size);
+  lluv_sbuf_free(&t->data);
+  if(n < 0){
+    return lluv_fail(L, t->flags, LLUV_ERR_LIB, UV_EINVAL, "invalid results");
+  }
+
+  return n + 1;
+}
+
+static int lluv_thread_joined(lua_State *L){
+  lluv_thread_t *t = lluv_check_thread(L, 1);
+  lua_pushboolean(L, t->state == LLUV_THREAD_JOINED);
+  return 1;
+}
+
+/* running thread is not waited so it can run its own loop forever */
+static int lluv_thread_gc(lua_State *L){
+  lluv_thread_t **t = (lluv_thread_t **)lutil_checkudatap (L, 1, LLUV_THREAD);
+  if(!t || !*t) return 0;
+
+  lluv_thread_detach(*t);
+  lluv_thread_unref(*t);
+  *t = NULL;
+
+  return 0;
+}
+
+static int lluv_thread_to_s(lua_State *L){
+  lluv_thread_t *t = lluv_check_thread(L, 1);
+  lua_pushfstring(L, LLUV_THREAD_NAME" (%p)", t);
+  return 1;
+}
+
+static const struct luaL_Reg lluv_thread_methods[] = {
+  { "join",       lluv_thread_join     },
+  { "joined",     lluv_thread_joined   },
+  { "__gc",       lluv_thread_gc       },
+  { "__tostring", lluv_thread_to_s     },
+
+  {NULL,NULL}
+};
+
+#define LLUV_FUNCTIONS(F)             \
+  {"thread", lluv_thread_create_##F}, \
+
+static const struct luaL_Reg lluv_functions[][2] = {
+  {
+    LLUV_FUNCTIONS(unsafe)
+
+    {NULL,NULL}
+  },
+  {
+    LLUV_FUNCTIONS(safe)
+
+    {NULL,NULL}
+  },
+};
+
+LLUV_INTERNAL void lluv_thread_initlib(lua_State *L, int nup, int safe){
+  assert((safe == 0) || (safe == 1));
+
+  lutil_pushnvalues(L, nup);
+  if(!lutil_createmetap(L, LLUV_THREAD, lluv_thread_methods, nup))
+    lua_pop(L, nup);
+  lua_pop(L, 1);
+
+  luaL_setfuncs(L, lluv_functions[safe], nup);
+}
@@ -14,13 +14,23 @@
 #include "lluv_loop.h"
 #include "lluv_error.h"
 #include <assert.h>
+#include <string.h>
 
 #define LLUV_TIMER_NAME LLUV_PREFIX" Timer"
 static const char *LLUV_TIMER = LLUV_TIMER_NAME;
 
-LLUV_INTERNAL int lluv_timer_index(lua_State *L){
-  return lluv__index(L, LLUV_TIMER, lluv_handle_index);
-}
+#define LLUV_TIMER_WHEEL_NAME LLUV_PREFIX" Timer wheel"
+static const char *LLUV_TIMER_WHEEL = LLUV_TIMER_WHEEL_NAME;
+
+/* timer ext structures start with type field */
+#define LLUV_TIMER_EXT_WHEEL 1
+#define LLUV_TIMER_EXT_SLACK 2
+
+#define LLUV_TIMER_EXT_TYPE(H) ((H)->ext ? *(int*)(H)->ext : 0)
+
+typedef struct lluv_timer_wheel_tag lluv_timer_wheel_t;
+
+static lluv_timer_wheel_t *lluv_timer_wheel(lluv_handle_t *handle);
 
 LLUV_IMPL_SAFE(lluv_timer_create){
   lluv_loop_t   *loop   = lluv_opt_loop_ex(L, 1, LLUV_FLAG_OPEN);
@@ -35,7 +45,7 @@ LLUV_IMPL_SAFE(lluv_timer_create){
 
 static lluv_handle_t* lluv_check_timer(lua_State *L, int idx, lluv_flags_t flags){
   lluv_handle_t *handle = lluv_check_handle(L, idx, flags);
-  luaL_argcheck (L, LLUV_H(handle, uv_handle_t)->type == UV_TIMER, idx, LLUV_TIMER_NAME" expected");
+  luaL_argcheck (L, LLUV_H(handle, uv_handle_t)->type == UV_TIMER && !lluv_timer_wheel(handle), idx, LLUV_TIMER_NAME" expected");
 
   return handle;
 }
@@ -50,11 +60,231 @@ static void lluv_on_timer_start(uv_timer_t *arg){
   lluv_on_handle_start(h);
 }
 
+//{ Coalesced timers
+
+/* Timer started with slack may fire at any time in [deadline, deadline + slack].
+ * Group leader owns running uv timer and fires all members of its group.
+ * New timer joins first group which fire time falls into its window,
+ * otherwise it becomes leader of new group firing at the end of window.
+ */
+
+#define LLUV_SLACK_NONE   0
+#define LLUV_SLACK_LEADER 1
+#define LLUV_SLACK_MEMBER 2
+#define LLUV_SLACK_FIRING 3
+
+typedef struct lluv_timer_slack_tag lluv_timer_slack_t;
+
+struct lluv_timer_slack_tag{
+  int                  type;
+  lluv_handle_t       *handle;
+  int                  state;
+  uint64_t             slack;
+  uint64_t             deadline;
+  uint64_t             repeat;
+  uint64_t             fire_at;  /* leader only */
+  lluv_timer_slack_t  *members;  /* leader only */
+  lluv_timer_slack_t  *next;
+  lluv_timer_slack_t **prev;
+};
+
+static lluv_timer_slack_t *lluv_timer_slack(lluv_handle_t *handle){
+  if(LLUV_TIMER_EXT_TYPE(handle) == LLUV_TIMER_EXT_SLACK) return (lluv_timer_slack_t*)handle->ext;
+  return NULL;
+}
+
+static void lluv_timer_slack_link(lluv_timer_slack_t **head, lluv_timer_slack_t *t){
+  t->next = *head;
+  if(t->next) t->next->prev = &t->next;
+  t->prev = head;
+  *head = t;
+}
+
+static void lluv_timer_slack_unlink(lluv_timer_slack_t *t){
+  *t->prev = t->next;
+  if(t->next) t->next->prev = t->prev;
+  t->next = NULL;
+  t->prev = NULL;
+}
+
+static void lluv_on_timer_slack(uv_timer_t *arg);
+
+static void lluv_timer_slack_lead(lluv_timer_slack_t *t, uint64_t fire_at){
+  lluv_loop_t *loop = lluv_loop_by_handle(&t->handle->handle);
+  uint64_t now = uv_now(loop->handle);
+
+  t->state   = LLUV_SLACK_LEADER;
+  t->fire_at = fire_at;
+  lluv_timer_slack_link(&loop->slack_timers, t);
+
+  uv_timer_start(LLUV_H(t->handle, uv_timer_t), lluv_on_timer_slack,
+    (fire_at > now) ? (fire_at - now) : 0, 0
+  );
+}
+
+static void lluv_timer_slack_join(lluv_timer_slack_t *t){
+  lluv_loop_t *loop = lluv_loop_by_handle(&t->handle->handle);
+  lluv_timer_slack_t *leader;
+
+  assert(t->state == LLUV_SLACK_NONE);
+
+  for(leader = loop->slack_timers; leader; leader = leader->next){
+    if((leader->fire_at >= t->deadline) && (leader->fire_at <= t->deadline + t->slack)){
+      t->state = LLUV_SLACK_MEMBER;
+      lluv_timer_slack_link(&leader->members, t);
+      return;
+    }
+  }
+
+  lluv_timer_slack_lead(t, t->deadline + t->slack);
+}
+
+static void lluv_timer_slack_leave(lluv_timer_slack_t *t){
+  if(t->state == LLUV_SLACK_NONE) return;
+
+  lluv_timer_slack_unlink(t);
+
+  if(t->state == LLUV_SLACK_LEADER){
+    lluv_timer_slack_t *m;
+
+    uv_timer_stop(LLUV_H(t->handle, uv_timer_t));
+
+    /* pass group to first member which is not closing */
+    while((m = t->members)){
+      lluv_timer_slack_unlink(m);
+      if(!uv_is_closing(LLUV_H(m->handle, uv_handle_t))) break;
+      m->state = LLUV_SLACK_NONE;
+    }
+
+    if(m){
+      m->members = t->members;
+      if(m->members) m->members->prev = &m->members;
+      t->members = NULL;
+      lluv_timer_slack_lead(m, t->fire_at);
+    }
+  }
+
+  t->state = LLUV_SLACK_NONE;
+}
+
+static void lluv_on_timer_slack(uv_timer_t *arg){
+  lluv_handle_t *handle = lluv_handle_byptr((uv_handle_t*)arg);
+  lluv_timer_slack_t *leader = lluv_timer_slack(handle), *batch = NULL, *t;
+  lua_State *L = LLUV_HCALLBACK_L(handle);
+  uint64_t now;
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  assert(leader && leader->state == LLUV_SLACK_LEADER);
+
+  /* callbacks may stop/start any timer so move group to local list */
+  lluv_timer_slack_unlink(leader);
+  batch = leader->members;
+  if(batch) batch->prev = &batch;
+  leader->members = NULL;
+  lluv_timer_slack_link(&batch, leader);
+  for(t = batch; t; t = t->next) t->state = LLUV_SLACK_FIRING;
+
+  now = uv_now(arg->loop);
+
+  while((t = batch)){
+    lluv_handle_t *h = t->handle;
+
+    lluv_timer_slack_unlink(t);
+    t->state = LLUV_SLACK_NONE;
+
+    if(!IS_(h, OPEN) || uv_is_closing(LLUV_H(h, uv_handle_t))) continue;
+
+    lua_rawgeti(L, LLUV_LUA_REGISTRY, LLUV_START_CB(h));
+    lluv_handle_pushself(L, h);
+
+    if(t->repeat){
+      t->deadline = now + t->repeat;
+      lluv_timer_slack_join(t);
+    }
+    else{
+      lluv_handle_unlock(L, h, LLUV_LOCK_START);
+    }
+
+    LLUV_HANDLE_CALL_CB(L, h, 1);
+  }
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+static void lluv_timer_slack_free(lua_State *L, lluv_handle_t *handle){
+  lluv_timer_slack_t *t = lluv_timer_slack(handle);
+  if(!t) return;
+
+  lluv_timer_slack_leave(t);
+  lluv_free_t(L, lluv_timer_slack_t, t);
+  handle->ext = NULL;
+}
+
+/* timer:start(timeout, repeat, {slack = ms}, cb) */
+static int lluv_timer_start_slack(lua_State *L, lluv_handle_t *handle){
+  lluv_loop_t *loop = lluv_loop_by_handle(&handle->handle);
+  lluv_timer_slack_t *t = lluv_timer_slack(handle);
+  int64_t timeout, repeat, slack;
+
+  lluv_check_args_with_cb(L, 5);
+
+  timeout = lutil_checkint64(L, 2);
+  repeat  = lutil_optint64(L, 3, 0);
+
+  lua_getfield(L, 4, "slack");
+  slack = lutil_optint64(L, -1, 0);
+  lua_pop(L, 1);
+
+  luaL_argcheck(L, slack >= 0, 4, "slack should be non negative");
+
+  if(timeout < 0) timeout = 0;
+  if(repeat  < 0) repeat  = 0;
+
+  if(!t){
+    t = lluv_alloc_t(L, lluv_timer_slack_t);
+    if(!t){
+      return lluv_fail(L, handle->flags, LLUV_ERR_UV, UV_ENOMEM, NULL);
+    }
+    t->type    = LLUV_TIMER_EXT_SLACK;
+    t->handle  = handle;
+    t->state   = LLUV_SLACK_NONE;
+    t->members = NULL;
+    t->next    = NULL;
+    t->prev    = NULL;
+    handle->ext = t;
+  }
+
+  lluv_timer_slack_leave(t);
+  uv_timer_stop(LLUV_H(handle, uv_timer_t));
+
+  luaL_unref(L, LLUV_LUA_REGISTRY, LLUV_START_CB(handle));
+  LLUV_START_CB(handle) = luaL_ref(L, LLUV_LUA_REGISTRY);
+
+  t->slack    = (uint64_t)slack;
+  t->repeat   = (uint64_t)repeat;
+  t->deadline = uv_now(loop->handle) + (uint64_t)timeout;
+
+  lluv_timer_slack_join(t);
+  lluv_handle_lock(L, handle, LLUV_LOCK_START);
+
+  lua_settop(L, 1);
+  return 1;
+}
+
+//}
+
 static int lluv_timer_start(lua_State *L){
   lluv_handle_t *handle = lluv_check_timer(L, 1, LLUV_FLAG_OPEN);
   uint64_t timeout, repeat;
   int err;
 
+  if(lua_type(L, 4) == LUA_TTABLE){
+    return lluv_timer_start_slack(L, handle);
+  }
+
+  lluv_timer_slack_free(L, handle);
+
   lluv_check_args_with_cb(L, 4);
   LLUV_START_CB(handle) = luaL_ref(L, LLUV_LUA_REGISTRY);
 
@@ -79,7 +309,11 @@ static int lluv_timer_start(lua_State *L){
 
 static int lluv_timer_stop(lua_State *L){
   lluv_handle_t *handle = lluv_check_timer(L, 1, LLUV_FLAG_OPEN);
-  int err = uv_timer_stop(LLUV_H(handle, uv_timer_t));
+  int err;
+
+  if(lluv_timer_slack(handle)) lluv_timer_slack_leave(lluv_timer_slack(handle));
+
+  err = uv_timer_stop(LLUV_H(handle, uv_timer_t));
   if(err < 0){
     return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
   }
@@ -92,7 +326,22 @@ static int lluv_timer_stop(lua_State *L){
 
 static int lluv_timer_again(lua_State *L){
   lluv_handle_t *handle = lluv_check_timer(L, 1, LLUV_FLAG_OPEN);
+  lluv_timer_slack_t *t = lluv_timer_slack(handle);
   int err;
+
+  if(t){
+    if(lua_isnumber(L, 2)) t->repeat = lutil_optint64(L, 2, 0);
+    if(!t->repeat){
+      return lluv_fail(L, handle->flags, LLUV_ERR_UV, UV_EINVAL, NULL);
+    }
+    lluv_timer_slack_leave(t);
+    t->deadline = uv_now(LLUV_H(handle, uv_handle_t)->loop) + t->repeat;
+    lluv_timer_slack_join(t);
+    lluv_handle_lock(L, handle, LLUV_LOCK_START);
+    lua_settop(L, 1);
+    return 1;
+  }
+
   if(lua_isnumber(L, 2)){
     uint64_t repeat = lutil_optint64(L, 2, 0);
     uv_timer_set_repeat(LLUV_H(handle, uv_timer_t), repeat);
@@ -111,18 +360,512 @@ static int lluv_timer_again(lua_State *L){
 static int lluv_timer_set_repeat(lua_State *L){
   lluv_handle_t *handle = lluv_check_timer(L, 1, LLUV_FLAG_OPEN);
   uint64_t repeat = lutil_optint64(L, 2, 0);
-  uv_timer_set_repeat(LLUV_H(handle, uv_timer_t), repeat);
+  if(lluv_timer_slack(handle)) lluv_timer_slack(handle)->repeat = repeat;
+  else uv_timer_set_repeat(LLUV_H(handle, uv_timer_t), repeat);
   lua_settop(L, 1);
   return 1;
 }
 
 static int lluv_timer_get_repeat(lua_State *L){
   lluv_handle_t *handle = lluv_check_timer(L, 1, LLUV_FLAG_OPEN);
-  uint64_t repeat = uv_timer_get_repeat(LLUV_H(handle, uv_timer_t));
+  uint64_t repeat = lluv_timer_slack(handle) ? lluv_timer_slack(handle)->repeat :
+    uv_timer_get_repeat(LLUV_H(handle, uv_timer_t));
   lutil_pushint64(L, repeat);
   return 1;
 }
 
+//{ Timer wheel
+
+/* Hierarchical timing wheel (same layout as Linux kernel timers).
+ * All timeouts served by single uv_timer_t which wakes only when
+ * there is something to do. Timeouts stored in plain C array and
+ * callbacks with arguments in two Lua tables indexed by entry id.
+ */
+
+#define LLUV_WHEEL_ROOT_BITS 8
+#define LLUV_WHEEL_ROOT_SIZE (1 << LLUV_WHEEL_ROOT_BITS)
+#define LLUV_WHEEL_ROOT_MASK (LLUV_WHEEL_ROOT_SIZE - 1)
+#define LLUV_WHEEL_LVL_BITS  6
+#define LLUV_WHEEL_LVL_SIZE  (1 << LLUV_WHEEL_LVL_BITS)
+#define LLUV_WHEEL_LVL_MASK  (LLUV_WHEEL_LVL_SIZE - 1)
+#define LLUV_WHEEL_LEVELS    4
+
+/* list heads live in the same array as entries */
+#define LLUV_WHEEL_WORK      (LLUV_WHEEL_ROOT_SIZE + LLUV_WHEEL_LEVELS * LLUV_WHEEL_LVL_SIZE)
+#define LLUV_WHEEL_HEADS     (LLUV_WHEEL_WORK + 1)
+
+#define LLUV_WHEEL_LVL_HEAD(N, I) (LLUV_WHEEL_ROOT_SIZE + ((N) - 1) * LLUV_WHEEL_LVL_SIZE + (I))
+#define LLUV_WHEEL_LVL_INDEX(J, N) (((J) >> (LLUV_WHEEL_ROOT_BITS + ((N) - 1) * LLUV_WHEEL_LVL_BITS)) & LLUV_WHEEL_LVL_MASK)
+
+#define LLUV_WHEEL_MAX_TICKS 0x7FFFFFFF
+
+#define LLUV_WHEEL_NARGS_PACKED 2
+
+typedef struct lluv_wheel_entry_tag{
+  uint32_t next;
+  uint32_t prev;
+  uint32_t expire;  /* tick */
+  uint16_t gen;     /* to detect stale tokens */
+  uint8_t  used;
+  uint8_t  nargs;   /* 0, 1 or LLUV_WHEEL_NARGS_PACKED */
+}lluv_wheel_entry_t;
+
+struct lluv_timer_wheel_tag{
+  int                 type;
+  lluv_handle_t      *handle;
+  uint64_t            base;     /* loop time of tick 0 */
+  uint64_t            jiffies;  /* next tick to proceed */
+  uint64_t            wake;     /* tick uv timer started for */
+  uint32_t            res;      /* tick length in ms */
+  lluv_wheel_entry_t *e;
+  uint32_t            size;
+  uint32_t            cap;
+  uint32_t            free;     /* free entries list */
+  size_t              count;    /* pending timeouts */
+  int                 running;
+  int                 cbs;
+  int                 args;
+};
+
+static lluv_timer_wheel_t *lluv_timer_wheel(lluv_handle_t *handle){
+  if(LLUV_TIMER_EXT_TYPE(handle) == LLUV_TIMER_EXT_WHEEL) return (lluv_timer_wheel_t*)handle->ext;
+  return NULL;
+}
+
+static lluv_timer_wheel_t* lluv_check_timer_wheel(lua_State *L, int idx, lluv_flags_t flags){
+  lluv_handle_t *handle = lluv_check_handle(L, idx, flags);
+  lluv_timer_wheel_t *w = (LLUV_H(handle, uv_handle_t)->type == UV_TIMER) ? lluv_timer_wheel(handle) : NULL;
+  luaL_argcheck (L, w != NULL, idx, LLUV_TIMER_WHEEL_NAME" expected");
+  return w;
+}
+
+static void lluv_wheel_link(lluv_timer_wheel_t *w, uint32_t head, uint32_t id){
+  lluv_wheel_entry_t *e = w->e;
+  e[id].next = head;
+  e[id].prev = e[head].prev;
+  e[e[head].prev].next = id;
+  e[head].prev = id;
+}
+
+static void lluv_wheel_unlink(lluv_timer_wheel_t *w, uint32_t id){
+  lluv_wheel_entry_t *e = w->e;
+  e[e[id].prev].next = e[id].next;
+  e[e[id].next].prev = e[id].prev;
+}
+
+static void lluv_wheel_internal_add(lluv_timer_wheel_t *w, uint32_t id){
+  uint32_t expire  = w->e[id].expire;
+  uint32_t jiffies = (uint32_t)w->jiffies;
+  uint32_t idx     = expire - jiffies;
+  uint32_t head;
+
+  if((int32_t)idx < 0)
+    head = jiffies & LLUV_WHEEL_ROOT_MASK;
+  else if(idx < (1u << LLUV_WHEEL_ROOT_BITS))
+    head = expire & LLUV_WHEEL_ROOT_MASK;
+  else if(idx < (1u << (LLUV_WHEEL_ROOT_BITS + 1 * LLUV_WHEEL_LVL_BITS)))
+    head = LLUV_WHEEL_LVL_HEAD(1, LLUV_WHEEL_LVL_INDEX(expire, 1));
+  else if(idx < (1u << (LLUV_WHEEL_ROOT_BITS + 2 * LLUV_WHEEL_LVL_BITS)))
+    head = LLUV_WHEEL_LVL_HEAD(2, LLUV_WHEEL_LVL_INDEX(expire, 2));
+  else if(idx < (1u << (LLUV_WHEEL_ROOT_BITS + 3 * LLUV_WHEEL_LVL_BITS)))
+    head = LLUV_WHEEL_LVL_HEAD(3, LLUV_WHEEL_LVL_INDEX(expire, 3));
+  else
+    head = LLUV_WHEEL_LVL_HEAD(4, LLUV_WHEEL_LVL_INDEX(expire, 4));
+
+  lluv_wheel_link(w, head, id);
+}
+
+static uint32_t lluv_wheel_cascade(lluv_timer_wheel_t *w, int level){
+  uint32_t index = LLUV_WHEEL_LVL_INDEX((uint32_t)w->jiffies, level);
+  uint32_t head  = LLUV_WHEEL_LVL_HEAD(level, index);
+
+  /* entries always move to lower level */
+  while(w->e[head].next != head){
+    uint32_t id = w->e[head].next;
+    lluv_wheel_unlink(w, id);
+    lluv_wheel_internal_add(w, id);
+  }
+
+  return index;
+}
+
+static int lluv_wheel_grow(lluv_timer_wheel_t *w){
+  uint32_t i, cap = w->cap * 2;
+  lluv_wheel_entry_t *e;
+
+  if(cap < w->cap) return UV_ENOMEM;
+
+  e = (lluv_wheel_entry_t*)lluv_alloc(NULL, cap * sizeof(lluv_wheel_entry_t));
+  if(!e) return UV_ENOMEM;
+
+  memcpy(e, w->e, w->size * sizeof(lluv_wheel_entry_t));
+  lluv_free(NULL, w->e);
+
+  for(i = w->size; i < cap; ++i){
+    e[i].used = 0;
+    e[i].gen  = 0;
+  }
+
+  w->e   = e;
+  w->cap = cap;
+  return 0;
+}
+
+static int lluv_wheel_entry_alloc(lluv_timer_wheel_t *w, uint32_t *id){
+  if(w->free){
+    *id = w->free;
+    w->free = w->e[*id].next;
+    return 0;
+  }
+
+  if(w->size == w->cap){
+    int err = lluv_wheel_grow(w);
+    if(err < 0) return err;
+  }
+
+  *id = w->size++;
+  return 0;
+}
+
+static void lluv_wheel_entry_free(lua_State *L, lluv_timer_wheel_t *w, uint32_t id){
+  lluv_wheel_entry_t *e = &w->e[id];
+
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, w->cbs);
+  lua_pushnil(L); lua_rawseti(L, -2, id);
+  lua_pop(L, 1);
+
+  if(e->nargs){
+    lua_rawgeti(L, LLUV_LUA_REGISTRY, w->args);
+    lua_pushnil(L); lua_rawseti(L, -2, id);
+    lua_pop(L, 1);
+  }
+
+  e->used  = 0;
+  e->gen  += 1;
+  e->next  = w->free;
+  w->free  = id;
+  w->count -= 1;
+}
+
+static uint64_t lluv_wheel_now_tick(lluv_timer_wheel_t *w){
+  uint64_t now = uv_now(LLUV_H(w->handle, uv_handle_t)->loop);
+  return (now - w->base) / w->res;
+}
+
+static void lluv_on_timer_wheel(uv_timer_t *arg);
+
+/* start uv timer for the nearest tick which has something to do */
+static void lluv_wheel_schedule(lua_State *L, lluv_timer_wheel_t *w){
+  lluv_handle_t *handle = w->handle;
+  uint64_t target, now, at;
+  int err;
+
+  if(w->count == 0){
+    uv_timer_stop(LLUV_H(handle, uv_timer_t));
+    lluv_handle_unlock(L, handle, LLUV_LOCK_START);
+    return;
+  }
+
+  target = w->jiffies;
+  if(target & LLUV_WHEEL_ROOT_MASK){
+    /* nearest not empty root slot or next cascade */
+    do{
+      uint32_t head = (uint32_t)target & LLUV_WHEEL_ROOT_MASK;
+      if(w->e[head].next != head) break;
+    }while(++target & LLUV_WHEEL_ROOT_MASK);
+  }
+
+  now = uv_now(LLUV_H(handle, uv_handle_t)->loop);
+  at  = w->base + target * w->res;
+
+  err = uv_timer_start(LLUV_H(handle, uv_timer_t), lluv_on_timer_wheel, (at > now) ? (at - now) : 0, 0);
+  if(err >= 0){
+    w->wake = target;
+    lluv_handle_lock(L, handle, LLUV_LOCK_START);
+  }
+}
+
+static void lluv_wheel_fire(lua_State *L, lluv_timer_wheel_t *w, uint32_t id){
+  lluv_wheel_entry_t *e = &w->e[id];
+  int nargs = 0;
+
+  lluv_wheel_unlink(w, id);
+
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, w->cbs);
+  lua_rawgeti(L, -1, id);
+  lua_remove(L, -2);
+
+  if(e->nargs){
+    lua_rawgeti(L, LLUV_LUA_REGISTRY, w->args);
+    lua_rawgeti(L, -1, id);
+    lua_remove(L, -2);
+
+    if(e->nargs == LLUV_WHEEL_NARGS_PACKED){
+      int i, n;
+      lua_rawgeti(L, -1, 0);
+      n = (int)lua_tointeger(L, -1);
+      lua_pop(L, 1);
+      luaL_checkstack(L, n, "too many arguments");
+      for(i = 1; i <= n; ++i) lua_rawgeti(L, -i, i);
+      lua_remove(L, -n - 1);
+      nargs = n;
+    }
+    else nargs = 1;
+  }
+
+  lluv_wheel_entry_free(L, w, id);
+
+  LLUV_HANDLE_CALL_CB(L, w->handle, nargs);
+}
+
+static void lluv_wheel_run(lua_State *L, lluv_timer_wheel_t *w, uint64_t now_tick){
+  lluv_handle_t *handle = w->handle;
+
+  if(w->count == 0){
+    w->jiffies = now_tick + 1;
+    return;
+  }
+
+  while(w->jiffies <= now_tick){
+    uint32_t index = (uint32_t)w->jiffies & LLUV_WHEEL_ROOT_MASK;
+    uint32_t work  = LLUV_WHEEL_WORK;
+    lluv_wheel_entry_t *e;
+
+    if(!index){
+      int level;
+      for(level = 1; level <= LLUV_WHEEL_LEVELS; ++level){
+        if(lluv_wheel_cascade(w, level)) break;
+      }
+    }
+
+    w->jiffies += 1;
+
+    /* detach root list so callbacks can not add to it */
+    e = w->e;
+    if(e[index].next != index){
+      e[work].next = e[index].next;
+      e[work].prev = e[index].prev;
+      e[e[work].next].prev = work;
+      e[e[work].prev].next = work;
+      e[index].next = e[index].prev = index;
+    }
+
+    while(w->e[work].next != work){
+      lluv_wheel_fire(L, w, w->e[work].next);
+      if(!IS_(handle, OPEN)) return;
+    }
+
+    if(w->count == 0){
+      w->jiffies = now_tick + 1;
+      return;
+    }
+  }
+}
+
+static void lluv_on_timer_wheel(uv_timer_t *arg){
+  lluv_handle_t      *handle = lluv_handle_byptr((uv_handle_t*)arg);
+  lluv_timer_wheel_t *w      = lluv_timer_wheel(handle);
+  lua_State          *L      = LLUV_HCALLBACK_L(handle);
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  if(!IS_(handle, OPEN)) return;
+
+  w->running = 1;
+  lluv_wheel_run(L, w, lluv_wheel_now_tick(w));
+
+  if(IS_(handle, OPEN)){
+    w->running = 0;
+    lluv_wheel_schedule(L, w);
+  }
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+LLUV_IMPL_SAFE(lluv_timer_wheel_create){
+  lluv_loop_t   *loop = lluv_opt_loop(L, 1, LLUV_FLAG_OPEN);
+  int64_t        res  = lutil_optint64(L, loop ? 2 : 1, 10);
+  lluv_handle_t *handle;
+  lluv_timer_wheel_t *w;
+  uint32_t i;
+  int err;
+
+  if(!loop) loop = lluv_default_loop(L);
+
+  luaL_argcheck(L, (res > 0) && (res <= 0xFFFFFFFF), loop ? 2 : 1, "resolution should be positive");
+
+  w = lluv_alloc_t(L, lluv_timer_wheel_t);
+  if(!w) return lluv_fail(L, safe_flag | loop->flags, LLUV_ERR_UV, UV_ENOMEM, NULL);
+
+  w->cap = 2 * LLUV_WHEEL_HEADS;
+  w->e   = (lluv_wheel_entry_t*)lluv_alloc(L, w->cap * sizeof(lluv_wheel_entry_t));
+  if(!w->e){
+    lluv_free_t(L, lluv_timer_wheel_t, w);
+    return lluv_fail(L, safe_flag | loop->flags, LLUV_ERR_UV, UV_ENOMEM, NULL);
+  }
+
+  handle = lluv_handle_create(L, UV_TIMER, safe_flag | INHERITE_FLAGS(loop));
+  err = uv_timer_init(loop->handle, LLUV_H(handle, uv_timer_t));
+  if(err < 0){
+    lluv_free(L, w->e);
+    lluv_free_t(L, lluv_timer_wheel_t, w);
+    lluv_handle_cleanup(L, handle, -1);
+    return lluv_fail(L, safe_flag | loop->flags, LLUV_ERR_UV, (uv_errno_t)err, NULL);
+  }
+
+  for(i = 0; i < w->cap; ++i){
+    w->e[i].next = w->e[i].prev = i;
+    w->e[i].used = 0;
+    w->e[i].gen  = 0;
+  }
+
+  lluv_handle_setmeta(L, -1, LLUV_TIMER_WHEEL);
+
+  w->type    = LLUV_TIMER_EXT_WHEEL;
+  w->handle  = handle;
+  w->res     = (uint32_t)res;
+  w->base    = uv_now(loop->handle);
+  w->jiffies = w->wake = 0;
+  w->size    = LLUV_WHEEL_HEADS;
+  w->free    = 0;
+  w->count   = 0;
+  w->running = 0;
+
+  lua_newtable(L); w->cbs  = luaL_ref(L, LLUV_LUA_REGISTRY);
+  lua_newtable(L); w->args = luaL_ref(L, LLUV_LUA_REGISTRY);
+
+  handle->ext = w;
+
+  return 1;
+}
+
+LLUV_INTERNAL void lluv_timer_ext_free(lua_State *L, lluv_handle_t *handle){
+  lluv_timer_wheel_t *w = lluv_timer_wheel(handle);
+
+  if(!w){
+    lluv_timer_slack_free(L, handle);
+    return;
+  }
+
+  luaL_unref(L, LLUV_LUA_REGISTRY, w->cbs);
+  luaL_unref(L, LLUV_LUA_REGISTRY, w->args);
+  lluv_free(L, w->e);
+  lluv_free_t(L, lluv_timer_wheel_t, w);
+
+  handle->ext = NULL;
+}
+
+static int lluv_timer_wheel_add(lua_State *L){
+  lluv_timer_wheel_t *w = lluv_check_timer_wheel(L, 1, LLUV_FLAG_OPEN);
+  int64_t  timeout = lutil_checkint64(L, 2);
+  int      nargs   = lua_gettop(L) - 3;
+  uint64_t ticks, now;
+  uint32_t id;
+  int err;
+
+  lluv_check_callable(L, 3);
+
+  if(timeout < 0) timeout = 0;
+
+  err = lluv_wheel_entry_alloc(w, &id);
+  if(err < 0){
+    return lluv_fail(L, w->handle->flags, LLUV_ERR_UV, err, NULL);
+  }
+
+  if(nargs > 1){
+    int i;
+    lua_createtable(L, nargs, 1);
+    lua_pushinteger(L, nargs); lua_rawseti(L, -2, 0);
+    for(i = nargs; i > 0; --i){
+      lua_insert(L, -2);
+      lua_rawseti(L, -2, i);
+    }
+  }
+
+  if(nargs > 0){
+    lua_rawgeti(L, LLUV_LUA_REGISTRY, w->args);
+    lua_insert(L, -2);
+    lua_rawseti(L, -2, id);
+    lua_pop(L, 1);
+  }
+
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, w->cbs);
+  lua_pushvalue(L, 3);
+  lua_rawseti(L, -2, id);
+  lua_pop(L, 1);
+
+  /* never fire before timeout */
+  now   = uv_now(LLUV_H(w->handle, uv_handle_t)->loop) - w->base;
+  ticks = (now + (uint64_t)timeout + w->res - 1) / w->res;
+  if(ticks - now / w->res > LLUV_WHEEL_MAX_TICKS) ticks = now / w->res + LLUV_WHEEL_MAX_TICKS;
+
+  w->e[id].used   = 1;
+  w->e[id].nargs  = (nargs > 1) ? LLUV_WHEEL_NARGS_PACKED : (uint8_t)nargs;
+  w->e[id].expire = (uint32_t)ticks;
+  w->count += 1;
+
+  if(w->count == 1 && !w->running){
+    /* wheel was idle */
+    w->jiffies = now / w->res;
+  }
+
+  lluv_wheel_internal_add(w, id);
+
+  if(!w->running){
+    if((w->count == 1) || (ticks < w->wake) || !uv_is_active(LLUV_H(w->handle, uv_handle_t))){
+      lluv_wheel_schedule(L, w);
+    }
+  }
+
+  lutil_pushint64(L, ((int64_t)w->e[id].gen << 32) | id);
+  return 1;
+}
+
+static int lluv_timer_wheel_cancel(lua_State *L){
+  lluv_timer_wheel_t *w = lluv_check_timer_wheel(L, 1, LLUV_FLAG_OPEN);
+  int64_t token = lutil_checkint64(L, 2);
+  uint32_t id   = (uint32_t)(token & 0xFFFFFFFF);
+  uint16_t gen  = (uint16_t)(token >> 32);
+
+  if((id < LLUV_WHEEL_HEADS) || (id >= w->size) || !w->e[id].used || (w->e[id].gen != gen)){
+    lua_pushboolean(L, 0);
+    return 1;
+  }
+
+  lluv_wheel_unlink(w, id);
+  lluv_wheel_entry_free(L, w, id);
+
+  if(w->count == 0 && !w->running){
+    lluv_wheel_schedule(L, w);
+  }
+
+  lua_pushboolean(L, 1);
+  return 1;
+}
+
+static int lluv_timer_wheel_count(lua_State *L){
+  lluv_timer_wheel_t *w = lluv_check_timer_wheel(L, 1, LLUV_FLAG_OPEN);
+  lutil_pushint64(L, w->count);
+  return 1;
+}
+
+static int lluv_timer_wheel_resolution(lua_State *L){
+  lluv_timer_wheel_t *w = lluv_check_timer_wheel(L, 1, LLUV_FLAG_OPEN);
+  lutil_pushint64(L, w->res);
+  return 1;
+}
+
+static const struct luaL_Reg lluv_timer_wheel_methods[] = {
+  { "add",        lluv_timer_wheel_add        },
+  { "cancel",     lluv_timer_wheel_cancel     },
+  { "count",      lluv_timer_wheel_count      },
+  { "resolution", lluv_timer_wheel_resolution },
+
+  {NULL,NULL}
+};
+
+//}
+
 static const struct luaL_Reg lluv_timer_methods[] = {
   { "start",      lluv_timer_start      },
   { "stop",       lluv_timer_stop       },
@@ -133,10 +876,11 @@ static const struct luaL_Reg lluv_timer_methods[] = {
   {NULL,NULL}
 };
 
-#define LLUV_FUNCTIONS(F)           \
-  {"timer", lluv_timer_create_##F}, \
+#define LLUV_FUNCTIONS(F)                       \
+  {"timer",       lluv_timer_create_##F},       \
+  {"timer_wheel", lluv_timer_wheel_create_##F}, \
 
-static const struct luaL_Reg lluv_functions[][2] = {
+static const struct luaL_Reg lluv_functions[][3] = {
   {
     LLUV_FUNCTIONS(unsafe)
 
@@ -155,6 +899,13 @@ LLUV_INTERNAL void lluv_timer_initlib(lua_State *L, int nup, int safe){
   if(!lutil_createmetap(L, LLUV_TIMER, lluv_timer_methods, nup))
     lua_pop(L, nup);
   lua_pop(L, 1);
+  lluv_handle_createmeta(L, nup, UV_TIMER, LLUV_TIMER, NULL);
+
+  lutil_pushnvalues(L, nup);
+  if(!lutil_createmetap(L, LLUV_TIMER_WHEEL, lluv_timer_wheel_methods, nup))
+    lua_pop(L, nup);
+  lua_pop(L, 1);
+  lluv_handle_createmeta(L, nup, UV_UNKNOWN_HANDLE, LLUV_TIMER_WHEEL, NULL);
 
   luaL_setfuncs(L, lluv_functions[safe], nup);
 }
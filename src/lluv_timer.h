@@ -13,6 +13,6 @@
 
 LLUV_INTERNAL void lluv_timer_initlib(lua_State *L, int nup, int safe);
 
-LLUV_INTERNAL int lluv_timer_index(lua_State *L);
+LLUV_INTERNAL void lluv_timer_ext_free(lua_State *L, lluv_handle_t *handle);
 
 #endif
@@ -19,10 +19,6 @@
 #define LLUV_TTY_NAME LLUV_PREFIX" tty"
 static const char *LLUV_TTY = LLUV_TTY_NAME;
 
-LLUV_INTERNAL int lluv_tty_index(lua_State *L){
-  return lluv__index(L, LLUV_TTY, lluv_stream_index);
-}
-
 LLUV_IMPL_SAFE(lluv_tty_create){
   lluv_loop_t *loop = lluv_opt_loop(L, 1, LLUV_FLAG_OPEN);
   uv_file fd        = (uv_file)lutil_checkint64(L, loop ? 2 : 1);
@@ -114,6 +110,7 @@ LLUV_INTERNAL void lluv_tty_initlib(lua_State *L, int nup, int safe){
   if(!lutil_createmetap(L, LLUV_TTY, lluv_tty_methods, nup))
     lua_pop(L, nup);
   lua_pop(L, 1);
+  lluv_stream_createmeta(L, nup, UV_TTY, LLUV_TTY);
 
   luaL_setfuncs(L, lluv_functions[safe], nup);
 }
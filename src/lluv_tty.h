@@ -13,6 +13,4 @@
 
 LLUV_INTERNAL void lluv_tty_initlib(lua_State *L, int nup, int safe);
 
-LLUV_INTERNAL int lluv_tty_index(lua_State *L);
-
 #endif
@@ -8,6 +8,10 @@
 * This file is part of lua-lluv library.
 ******************************************************************************/
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE /* sendmmsg */
+#endif
+
 #include "lluv.h"
 #include "lluv_handle.h"
 #include "lluv_udp.h"
@@ -15,14 +19,31 @@
 #include "lluv_error.h"
 #include "lluv_req.h"
 #include "lluv_stream.h"
+#include "lluv_sockaddr.h"
 #include <assert.h>
+#include <string.h>
+
+#if defined(__linux__)
+#  include <errno.h>
+#  include <sys/socket.h>
+#  include <netinet/in.h>
+#  include <netinet/udp.h>
+#  define LLUV_UDP_SENDMMSG
+#  define LLUV_UDP_MMSG_SEND_CHUNK 64 /* datagrams per sendmmsg call */
+#  if defined(UDP_SEGMENT)
+#    define LLUV_UDP_GSO
+#  endif
+#  if defined(UDP_GRO)
+#    define LLUV_UDP_GRO
+#  endif
+#endif
 
 #define LLUV_UDP_NAME LLUV_PREFIX" udp"
 static const char *LLUV_UDP = LLUV_UDP_NAME;
 
-LLUV_INTERNAL int lluv_udp_index(lua_State *L){
-  return lluv__index(L, LLUV_UDP, lluv_handle_index);
-}
+#if LLUV_UV_VER_GE(1,37,0)
+static void lluv_udp_ext_set_mmsg(lua_State *L, lluv_handle_t *handle);
+#endif
 
 LLUV_IMPL_SAFE(lluv_udp_create){
   lluv_loop_t   *loop   = lluv_opt_loop(L, 1, LLUV_FLAG_OPEN);
@@ -30,7 +51,18 @@ LLUV_IMPL_SAFE(lluv_udp_create){
   int err;
 
 #if LLUV_UV_VER_GE(1,7,0)
-  unsigned int flags = lluv_opt_af_flags(L, loop ? 2 : 1, AF_UNSPEC);
+  static const lluv_uv_const_t FLAGS[] = {
+    { AF_UNSPEC,          "unspec"     },
+    { AF_INET,            "inet"       },
+    { AF_INET6,           "inet6"      },
+#if LLUV_UV_VER_GE(1,37,0)
+    { UV_UDP_RECVMMSG,    "recvmmsg"   },
+#endif
+
+    { 0, NULL }
+  };
+
+  unsigned int flags = lluv_opt_flags_ui_2(L, loop ? 2 : 1, AF_UNSPEC, FLAGS);
 #endif
 
   if(!loop) loop = lluv_default_loop(L);
@@ -47,6 +79,12 @@ LLUV_IMPL_SAFE(lluv_udp_create){
     lluv_handle_cleanup(L, handle, -1);
     return lluv_fail(L, safe_flag | loop->flags, LLUV_ERR_UV, (uv_errno_t)err, NULL);
   }
+
+#if LLUV_UV_VER_GE(1,37,0)
+  /* uv_udp_using_recvmmsg available only since libuv 1.39 */
+  if(flags & UV_UDP_RECVMMSG) lluv_udp_ext_set_mmsg(L, handle);
+#endif
+
   return 1;
 }
 
@@ -57,6 +95,209 @@ static lluv_handle_t* lluv_check_udp(lua_State *L, int idx, lluv_flags_t flags){
   return handle;
 }
 
+//{ UDP extension
+
+#define LLUV_UDP_DGRAM_SIZE  (64 * 1024) /* libuv reads each datagram to chunk of this size */
+#define LLUV_UDP_MMSG_CHUNKS 20          /* max datagrams per recvmmsg call in libuv */
+
+typedef struct lluv_udp_dgram_tag{
+  size_t                  off;
+  size_t                  len;
+  struct sockaddr_storage addr;
+}lluv_udp_dgram_t;
+
+/* Per udp state used only by optional features.
+ * Allocated on first use and released with handle.
+ */
+typedef struct lluv_udp_ext_tag{
+  lluv_handle_t    *handle;
+
+  unsigned char     mmsg;        /* handle created with recvmmsg flag */
+  char             *slab;        /* receive buffer for recvmmsg */
+  unsigned char     addr_mode;   /* how peer address passed to receive callback */
+  unsigned char     gro;         /* receive coalesced datagrams */
+  char             *gbuf;        /* receive buffer for gro mode */
+  int               addr_cache;  /* interned sockaddr objects */
+  size_t            addr_cache_n;
+
+  size_t            batch;       /* max datagrams per batched callback */
+  char             *bdata;       /* payloads of batched datagrams */
+  size_t            blen;
+  size_t            bcap;
+  lluv_udp_dgram_t *bdgrams;
+  size_t            bdgrams_n;
+  size_t            bdgrams_cap;
+  lluv_loop_task_t  batch_task;
+
+  uv_buf_t         *sbufs;       /* send_batch scratch buffers */
+  struct sockaddr_storage *saddrs;
+  size_t            scap;
+}lluv_udp_ext_t;
+
+#define LLUV_UDP_EXT(H) ((lluv_udp_ext_t*)(H)->ext)
+
+#define LLUV_UDP_ADDR_STRING   0 /* host, port */
+#define LLUV_UDP_ADDR_SOCKADDR 1 /* sockaddr object */
+#define LLUV_UDP_ADDR_INTERNED 2 /* same sockaddr object for same peer */
+#define LLUV_UDP_ADDR_BINARY   3 /* ipv4 as number or ipv6 as 16 bytes string, port */
+
+#define LLUV_UDP_ADDR_IS_OBJECT(mode) (((mode) == LLUV_UDP_ADDR_SOCKADDR) || ((mode) == LLUV_UDP_ADDR_INTERNED))
+
+#define LLUV_UDP_ADDR_CACHE_MAX 4096 /* cache dropped when it grows over this */
+
+static void lluv_udp_on_batch_task(lua_State *L, lluv_loop_task_t *task);
+
+static lluv_udp_ext_t *lluv_udp_ext(lua_State *L, lluv_handle_t *handle){
+  lluv_udp_ext_t *ext = LLUV_UDP_EXT(handle);
+  if(ext) return ext;
+
+  ext = lluv_alloc_t(L, lluv_udp_ext_t);
+  if(!ext) luaL_error(L, "out of memory");
+
+  memset(ext, 0, sizeof(lluv_udp_ext_t));
+  ext->handle     = handle;
+  ext->addr_cache = LUA_NOREF;
+  lluv_loop_task_init(&ext->batch_task, lluv_udp_on_batch_task);
+
+  handle->ext = ext;
+  return ext;
+}
+
+#if LLUV_UV_VER_GE(1,37,0)
+static void lluv_udp_ext_set_mmsg(lua_State *L, lluv_handle_t *handle){
+  lluv_udp_ext(L, handle)->mmsg = 1;
+}
+#endif
+
+LLUV_INTERNAL void lluv_udp_ext_free(lua_State *L, lluv_handle_t *handle){
+  lluv_udp_ext_t *ext = LLUV_UDP_EXT(handle);
+  if(!ext) return;
+
+  lluv_loop_task_cancel(&ext->batch_task);
+  luaL_unref(L, LLUV_LUA_REGISTRY, ext->addr_cache);
+
+  if(ext->slab)    lluv_free(L, ext->slab);
+  if(ext->gbuf)    lluv_free(L, ext->gbuf);
+  if(ext->bdata)   lluv_free(L, ext->bdata);
+  if(ext->bdgrams) lluv_free(L, ext->bdgrams);
+  if(ext->sbufs)   lluv_free(L, ext->sbufs);
+  if(ext->saddrs)  lluv_free(L, ext->saddrs);
+
+  lluv_free_t(L, lluv_udp_ext_t, ext);
+  handle->ext = NULL;
+}
+
+/* With recvmmsg libuv splits buffer to chunks and pass each datagram
+ * as slice of it so there used one slab per handle which never freed
+ * by receive callback.
+ */
+static void lluv_udp_alloc_cb(uv_handle_t* h, size_t suggested_size, uv_buf_t *buf){
+#if LLUV_UV_VER_GE(1,37,0)
+  lluv_handle_t *handle = lluv_handle_byptr(h);
+  lluv_udp_ext_t *ext = LLUV_UDP_EXT(handle);
+
+  if(ext && ext->mmsg){
+    if(!ext->slab){
+      ext->slab = (char*)lluv_alloc(NULL, LLUV_UDP_MMSG_CHUNKS * LLUV_UDP_DGRAM_SIZE);
+    }
+    if(ext->slab) *buf = lluv_buf_init(ext->slab, LLUV_UDP_MMSG_CHUNKS * LLUV_UDP_DGRAM_SIZE);
+    else *buf = lluv_buf_init(NULL, 0);
+    return;
+  }
+#endif
+
+  lluv_alloc_buffer_cb(h, suggested_size, buf);
+}
+
+static void lluv_udp_free_buffer(lluv_handle_t *handle, const uv_buf_t *buf){
+  lluv_udp_ext_t *ext = LLUV_UDP_EXT(handle);
+
+  if(ext && ext->slab && (buf->base >= ext->slab) &&
+    (buf->base < ext->slab + LLUV_UDP_MMSG_CHUNKS * LLUV_UDP_DGRAM_SIZE)
+  ) return;
+
+  lluv_free_buffer(&handle->handle, buf);
+}
+
+/* Peers set is usually small so keep one sockaddr object per peer.
+ * IPv4 peers keyed by number so there no string created.
+ */
+static void lluv_udp_push_interned(lua_State *L, lluv_udp_ext_t *ext, const struct sockaddr *addr){
+  int top = lua_gettop(L);
+
+  if(ext->addr_cache == LUA_NOREF || ext->addr_cache_n >= LLUV_UDP_ADDR_CACHE_MAX){
+    luaL_unref(L, LLUV_LUA_REGISTRY, ext->addr_cache);
+    lua_newtable(L);
+    ext->addr_cache   = luaL_ref(L, LLUV_LUA_REGISTRY);
+    ext->addr_cache_n = 0;
+  }
+
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, ext->addr_cache);
+
+  if(addr->sa_family == AF_INET6){
+    const struct sockaddr_in6 *sa = (const struct sockaddr_in6*)addr;
+    char key[sizeof(sa->sin6_addr) + sizeof(sa->sin6_port) + sizeof(sa->sin6_scope_id)];
+    memcpy(key, &sa->sin6_addr, sizeof(sa->sin6_addr));
+    memcpy(key + sizeof(sa->sin6_addr), &sa->sin6_port, sizeof(sa->sin6_port));
+    memcpy(key + sizeof(sa->sin6_addr) + sizeof(sa->sin6_port), &sa->sin6_scope_id, sizeof(sa->sin6_scope_id));
+    lua_pushlstring(L, key, sizeof(key));
+  }
+  else{
+    const struct sockaddr_in *sa = (const struct sockaddr_in*)addr;
+    lutil_pushint64(L, ((int64_t)ntohl(sa->sin_addr.s_addr) << 16) | ntohs(sa->sin_port));
+  }
+
+  lua_pushvalue(L, -1);
+  lua_rawget(L, -3);
+  if(lua_isnil(L, -1)){
+    lua_pop(L, 1);
+    lluv_sockaddr_push(L, addr);
+    lua_pushvalue(L, -1);
+    lua_insert(L, -3);
+    lua_rawset(L, -4);
+    ext->addr_cache_n += 1;
+  }
+
+  lua_replace(L, top + 1);
+  lua_settop(L, top + 1);
+}
+
+static int lluv_udp_push_binary(lua_State *L, const struct sockaddr *addr){
+  if(addr->sa_family == AF_INET6){
+    const struct sockaddr_in6 *sa = (const struct sockaddr_in6*)addr;
+    lua_pushlstring(L, (const char*)&sa->sin6_addr, sizeof(sa->sin6_addr));
+    lua_pushinteger(L, ntohs(sa->sin6_port));
+  }
+  else{
+    const struct sockaddr_in *sa = (const struct sockaddr_in*)addr;
+    lutil_pushint64(L, ntohl(sa->sin_addr.s_addr));
+    lua_pushinteger(L, ntohs(sa->sin_port));
+  }
+  return 2;
+}
+
+/* push peer address according handle address mode */
+static int lluv_udp_push_addr(lua_State *L, lluv_udp_ext_t *ext, const struct sockaddr *addr){
+  if(!addr) return 0;
+
+  if(ext) switch(ext->addr_mode){
+    case LLUV_UDP_ADDR_SOCKADDR:
+      lluv_sockaddr_push(L, addr);
+      return 1;
+
+    case LLUV_UDP_ADDR_INTERNED:
+      lluv_udp_push_interned(L, ext, addr);
+      return 1;
+
+    case LLUV_UDP_ADDR_BINARY:
+      return lluv_udp_push_binary(L, addr);
+  }
+
+  return lluv_push_addr(L, (const struct sockaddr_storage*)addr);
+}
+
+//}
+
 static int lluv_udp_open(lua_State *L){
   lluv_handle_t  *handle = lluv_check_udp(L, 1, LLUV_FLAG_OPEN);
   uv_os_sock_t sock = lluv_check_os_sock(L, 2);
@@ -90,7 +331,7 @@ static int lluv_udp_bind(lua_State *L){
   if(err < 0){
     lua_checkstack(L, 3);
 
-    lua_pushvalue(L, 2); lua_pushliteral(L, ":"); lua_pushvalue(L, 3); lua_concat(L, 3);
+    lluv_push_host_port(L, 2);
 
     if(!lua_isfunction(L, top)){
       return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, lua_tostring(L, -1));
@@ -109,7 +350,7 @@ static int lluv_udp_bind(lua_State *L){
   if(err < 0){
     lua_checkstack(L, 3);
 
-    lua_pushvalue(L, 2); lua_pushliteral(L, ":"); lua_pushvalue(L, 3); lua_concat(L, 3);
+    lluv_push_host_port(L, 2);
 
     if(!lua_isfunction(L, top)){
       return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, lua_tostring(L, -1));
@@ -153,7 +394,7 @@ static int lluv_udp_connect(lua_State *L){
 
     lua_checkstack(L, 3);
 
-    lua_pushvalue(L, 2); lua_pushliteral(L, ":"); lua_pushvalue(L, 3); lua_concat(L, 3);
+    lluv_push_host_port(L, 2);
 
     if (!lua_isfunction(L, top)) {
       return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, lua_tostring(L, -1));
@@ -174,7 +415,7 @@ static int lluv_udp_connect(lua_State *L){
     const char *ip = 0;
     if (psa) {
       lua_checkstack(L, 3);
-      lua_pushvalue(L, 2); lua_pushliteral(L, ":"); lua_pushvalue(L, 3); lua_concat(L, 3);
+      lluv_push_host_port(L, 2);
       ip = lua_tostring(L, -1);
     }
 
@@ -363,7 +604,7 @@ static int lluv_udp_send(lua_State *L){
     if(lua_isfunction(L, top)){
       lua_pushvalue(L, 1); /*self*/
       /*host:port*/
-      lua_pushvalue(L, 2); lua_pushliteral(L, ":"); lua_pushvalue(L, 3); lua_concat(L, 3);
+      lluv_push_host_port(L, 2);
       lluv_error_create(L, LLUV_ERR_UV, err, lua_tostring(L, -1));
       lua_remove(L, -2);
       lluv_loop_defer_call(L, lluv_loop_by_handle(&handle->handle), 2);
@@ -386,6 +627,404 @@ static int lluv_udp_send(lua_State *L){
   }
 }
 
+/* Batched send.
+ * Datagrams sent directly with sendmmsg (or uv_udp_try_send) while socket
+ * accepts them. Rest queued as regular send requests which share one
+ * state so callback called once for whole batch with first error.
+ */
+
+typedef struct lluv_udp_send_batch_tag{
+  lluv_handle_t  *handle;
+  int             cb;
+  int             ctx;
+  int             list;
+  int             status;
+  size_t          pending;
+  uv_udp_send_t   reqs[1];
+}lluv_udp_send_batch_t;
+
+static int lluv_udp_scratch_reserve(lua_State *L, lluv_udp_ext_t *ext, size_t n){
+  uv_buf_t *bufs; struct sockaddr_storage *addrs;
+
+  if(n <= ext->scap) return 0;
+
+  bufs  = (uv_buf_t*)lluv_alloc(L, n * sizeof(uv_buf_t));
+  addrs = (struct sockaddr_storage*)lluv_alloc(L, n * sizeof(struct sockaddr_storage));
+  if(!bufs || !addrs){
+    if(bufs)  lluv_free(L, bufs);
+    if(addrs) lluv_free(L, addrs);
+    return UV_ENOMEM;
+  }
+
+  if(ext->sbufs)  lluv_free(L, ext->sbufs);
+  if(ext->saddrs) lluv_free(L, ext->saddrs);
+
+  ext->sbufs  = bufs;
+  ext->saddrs = addrs;
+  ext->scap   = n;
+
+  return 0;
+}
+
+#define LLUV_UDP_SADDR(ext, i) (ext->saddrs[i].ss_family == AF_UNSPEC ? NULL : (struct sockaddr*)&ext->saddrs[i])
+
+/* sends datagrams directly to socket.
+ * returns number of processed datagrams. Sets first error to `status`
+ */
+static size_t lluv_udp_send_direct(lluv_handle_t *handle, lluv_udp_ext_t *ext, size_t n, int *status){
+  size_t i = 0;
+
+  while(i < n){
+    int err;
+#ifdef LLUV_UDP_SENDMMSG
+    uv_os_fd_t fd;
+
+    /* libuv creates socket on first send so let it do this */
+    if(uv_fileno(LLUV_H(handle, uv_handle_t), &fd) >= 0){
+      struct mmsghdr msgs[LLUV_UDP_MMSG_SEND_CHUNK];
+      size_t j, m = n - i;
+      if(m > LLUV_UDP_MMSG_SEND_CHUNK) m = LLUV_UDP_MMSG_SEND_CHUNK;
+
+      memset(msgs, 0, sizeof(msgs[0]) * m);
+      for(j = 0; j < m; ++j){
+        struct sockaddr *sa = LLUV_UDP_SADDR(ext, i + j);
+        msgs[j].msg_hdr.msg_iov    = (struct iovec*)&ext->sbufs[i + j];
+        msgs[j].msg_hdr.msg_iovlen = 1;
+        if(sa){
+          msgs[j].msg_hdr.msg_name    = sa;
+          msgs[j].msg_hdr.msg_namelen = (sa->sa_family == AF_INET6) ?
+            sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+        }
+      }
+
+      do{ err = sendmmsg(fd, msgs, (unsigned int)m, 0); }
+      while((err < 0) && (errno == EINTR));
+
+      if(err > 0){
+        i += err;
+        continue;
+      }
+
+      err = (err < 0) ? -errno : UV_EAGAIN;
+    }
+    else
+#endif
+    err = uv_udp_try_send(LLUV_H(handle, uv_udp_t), &ext->sbufs[i], 1, LLUV_UDP_SADDR(ext, i));
+
+    if(err >= 0){ ++i; continue; }
+
+    if(err == UV_EAGAIN) break;
+
+    /* skip invalid datagram */
+    if(*status == 0) *status = err;
+    ++i;
+  }
+
+  return i;
+}
+
+static void lluv_udp_send_batch_free(lua_State *L, lluv_udp_send_batch_t *batch){
+  lluv_handle_t *handle = batch->handle;
+
+  luaL_unref(L, LLUV_LUA_REGISTRY, batch->cb);
+  luaL_unref(L, LLUV_LUA_REGISTRY, batch->ctx);
+  luaL_unref(L, LLUV_LUA_REGISTRY, batch->list);
+  lluv_free(L, batch);
+
+  lluv_handle_unlock(L, handle, LLUV_LOCK_REQ);
+}
+
+static void lluv_on_udp_send_batch_cb(uv_udp_send_t* arg, int status){
+  lluv_udp_send_batch_t *batch = (lluv_udp_send_batch_t*)arg->data;
+  lluv_handle_t *handle = batch->handle;
+  lua_State *L = LLUV_HCALLBACK_L(handle);
+
+  if((status < 0) && (batch->status == 0)) batch->status = status;
+  if(--batch->pending) return;
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  if(!IS_(handle, OPEN) || (batch->cb == LUA_NOREF)){
+    lluv_udp_send_batch_free(L, batch);
+
+    LLUV_CHECK_LOOP_CB_INVARIANT(L);
+    return;
+  }
+
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, batch->cb);
+  lluv_handle_pushself(L, handle);
+  lluv_push_status_ex(L, handle->flags, batch->status);
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, batch->ctx);
+
+  lluv_udp_send_batch_free(L, batch);
+
+  LLUV_HANDLE_CALL_CB(L, handle, 3);
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+// send_batch(list)
+// send_batch(list, cb)
+// send_batch(list, cb, ctx)
+//   list item is `data` for connected socket or `{data, host, port}`
+static int lluv_udp_send_batch(lua_State *L){
+  lluv_handle_t *handle = lluv_check_udp(L, 1, LLUV_FLAG_OPEN);
+  lluv_udp_ext_t *ext = lluv_udp_ext(L, handle);
+  size_t i, sent, n;
+  int status = 0;
+
+  luaL_checktype(L, 2, LUA_TTABLE);
+  if(lua_gettop(L) == 4)
+    lluv_check_callable(L, 3);
+  else if(lua_gettop(L) == 2)
+    lua_settop(L, 4);
+  else{
+    lluv_check_args_with_cb(L, 3);
+    lua_settop(L, 4);
+  }
+
+  n = lua_rawlen(L, 2);
+  if(n == 0){
+    lua_settop(L, 1);
+    return 1;
+  }
+
+  if(lluv_udp_scratch_reserve(L, ext, n) < 0){
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, UV_ENOMEM, NULL);
+  }
+
+  for(i = 0; i < n; ++i){
+    size_t len; const char *str;
+
+    lua_rawgeti(L, 2, (int)i + 1);
+    if(lua_type(L, -1) == LUA_TTABLE){
+      int err;
+
+      lua_rawgeti(L, -1, 1);
+      lua_rawgeti(L, -2, 2);
+      lua_rawgeti(L, -3, 3);
+      str = lua_tolstring(L, -3, &len);
+      if(!str) return luaL_argerror(L, 2, "invalid item data");
+      if(!lluv_test_sockaddr(L, -2) && (!lua_isstring(L, -2) || !lua_isnumber(L, -1))){
+        return luaL_argerror(L, 2, "invalid item address");
+      }
+
+      err = lluv_check_addr(L, lua_gettop(L) - 1, &ext->saddrs[i]);
+      if(err < 0){
+        lua_pushliteral(L, ":"); lua_insert(L, -2); lua_concat(L, 3);
+        return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, lua_tostring(L, -1));
+      }
+    }
+    else{
+      str = lua_tolstring(L, -1, &len);
+      if(!str) return luaL_argerror(L, 2, "invalid item data");
+      ext->saddrs[i].ss_family = AF_UNSPEC;
+    }
+
+    /* strings stay referenced by list */
+    ext->sbufs[i] = lluv_buf_init((char*)str, len);
+    lua_settop(L, 4);
+  }
+
+  /* queued requests have to be sent first */
+  sent = (handle->lock_counter == 0) ? lluv_udp_send_direct(handle, ext, n, &status) : 0;
+
+  if(sent == n){
+    if(!lua_isnil(L, 3)){
+      lua_pushvalue(L, 3);
+      lua_pushvalue(L, 1);
+      lluv_push_status_ex(L, handle->flags, status);
+      lua_pushvalue(L, 4);
+      lluv_loop_defer_call(L, lluv_loop_by_handle(&handle->handle), 3);
+    }
+    lua_settop(L, 1);
+    return 1;
+  }
+
+  {
+    lluv_udp_send_batch_t *batch = (lluv_udp_send_batch_t*)lluv_alloc(L,
+      sizeof(lluv_udp_send_batch_t) + (n - sent - 1) * sizeof(uv_udp_send_t)
+    );
+    if(!batch){
+      return lluv_fail(L, handle->flags, LLUV_ERR_UV, UV_ENOMEM, NULL);
+    }
+
+    batch->handle  = handle;
+    batch->status  = status;
+    batch->pending = 1; /* guard against callbacks until all queued */
+    batch->ctx     = luaL_ref(L, LLUV_LUA_REGISTRY);
+    batch->cb      = lua_isnil(L, -1) ? (lua_pop(L, 1), LUA_NOREF) : luaL_ref(L, LLUV_LUA_REGISTRY);
+    batch->list    = luaL_ref(L, LLUV_LUA_REGISTRY);
+
+    lluv_handle_lock(L, handle, LLUV_LOCK_REQ);
+
+    for(i = sent; i < n; ++i){
+      uv_udp_send_t *req = &batch->reqs[i - sent];
+      int err;
+
+      req->data = batch;
+      err = uv_udp_send(req, LLUV_H(handle, uv_udp_t), &ext->sbufs[i], 1,
+        LLUV_UDP_SADDR(ext, i), lluv_on_udp_send_batch_cb
+      );
+
+      if(err < 0){
+        if(batch->status == 0) batch->status = err;
+      }
+      else ++batch->pending;
+    }
+
+    if(batch->pending == 1){
+      /* nothing queued */
+      if(batch->cb != LUA_NOREF){
+        lua_rawgeti(L, LLUV_LUA_REGISTRY, batch->cb);
+        lluv_handle_pushself(L, handle);
+        lluv_push_status_ex(L, handle->flags, batch->status);
+        lua_rawgeti(L, LLUV_LUA_REGISTRY, batch->ctx);
+        lluv_loop_defer_call(L, lluv_loop_by_handle(&handle->handle), 3);
+      }
+      lluv_udp_send_batch_free(L, batch);
+    }
+    else --batch->pending;
+  }
+
+  lua_settop(L, 1);
+  return 1;
+}
+
+//}
+
+//{ Segmentation offload
+
+/* Kernel splits buffer to datagrams of segment size so
+ * one system call carries many datagrams.
+ */
+
+static int lluv_udp_set_gso(lua_State *L){
+  lluv_handle_t *handle = lluv_check_udp(L, 1, LLUV_FLAG_OPEN);
+  lua_Integer size = luaL_checkinteger(L, 2);
+  int err;
+
+  luaL_argcheck(L, (size >= 0) && (size <= 0xFFFF), 2, "invalid segment size");
+
+#ifdef LLUV_UDP_GSO
+  {
+    uv_os_fd_t fd; int val = (int)size;
+    err = uv_fileno(LLUV_H(handle, uv_handle_t), &fd);
+    if((err >= 0) && setsockopt(fd, IPPROTO_UDP, UDP_SEGMENT, &val, sizeof(val))) err = -errno;
+  }
+#else
+  err = UV_ENOTSUP;
+#endif
+
+  if(err < 0){
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
+  }
+
+  lua_settop(L, 1);
+  return 1;
+}
+
+#ifdef LLUV_UDP_GSO
+
+/* bind to any address like libuv does before first send */
+static int lluv_udp_bind_any(lluv_handle_t *handle, int family){
+  struct sockaddr_storage sa;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.ss_family = (family == AF_INET6) ? AF_INET6 : AF_INET;
+
+  return uv_udp_bind(LLUV_H(handle, uv_udp_t), (struct sockaddr*)&sa, 0);
+}
+
+#endif
+
+// connected
+//   try_send_gso(data, segment_size)
+// disconnected
+//   try_send_gso(addr, port, data, segment_size)
+static int lluv_udp_try_send_gso(lua_State *L){
+  lluv_handle_t *handle = lluv_check_udp(L, 1, LLUV_FLAG_OPEN);
+  int is_connected = (lua_gettop(L) == 3) ? 1 : 0;
+  struct sockaddr_storage sa; int err = is_connected ? 0 : lluv_check_addr(L, 2, &sa);
+  struct sockaddr_storage *psa = is_connected ? 0 : &sa;
+  int data_index = is_connected ? 2 : 4;
+  size_t len; const char *str;
+  lua_Integer size;
+
+  if(err < 0){
+    lua_settop(L, 3);
+    lua_pushliteral(L, ":"); lua_insert(L, -2); lua_concat(L, 3);
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, lua_tostring(L, -1));
+  }
+
+  str  = luaL_checklstring(L, data_index, &len);
+  size = luaL_checkinteger(L, data_index + 1);
+  luaL_argcheck(L, (size >= 0) && (size <= 0xFFFF), data_index + 1, "invalid segment size");
+
+#ifdef LLUV_UDP_GSO
+  {
+    char control[CMSG_SPACE(sizeof(uint16_t))];
+    struct msghdr msg; struct iovec iov;
+    uv_os_fd_t fd; ssize_t r;
+
+    /* do not overtake queued send requests */
+    if(handle->lock_counter != 0){
+      return lluv_fail(L, handle->flags, LLUV_ERR_UV, UV_EAGAIN, NULL);
+    }
+
+    err = uv_fileno(LLUV_H(handle, uv_handle_t), &fd);
+    if((err == UV_EBADF) && psa){
+      err = lluv_udp_bind_any(handle, psa->ss_family);
+      if(err >= 0) err = uv_fileno(LLUV_H(handle, uv_handle_t), &fd);
+    }
+    if(err < 0){
+      return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base   = (void*)str;
+    iov.iov_len    = len;
+    msg.msg_iov    = &iov;
+    msg.msg_iovlen = 1;
+
+    if(psa){
+      msg.msg_name    = psa;
+      msg.msg_namelen = lluv_sockaddr_len((struct sockaddr*)psa);
+    }
+
+    if(size > 0){
+      struct cmsghdr *cmsg;
+      uint16_t segment = (uint16_t)size;
+
+      memset(control, 0, sizeof(control));
+      msg.msg_control    = control;
+      msg.msg_controllen = sizeof(control);
+
+      cmsg = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level = IPPROTO_UDP;
+      cmsg->cmsg_type  = UDP_SEGMENT;
+      cmsg->cmsg_len   = CMSG_LEN(sizeof(segment));
+      memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+    }
+
+    do{ r = sendmsg(fd, &msg, 0); }
+    while((r < 0) && (errno == EINTR));
+
+    err = (r < 0) ? -errno : (int)r;
+  }
+#else
+  UNUSED_ARG(str); UNUSED_ARG(psa);
+  err = UV_ENOTSUP;
+#endif
+
+  if(err < 0){
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
+  }
+
+  lua_pushinteger(L, err);
+  return 1;
+}
+
 //}
 
 //{ Recv
@@ -402,7 +1041,13 @@ static void lluv_on_udp_recv_cb(uv_udp_t *arg, ssize_t nread, const uv_buf_t* bu
     ** nread == 0 and addr == NULL when there is 
     ** nothing to read
     */
-    lluv_free_buffer((uv_handle_t*)arg, buf);
+    lluv_udp_free_buffer(handle, buf);
+    return;
+  }
+
+  /* libuv still delivers rest of recvmmsg chunks after uv_close */
+  if(uv_is_closing((uv_handle_t*)arg) || (LLUV_READ_CB(handle) == LUA_NOREF)){
+    lluv_udp_free_buffer(handle, buf);
     return;
   }
 
@@ -415,10 +1060,10 @@ static void lluv_on_udp_recv_cb(uv_udp_t *arg, ssize_t nread, const uv_buf_t* bu
     assert(addr);
     lua_pushnil(L);
     lua_pushlstring(L, buf->base, nread);
-    lluv_free_buffer((uv_handle_t*)arg, buf);
+    lluv_udp_free_buffer(handle, buf);
   }
   else{
-    lluv_free_buffer((uv_handle_t*)arg, buf);
+    lluv_udp_free_buffer(handle, buf);
 
     /* The callee is responsible for stopping closing the stream 
      *  when an error happens by calling uv_read_stop() or uv_close().
@@ -429,26 +1074,419 @@ static void lluv_on_udp_recv_cb(uv_udp_t *arg, ssize_t nread, const uv_buf_t* bu
     luaL_unref(L, LLUV_LUA_REGISTRY, LLUV_READ_CB(handle));
     LLUV_READ_CB(handle) = LUA_NOREF;
 
-    lluv_error_create(L, LLUV_ERR_UV, (uv_errno_t)nread, NULL);
+    lluv_error_push(L, handle->flags, LLUV_ERR_UV, (uv_errno_t)nread);
     lua_pushnil(L);
 
     lluv_handle_unlock(L, handle, LLUV_LOCK_READ);
   }
   lua_pushinteger(L, flags);
 
-  LLUV_HANDLE_CALL_CB(L, handle, 4 + lluv_push_addr(L, (const struct sockaddr_storage*)addr));
+  LLUV_HANDLE_CALL_CB(L, handle, 4 + lluv_udp_push_addr(L, LLUV_UDP_EXT(handle), addr));
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+/* Batched receive. Datagrams received during one loop iteration
+ * delivered with single callback from check phase.
+ */
+
+static int lluv_udp_batch_push(lluv_udp_ext_t *ext, const char *data, size_t len, const struct sockaddr *addr){
+  lluv_udp_dgram_t *dgram;
+
+  if(ext->bdgrams_n == ext->bdgrams_cap){
+    size_t cap = ext->bdgrams_cap ? ext->bdgrams_cap * 2 : 32;
+    lluv_udp_dgram_t *dgrams = (lluv_udp_dgram_t*)lluv_alloc(NULL, cap * sizeof(lluv_udp_dgram_t));
+    if(!dgrams) return UV_ENOMEM;
+
+    if(ext->bdgrams){
+      memcpy(dgrams, ext->bdgrams, ext->bdgrams_n * sizeof(lluv_udp_dgram_t));
+      lluv_free(NULL, ext->bdgrams);
+    }
+
+    ext->bdgrams     = dgrams;
+    ext->bdgrams_cap = cap;
+  }
+
+  if(ext->blen + len > ext->bcap){
+    size_t cap = ext->bcap ? ext->bcap : 4096;
+    char *bdata;
+
+    while(cap < ext->blen + len) cap *= 2;
+    bdata = (char*)lluv_alloc(NULL, cap);
+    if(!bdata) return UV_ENOMEM;
+
+    if(ext->bdata){
+      memcpy(bdata, ext->bdata, ext->blen);
+      lluv_free(NULL, ext->bdata);
+    }
+
+    ext->bdata = bdata;
+    ext->bcap  = cap;
+  }
+
+  dgram = &ext->bdgrams[ext->bdgrams_n++];
+  dgram->off = ext->blen;
+  dgram->len = len;
+  memcpy(&dgram->addr, addr, (addr->sa_family == AF_INET6) ?
+    sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in)
+  );
+
+  memcpy(ext->bdata + ext->blen, data, len);
+  ext->blen += len;
+
+  return 0;
+}
+
+static void lluv_udp_batch_flush(lua_State *L, lluv_handle_t *handle){
+  lluv_udp_ext_t *ext = LLUV_UDP_EXT(handle);
+  size_t i, n = ext->bdgrams_n;
+
+  lluv_loop_task_cancel(&ext->batch_task);
+
+  if(!IS_(handle, OPEN) || (LLUV_READ_CB(handle) == LUA_NOREF) || !ext->batch) return;
+  if(n == 0) return;
+
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, LLUV_READ_CB(handle));
+  lluv_handle_pushself(L, handle);
+  lua_pushnil(L);
+  lua_createtable(L, (int)n, 0);
+  lua_createtable(L, (int)n, 0);
+  if(LLUV_UDP_ADDR_IS_OBJECT(ext->addr_mode)) lua_pushnil(L); /* port is part of address */
+  else lua_createtable(L, (int)n, 0);
+
+  for(i = 0; i < n; ++i){
+    lluv_udp_dgram_t *dgram = &ext->bdgrams[i];
+    int top = lua_gettop(L);
+
+    lua_pushlstring(L, ext->bdata + dgram->off, dgram->len);
+    lua_rawseti(L, -4, (int)i + 1);
+
+    if(LLUV_UDP_ADDR_IS_OBJECT(ext->addr_mode)){
+      lluv_udp_push_addr(L, ext, (struct sockaddr*)&dgram->addr);
+      lua_rawseti(L, top - 1, (int)i + 1);
+    }
+    else if(lluv_udp_push_addr(L, ext, (struct sockaddr*)&dgram->addr)){
+      lua_settop(L, top + 2);
+      lua_rawseti(L, top, (int)i + 1);
+      lua_rawseti(L, top - 1, (int)i + 1);
+    }
+    lua_settop(L, top);
+  }
+
+  lua_pushinteger(L, (lua_Integer)n);
+
+  ext->bdgrams_n = 0;
+  ext->blen      = 0;
+
+  LLUV_HANDLE_CALL_CB(L, handle, 6);
+}
+
+static void lluv_udp_on_batch_task(lua_State *L, lluv_loop_task_t *task){
+  lluv_udp_ext_t *ext = (lluv_udp_ext_t*)((char*)task - offsetof(lluv_udp_ext_t, batch_task));
+  lluv_udp_batch_flush(L, ext->handle);
+}
+
+static void lluv_on_udp_recv_batch_cb(uv_udp_t *arg, ssize_t nread, const uv_buf_t* buf, const struct sockaddr* addr, unsigned flags){
+  lluv_handle_t *handle = lluv_handle_byptr((uv_handle_t*)arg);
+  lua_State *L = LLUV_HCALLBACK_L(handle);
+  lluv_udp_ext_t *ext = LLUV_UDP_EXT(handle);
+
+  UNUSED_ARG(flags);
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  if(((nread == 0) && (addr == NULL)) || uv_is_closing((uv_handle_t*)arg)){
+    lluv_udp_free_buffer(handle, buf);
+    return;
+  }
+
+  if(nread >= 0){
+    int err = lluv_udp_batch_push(ext, buf->base, (size_t)nread, addr);
+    lluv_udp_free_buffer(handle, buf);
+
+    if(err >= 0){
+      if(ext->bdgrams_n >= ext->batch) lluv_udp_batch_flush(L, handle);
+      else err = lluv_loop_check_task_queue(lluv_loop_by_handle(&handle->handle), &ext->batch_task);
+    }
+
+    if(err < 0) nread = err;
+  }
+  else{
+    lluv_udp_free_buffer(handle, buf);
+  }
+
+  if(nread < 0){
+    /* deliver datagrams received before error */
+    lluv_udp_batch_flush(L, handle);
+
+    if(IS_(handle, OPEN) && (LLUV_READ_CB(handle) != LUA_NOREF)){
+      uv_udp_recv_stop(arg);
+
+      lua_rawgeti(L, LLUV_LUA_REGISTRY, LLUV_READ_CB(handle));
+      luaL_unref(L, LLUV_LUA_REGISTRY, LLUV_READ_CB(handle));
+      LLUV_READ_CB(handle) = LUA_NOREF;
+
+      lluv_handle_pushself(L, handle);
+      lluv_error_push(L, handle->flags, LLUV_ERR_UV, (uv_errno_t)nread);
+
+      lluv_handle_unlock(L, handle, LLUV_LOCK_READ);
+
+      LLUV_HANDLE_CALL_CB(L, handle, 2);
+    }
+  }
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+/* GRO receive.
+ * libuv does not pass control messages so socket read here.
+ * Zero size buffer makes libuv call receive callback with UV_ENOBUFS
+ * each time socket becomes readable without reading it.
+ */
+
+#ifdef LLUV_UDP_GRO
+
+#define LLUV_UDP_GRO_READS 32 /* max reads per loop iteration like libuv does */
+
+static void lluv_udp_alloc_gro_cb(uv_handle_t* h, size_t suggested_size, uv_buf_t *buf){
+  UNUSED_ARG(h); UNUSED_ARG(suggested_size);
+  *buf = lluv_buf_init(NULL, 0);
+}
+
+static void lluv_udp_gro_read(lua_State *L, lluv_handle_t *handle){
+  lluv_udp_ext_t *ext = LLUV_UDP_EXT(handle);
+  uv_os_fd_t fd; int i;
+
+  if(uv_fileno(LLUV_H(handle, uv_handle_t), &fd) < 0) return;
+
+  if(!ext->gbuf){
+    ext->gbuf = (char*)lluv_alloc(L, LLUV_UDP_DGRAM_SIZE);
+    if(!ext->gbuf) return;
+  }
+
+  for(i = 0; i < LLUV_UDP_GRO_READS; ++i){
+    char control[CMSG_SPACE(sizeof(int))];
+    struct sockaddr_storage peer;
+    struct msghdr msg; struct iovec iov;
+    struct cmsghdr *cmsg;
+    ssize_t nread; int segment = 0, rerr;
+    unsigned int flags = 0;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base       = ext->gbuf;
+    iov.iov_len        = LLUV_UDP_DGRAM_SIZE;
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_name       = &peer;
+    msg.msg_namelen    = sizeof(peer);
+    msg.msg_control    = control;
+    msg.msg_controllen = sizeof(control);
+
+    do{ nread = recvmsg(fd, &msg, MSG_DONTWAIT); }
+    while((nread < 0) && (errno == EINTR));
+
+    /* Lua and libuv calls below may change errno */
+    rerr = (nread < 0) ? errno : 0;
+
+    if((nread < 0) && ((rerr == EAGAIN) || (rerr == EWOULDBLOCK))) break;
+
+    lua_rawgeti(L, LLUV_LUA_REGISTRY, LLUV_READ_CB(handle));
+    lluv_handle_pushself(L, handle);
+
+    if(nread < 0){
+      uv_udp_recv_stop(LLUV_H(handle, uv_udp_t));
+
+      luaL_unref(L, LLUV_LUA_REGISTRY, LLUV_READ_CB(handle));
+      LLUV_READ_CB(handle) = LUA_NOREF;
+
+      lluv_error_push(L, handle->flags, LLUV_ERR_UV, (uv_errno_t)-rerr);
+
+      lluv_handle_unlock(L, handle, LLUV_LOCK_READ);
+
+      LLUV_HANDLE_CALL_CB(L, handle, 2);
+      return;
+    }
+
+    for(cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)){
+      if((cmsg->cmsg_level == IPPROTO_UDP) && (cmsg->cmsg_type == UDP_GRO)){
+        memcpy(&segment, CMSG_DATA(cmsg), sizeof(segment));
+      }
+    }
+    if(segment == 0) segment = (int)nread;
+
+    if(msg.msg_flags & MSG_TRUNC) flags |= UV_UDP_PARTIAL;
+
+    lua_pushnil(L);
+    lua_pushlstring(L, ext->gbuf, nread);
+    lua_pushinteger(L, flags);
+    {
+      int n = lluv_udp_push_addr(L, ext, (struct sockaddr*)&peer);
+      lua_pushinteger(L, segment);
+
+      LLUV_HANDLE_CALL_CB(L, handle, 5 + n);
+    }
+
+    if(!IS_(handle, OPEN) || (LLUV_READ_CB(handle) == LUA_NOREF) || !ext->gro) break;
+  }
+}
+
+static void lluv_on_udp_recv_gro_cb(uv_udp_t *arg, ssize_t nread, const uv_buf_t* buf, const struct sockaddr* addr, unsigned flags){
+  lluv_handle_t *handle = lluv_handle_byptr((uv_handle_t*)arg);
+  lua_State *L = LLUV_HCALLBACK_L(handle);
+
+  UNUSED_ARG(buf); UNUSED_ARG(addr); UNUSED_ARG(flags);
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  if((nread == UV_ENOBUFS) && !uv_is_closing((uv_handle_t*)arg) && (LLUV_READ_CB(handle) != LUA_NOREF)){
+    lluv_udp_gro_read(L, handle);
+  }
 
   LLUV_CHECK_LOOP_CB_INVARIANT(L);
 }
 
+#endif
+
+static int lluv_udp_set_gro(lluv_handle_t *handle, int on){
+#ifdef LLUV_UDP_GRO
+  uv_os_fd_t fd;
+  int err = uv_fileno(LLUV_H(handle, uv_handle_t), &fd);
+  if((err >= 0) && setsockopt(fd, IPPROTO_UDP, UDP_GRO, &on, sizeof(on))) err = -errno;
+  return err;
+#else
+  UNUSED_ARG(handle); UNUSED_ARG(on);
+  return UV_ENOTSUP;
+#endif
+}
+
+/* disable GRO when handle switched to regular receive */
+static void lluv_udp_reset_gro(lluv_udp_ext_t *ext){
+  if(ext->gro){
+    lluv_udp_set_gro(ext->handle, 0);
+    ext->gro = 0;
+  }
+}
+
+/* start_recv({gro=true}, cb) */
+static int lluv_udp_start_recv_gro(lua_State *L, lluv_handle_t *handle, unsigned char addr_mode){
+#ifdef LLUV_UDP_GRO
+  lluv_udp_ext_t *ext;
+  int err;
+
+  lluv_check_args_with_cb(L, 3);
+
+  err = lluv_udp_set_gro(handle, 1);
+  if(err < 0){
+    return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
+  }
+
+  ext = lluv_udp_ext(L, handle);
+  lluv_loop_task_cancel(&ext->batch_task);
+  ext->batch     = 0;
+  ext->bdgrams_n = 0;
+  ext->blen      = 0;
+  ext->addr_mode = addr_mode;
+  ext->gro       = 1;
+
+  LLUV_READ_CB(handle) = luaL_ref(L, LLUV_LUA_REGISTRY);
+
+  err = uv_udp_recv_start(LLUV_H(handle, uv_udp_t), lluv_udp_alloc_gro_cb, lluv_on_udp_recv_gro_cb);
+
+  if(err >= 0) lluv_handle_lock(L, handle, LLUV_LOCK_READ);
+
+  return lluv_return(L, handle, LLUV_READ_CB(handle), err);
+#else
+  UNUSED_ARG(addr_mode);
+  return lluv_fail(L, handle->flags, LLUV_ERR_UV, UV_ENOTSUP, NULL);
+#endif
+}
+
+/* start_recv({batch=...}, cb) */
+static int lluv_udp_start_recv_batch(lua_State *L, lluv_handle_t *handle, unsigned char addr_mode){
+  lluv_udp_ext_t *ext;
+  size_t batch = (size_t)-1;
+  int err;
+
+  lluv_check_args_with_cb(L, 3);
+
+  lua_getfield(L, 2, "batch");
+  if(lua_type(L, -1) != LUA_TBOOLEAN){
+    lua_Integer n = luaL_checkinteger(L, -1);
+    luaL_argcheck(L, n > 0, 2, "batch should be positive number");
+    batch = (size_t)n;
+  }
+  else luaL_argcheck(L, lua_toboolean(L, -1), 2, "batch should be positive number or true");
+  lua_pop(L, 1);
+
+  ext = lluv_udp_ext(L, handle);
+  lluv_udp_reset_gro(ext);
+  ext->batch     = batch;
+  ext->addr_mode = addr_mode;
+
+  LLUV_READ_CB(handle) = luaL_ref(L, LLUV_LUA_REGISTRY);
+
+  err = uv_udp_recv_start(LLUV_H(handle, uv_udp_t), lluv_udp_alloc_cb, lluv_on_udp_recv_batch_cb);
+  if(err >= 0){
+    lluv_handle_lock(L, handle, LLUV_LOCK_READ);
+    /* datagrams received before stop_recv */
+    if(ext->bdgrams_n){
+      lluv_loop_check_task_queue(lluv_loop_by_handle(&handle->handle), &ext->batch_task);
+    }
+  }
+
+  return lluv_return(L, handle, LLUV_READ_CB(handle), err);
+}
+
 static int lluv_udp_start_recv(lua_State *L){
+  static const char *ADDR_MODES[] = {"string", "sockaddr", "interned", "binary", NULL};
+
   lluv_handle_t *handle = lluv_check_udp(L, 1, LLUV_FLAG_OPEN);
+  unsigned char addr_mode = LLUV_UDP_ADDR_STRING;
   int err;
 
+  if(lua_type(L, 2) == LUA_TTABLE){
+    lua_getfield(L, 2, "addr");
+    addr_mode = (unsigned char)luaL_checkoption(L, -1, "string", ADDR_MODES);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 2, "gro");
+    if(lua_toboolean(L, -1)){
+      lua_pop(L, 1);
+      lua_getfield(L, 2, "batch");
+      luaL_argcheck(L, lua_isnil(L, -1), 2, "gro can not be used with batch");
+      lua_pop(L, 1);
+      return lluv_udp_start_recv_gro(L, handle, addr_mode);
+    }
+    lua_pop(L, 1);
+
+    lua_getfield(L, 2, "batch");
+    if(!lua_isnil(L, -1)){
+      lua_pop(L, 1);
+      return lluv_udp_start_recv_batch(L, handle, addr_mode);
+    }
+    lua_pop(L, 1);
+
+    lua_remove(L, 2);
+  }
+
   lluv_check_args_with_cb(L, 2);
+
+  if(LLUV_UDP_EXT(handle)){
+    lluv_udp_ext_t *ext = LLUV_UDP_EXT(handle);
+    lluv_loop_task_cancel(&ext->batch_task);
+    lluv_udp_reset_gro(ext);
+    ext->batch     = 0;
+    ext->bdgrams_n = 0;
+    ext->blen      = 0;
+    ext->addr_mode = addr_mode;
+  }
+  else if(addr_mode != LLUV_UDP_ADDR_STRING){
+    lluv_udp_ext(L, handle)->addr_mode = addr_mode;
+  }
+
   LLUV_READ_CB(handle) = luaL_ref(L, LLUV_LUA_REGISTRY);
 
-  err = uv_udp_recv_start(LLUV_H(handle, uv_udp_t), lluv_alloc_buffer_cb, lluv_on_udp_recv_cb);
+  err = uv_udp_recv_start(LLUV_H(handle, uv_udp_t), lluv_udp_alloc_cb, lluv_on_udp_recv_cb);
 
   if(err >= 0) lluv_handle_lock(L, handle, LLUV_LOCK_READ);
 
@@ -466,6 +1504,10 @@ static int lluv_udp_stop_recv(lua_State *L){
     return lluv_fail(L, handle->flags, LLUV_ERR_UV, err, NULL);
   }
 
+  if(LLUV_UDP_EXT(handle)){
+    lluv_loop_task_cancel(&LLUV_UDP_EXT(handle)->batch_task);
+  }
+
   if(LLUV_READ_CB(handle) != LUA_NOREF){
     luaL_unref(L, LLUV_LUA_REGISTRY, LLUV_READ_CB(handle));
     LLUV_READ_CB(handle) = LUA_NOREF;
@@ -610,6 +1652,9 @@ static const struct luaL_Reg lluv_udp_methods[] = {
   { "bind",                     lluv_udp_bind                    },
   { "try_send",                 lluv_udp_try_send                },
   { "send",                     lluv_udp_send                    },
+  { "send_batch",               lluv_udp_send_batch              },
+  { "try_send_gso",             lluv_udp_try_send_gso            },
+  { "set_gso",                  lluv_udp_set_gso                 },
   { "getsockname",              lluv_udp_getsockname             },
   { "start_recv",               lluv_udp_start_recv              },
   { "stop_recv",                lluv_udp_stop_recv               },
@@ -633,6 +1678,9 @@ static const lluv_uv_const_t lluv_udp_constants[] = {
   { UV_UDP_IPV6ONLY,   "UDP_IPV6ONLY"   },
   { UV_UDP_PARTIAL,    "UDP_PARTIAL"    },
   { UV_UDP_REUSEADDR,  "UDP_REUSEADDR"  },
+#if LLUV_UV_VER_GE(1,37,0)
+  { UV_UDP_RECVMMSG,   "UDP_RECVMMSG"   },
+#endif
   { UV_LEAVE_GROUP ,   "LEAVE_GROUP"    },
   { UV_JOIN_GROUP,     "JOIN_GROUP"     },
 
@@ -660,6 +1708,7 @@ LLUV_INTERNAL void lluv_udp_initlib(lua_State *L, int nup, int safe){
   if(!lutil_createmetap(L, LLUV_UDP, lluv_udp_methods, nup))
     lua_pop(L, nup);
   lua_pop(L, 1);
+  lluv_handle_createmeta(L, nup, UV_UDP, LLUV_UDP, NULL);
 
   luaL_setfuncs(L, lluv_functions[safe], nup);
   lluv_register_constants(L, lluv_udp_constants);
@@ -13,6 +13,6 @@
 
 LLUV_INTERNAL void lluv_udp_initlib(lua_State *L, int nup, int safe);
 
-LLUV_INTERNAL int lluv_udp_index(lua_State *L);
+LLUV_INTERNAL void lluv_udp_ext_free(lua_State *L, struct lluv_handle_tag *handle);
 
 #endif
@@ -14,6 +14,7 @@
 #include "lluv_handle.h"
 #include "lluv_loop.h"
 #include "lluv_req.h"
+#include "lluv_sockaddr.h"
 #include <memory.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -90,17 +91,6 @@ LLUV_INTERNAL int lluv_lua_call(lua_State* L, int narg, int nret){
   return ret;
 }
 
-LLUV_INTERNAL int lluv__index(lua_State *L, const char *meta, lua_CFunction inherit){
-  assert(lua_gettop(L) == 2);
-
-  lutil_getmetatablep(L, meta);
-  lua_pushvalue(L, 2); lua_rawget(L, -2);
-  if(!lua_isnil(L, -1)) return 1;
-  lua_settop(L, 2);
-  if(inherit) return inherit(L);
-  return 0;
-}
-
 LLUV_INTERNAL void lluv_check_callable(lua_State *L, int idx){
   idx = lua_absindex(L, idx);
   luaL_checktype(L, idx, LUA_TFUNCTION);
@@ -123,32 +113,22 @@ LLUV_INTERNAL void lluv_push_status(lua_State *L, int status){
     lluv_error_create(L, LLUV_ERR_UV, (uv_errno_t)status, NULL);
 }
 
-LLUV_INTERNAL void lluv_alloc_buffer_cb(uv_handle_t* h, size_t suggested_size, uv_buf_t *buf){
-//  *buf = lluv_buf_init(malloc(suggested_size), suggested_size);
-  lluv_handle_t *handle = lluv_handle_byptr(h);
-  lluv_loop_t     *loop = lluv_loop_by_handle(h);
+LLUV_INTERNAL void lluv_push_status_ex(lua_State *L, lluv_flags_t flags, int status){
+  if(status >= 0)
+    lua_pushnil(L);
+  else
+    lluv_error_push(L, flags, LLUV_ERR_UV, (uv_errno_t)status);
+}
 
-  if(!IS_(loop, BUFFER_BUSY)){
-    SET_(loop, BUFFER_BUSY);
-    buf->base = loop->buffer; buf->len = loop->buffer_size;
-  }
-  else{
-    *buf = lluv_buf_init(lluv_alloc(handle->L, suggested_size), suggested_size);
-  }
+LLUV_INTERNAL void lluv_alloc_buffer_cb(uv_handle_t* h, size_t suggested_size, uv_buf_t *buf){
+  lluv_loop_t *loop = lluv_loop_by_handle(h);
+  *buf = lluv_loop_buffer_alloc(loop, suggested_size);
 }
 
 LLUV_INTERNAL void lluv_free_buffer(uv_handle_t* h, const uv_buf_t *buf){
   if(buf->base){
-    lluv_handle_t *handle = lluv_handle_byptr(h);
-    lluv_loop_t     *loop = lluv_loop_by_handle(h);
-
-    if(buf->base == loop->buffer){
-      assert(IS_(loop, BUFFER_BUSY));
-      UNSET_(loop, BUFFER_BUSY);
-    }
-    else{
-      lluv_free(handle->L, &buf->base[0]);
-    }
+    lluv_loop_t *loop = lluv_loop_by_handle(h);
+    lluv_loop_buffer_free(loop, buf);
   }
 }
 
@@ -188,11 +168,34 @@ LLUV_INTERNAL int lluv_to_addr(lua_State *L, const char *addr, int port, struct
 }
 
 LLUV_INTERNAL int lluv_check_addr(lua_State *L, int i, struct sockaddr_storage *sa){
-  const char *addr  = luaL_checkstring(L, i);
-  lua_Integer port  = luaL_checkint(L, i + 1);
+  const char *addr;
+  lua_Integer port;
+  struct sockaddr_storage *psa = lluv_test_sockaddr(L, i);
+
+  if(psa){
+    memcpy(sa, psa, lluv_sockaddr_len((struct sockaddr*)psa));
+    /* placeholder for port so rest of arguments keep their indexes */
+    lua_pushnil(L);
+    lua_insert(L, i + 1);
+    return 0;
+  }
+
+  addr = luaL_checkstring(L, i);
+  port = luaL_checkint(L, i + 1);
   return lluv_to_addr(L, addr, port, sa);
 }
 
+LLUV_INTERNAL void lluv_push_host_port(lua_State *L, int i){
+  struct sockaddr_storage *sa = lluv_test_sockaddr(L, i);
+
+  if(sa){
+    lluv_sockaddr_push_string(L, sa);
+    return;
+  }
+
+  lua_pushvalue(L, i); lua_pushliteral(L, ":"); lua_pushvalue(L, i + 1); lua_concat(L, 3);
+}
+
 LLUV_INTERNAL int lluv_push_addr(lua_State *L, const struct sockaddr_storage *addr){
   char buf[INET6_ADDRSTRLEN + 1];
 
@@ -72,8 +72,6 @@ LLUV_INTERNAL void lluv_free(lua_State* L, void *ptr);
 
 LLUV_INTERNAL int lluv_lua_call(lua_State* L, int narg, int nret);
 
-LLUV_INTERNAL int lluv__index(lua_State *L, const char *meta, lua_CFunction inherit);
-
 LLUV_INTERNAL void lluv_check_callable(lua_State *L, int idx);
 
 LLUV_INTERNAL void lluv_check_none(lua_State *L, int idx);
@@ -90,10 +88,16 @@ LLUV_INTERNAL void lluv_free_buffer(uv_handle_t* handle, const uv_buf_t *buf);
 
 LLUV_INTERNAL int lluv_to_addr(lua_State *L, const char *addr, int port, struct sockaddr_storage *sa);
 
+/* accepts host/port pair or sockaddr object. For sockaddr object
+ * inserts nil after it so arguments after port keep their indexes.
+ */
 LLUV_INTERNAL int lluv_check_addr(lua_State *L, int i, struct sockaddr_storage *sa);
 
 LLUV_INTERNAL int lluv_push_addr(lua_State *L, const struct sockaddr_storage *addr);
 
+/* push `host:port` string for address arguments checked with lluv_check_addr */
+LLUV_INTERNAL void lluv_push_host_port(lua_State *L, int i);
+
 LLUV_INTERNAL void lluv_push_stat(lua_State* L, const uv_stat_t* s);
 
 LLUV_INTERNAL void lluv_stack_dump(lua_State* L, int top, const char* name);
@@ -167,10 +171,13 @@ typedef unsigned char lluv_flag_t;
 #define LLUV_FLAG_STREAM       LLUV_FLAG_2
 #define LLUV_FLAG_DEFAULT_LOOP LLUV_FLAG_2
 #define LLUV_FLAG_RAISE_ERROR  LLUV_FLAG_3
-#define LLUV_FLAG_BUFFER_BUSY  LLUV_FLAG_4
+#define LLUV_FLAG_ERROR_NUMBER LLUV_FLAG_4 /* pass errors to callbacks as numbers */
 
 #define INHERITE_FLAGS(O) (O->flags & (LLUV_FLAG_RAISE_ERROR))
 
+/* like lluv_push_status but respects LLUV_FLAG_ERROR_NUMBER */
+LLUV_INTERNAL void lluv_push_status_ex(lua_State *L, lluv_flags_t flags, int status);
+
 #define LLUV_IMPL_SAFE(N)                                                                \
   static int N##_impl(lua_State *L, lluv_flags_t safe_flag);                             \
   static int N##_safe(lua_State *L){return N##_impl(L, 0);}                              \
@@ -0,0 +1,295 @@
+/******************************************************************************
+* Author: Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Copyright (C) 2014-2016 Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Licensed according to the included 'LICENSE' document
+*
+* This file is part of lua-lluv library.
+******************************************************************************/
+
+#include "lluv.h"
+#include "lluv_utils.h"
+#include "lluv_loop.h"
+#include "lluv_error.h"
+#include "lluv_serial.h"
+#include "lluv_work.h"
+#include <lualib.h>
+#include <assert.h>
+#include <string.h>
+
+/* Run Lua code in libuv threadpool.
+ * Each threadpool thread owns its own lua_State which is created
+ * on first job and reused for all next jobs. Compiled chunks are
+ * cached in this state. Arguments and results are serialized.
+ */
+
+#ifndef LLUV_WORK_CACHE_LIMIT
+#  define LLUV_WORK_CACHE_LIMIT 64
+#endif
+
+typedef struct lluv_work_state_tag{
+  lua_State *L;
+  int        cached; /* number of cached chunks */
+} lluv_work_state_t;
+
+typedef struct lluv_work_tag{
+  uv_work_t    req;
+  int          cb;
+  char        *code;
+  size_t       code_len;
+  lluv_sbuf_t  data;   /* arguments and then results or error message */
+  int          failed;
+} lluv_work_t;
+
+static const char *LLUV_WORK_CACHE = LLUV_PREFIX" Work cache";
+
+static uv_once_t lluv_work_once = UV_ONCE_INIT;
+static uv_key_t  lluv_work_key;
+static int       lluv_work_key_err;
+
+static void lluv_work_key_init(void){
+  lluv_work_key_err = uv_key_create(&lluv_work_key);
+}
+
+static lluv_work_state_t *lluv_work_state(void){
+  lluv_work_state_t *state;
+
+  uv_once(&lluv_work_once, lluv_work_key_init);
+  if(lluv_work_key_err < 0) return NULL;
+
+  state = (lluv_work_state_t*)uv_key_get(&lluv_work_key);
+  if(state) return state;
+
+  state = lluv_alloc_t(NULL, lluv_work_state_t);
+  if(!state) return NULL;
+
+  state->L = luaL_newstate();
+  if(!state->L){
+    lluv_free_t(NULL, lluv_work_state_t, state);
+    return NULL;
+  }
+
+  luaL_openlibs(state->L);
+  lua_newtable(state->L);
+  lua_rawsetp(state->L, LUA_REGISTRYINDEX, LLUV_WORK_CACHE);
+  state->cached = 0;
+
+  uv_key_set(&lluv_work_key, state);
+  return state;
+}
+
+static void lluv_work_fail(lluv_work_t *w, const char *msg, size_t len){
+  lluv_serial_release(w->data.data, w->data.size);
+  w->failed = 1;
+  w->data.size = 0;
+  lluv_sbuf_append(&w->data, msg, len);
+}
+
+static void lluv_work_fail_lua(lluv_work_t *w, lua_State *L){
+  size_t len; const char *msg = lua_tolstring(L, -1, &len);
+  if(!msg) msg = "(error object is not a string)", len = strlen(msg);
+  lluv_work_fail(w, msg, len);
+}
+
+/* push compiled chunk */
+static int lluv_work_load(lluv_work_state_t *state, lluv_work_t *w){
+  lua_State *L = state->L;
+
+  lua_rawgetp(L, LUA_REGISTRYINDEX, LLUV_WORK_CACHE);
+  lua_pushlstring(L, w->code, w->code_len);
+  lua_rawget(L, -2);
+  if(lua_isfunction(L, -1)){
+    lua_remove(L, -2);
+    return 0;
+  }
+  lua_pop(L, 1);
+
+  if(luaL_loadbuffer(L, w->code, w->code_len, "=queue_work")){
+    lua_remove(L, -2);
+    return -1;
+  }
+
+  if(state->cached >= LLUV_WORK_CACHE_LIMIT){
+    lua_newtable(L);
+    lua_replace(L, -3);
+    lua_pushvalue(L, -2);
+    lua_rawsetp(L, LUA_REGISTRYINDEX, LLUV_WORK_CACHE);
+    state->cached = 0;
+  }
+
+  lua_pushlstring(L, w->code, w->code_len);
+  lua_pushvalue(L, -2);
+  lua_rawset(L, -4);
+  state->cached += 1;
+
+  lua_remove(L, -2);
+  return 0;
+}
+
+static void lluv_on_work(uv_work_t *arg){
+  lluv_work_t       *w     = (lluv_work_t*)arg->data;
+  lluv_work_state_t *state = lluv_work_state();
+  lua_State *L;
+  const char *msg;
+  int n;
+
+  if(!state){
+    msg = "can not create Lua state";
+    lluv_work_fail(w, msg, strlen(msg));
+    return;
+  }
+
+  L = state->L;
+  lua_settop(L, 0);
+
+  if(lluv_work_load(state, w)){
+    lluv_work_fail_lua(w, L);
+    lua_settop(L, 0);
+    return;
+  }
+
+  n = lluv_serial_decode(L, w->data.data, w->data.size);
+  w->data.size = 0;
+  if(n < 0){
+    msg = "invalid arguments";
+    lluv_work_fail(w, msg, strlen(msg));
+    lua_settop(L, 0);
+    return;
+  }
+
+  if(lua_pcall(L, n, LUA_MULTRET, 0)){
+    lluv_work_fail_lua(w, L);
+    lua_settop(L, 0);
+    return;
+  }
+
+  if(lluv_serial_encode(L, 1, lua_gettop(L), &w->data, &msg)){
+    lluv_work_fail(w, msg, strlen(msg));
+  }
+
+  lua_settop(L, 0);
+}
+
+static void lluv_work_free(lua_State *L, lluv_work_t *w){
+  luaL_unref(L, LLUV_LUA_REGISTRY, w->cb);
+  lluv_sbuf_free(&w->data);
+  if(w->code) lluv_free(L, w->code);
+  lluv_free_t(L, lluv_work_t, w);
+}
+
+static void lluv_on_after_work(uv_work_t *arg, int status){
+  lluv_work_t *w    = (lluv_work_t*)arg->data;
+  lluv_loop_t *loop = lluv_loop_byptr(arg->loop);
+  lua_State   *L    = loop->L;
+  int n;
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+
+  lua_rawgeti(L, LLUV_LUA_REGISTRY, w->cb);
+  lluv_loop_pushself(L, loop);
+
+  if(status < 0){
+    if(!w->failed) lluv_serial_release(w->data.data, w->data.size);
+    lluv_error_create(L, LLUV_ERR_UV, (uv_errno_t)status, NULL);
+    n = 0;
+  }
+  else if(w->failed){
+    lluv_sbuf_append(&w->data, "", 1);
+    lluv_error_create(L, LLUV_ERR_LIB, UV_EINVAL, w->data.data);
+    n = 0;
+  }
+  else{
+    lua_pushnil(L);
+    n = lluv_serial_decode(L, w->data.data, w->data.size);
+    if(n < 0){
+      lua_pop(L, 1);
+      lluv_error_create(L, LLUV_ERR_LIB, UV_EINVAL, "invalid results");
+      n = 0;
+    }
+  }
+
+  lluv_work_free(L, w);
+
+  LLUV_LOOP_CALL_CB(L, loop, n + 2);
+
+  LLUV_CHECK_LOOP_CB_INVARIANT(L);
+}
+
+/* queue_work([loop,] code, ..., cb) */
+LLUV_IMPL_SAFE(lluv_queue_work){
+  lluv_loop_t *loop = lluv_opt_loop(L, 1, LLUV_FLAG_OPEN);
+  int argc = loop ? 1 : 0;
+  lluv_work_t *w;
+  const char *msg;
+  int err;
+
+  if(!loop) loop = lluv_default_loop(L);
+
+  luaL_argcheck(L, lua_type(L, argc + 1) == LUA_TSTRING || lua_type(L, argc + 1) == LUA_TFUNCTION,
+    argc + 1, "string or function expected"
+  );
+  luaL_argcheck(L, lua_gettop(L) > argc + 1, argc + 2, "callback expected");
+  lluv_check_callable(L, -1);
+
+  w = lluv_alloc_t(L, lluv_work_t);
+  if(!w) return lluv_fail(L, safe_flag | loop->flags, LLUV_ERR_UV, UV_ENOMEM, NULL);
+
+  w->req.data = w;
+  w->cb       = LUA_NOREF;
+  w->code     = NULL;
+  w->failed   = 0;
+  lluv_sbuf_init(&w->data);
+
+  {
+    lluv_sbuf_t chunk;
+    lluv_sbuf_init(&chunk);
+    err = lluv_serial_code(L, argc + 1, &chunk);
+    if(err < 0){
+      lluv_sbuf_free(&chunk);
+      lluv_work_free(L, w);
+      if(err == UV_ENOMEM) return lluv_fail(L, safe_flag | loop->flags, LLUV_ERR_UV, UV_ENOMEM, NULL);
+      return luaL_argerror(L, argc + 1, "can not dump function");
+    }
+    w->code     = chunk.data;
+    w->code_len = chunk.size;
+  }
+
+  if(lluv_serial_encode(L, argc + 2, lua_gettop(L) - 1, &w->data, &msg)){
+    lluv_serial_release(w->data.data, w->data.size);
+    lluv_work_free(L, w);
+    return luaL_error(L, "%s", msg);
+  }
+
+  w->cb = luaL_ref(L, LLUV_LUA_REGISTRY);
+
+  err = uv_queue_work(loop->handle, &w->req, lluv_on_work, lluv_on_after_work);
+  if(err < 0){
+    lua_rawgeti(L, LLUV_LUA_REGISTRY, w->cb);
+    lluv_serial_release(w->data.data, w->data.size);
+    lluv_work_free(L, w);
+    lluv_loop_pushself(L, loop);
+    lluv_error_create(L, LLUV_ERR_UV, err, NULL);
+    lluv_loop_defer_call(L, loop, 2);
+  }
+
+  lluv_loop_pushself(L, loop);
+  return 1;
+}
+
+static const struct luaL_Reg lluv_functions[][2] = {
+  {
+    {"queue_work", lluv_queue_work_unsafe},
+
+    {NULL,NULL}
+  },
+  {
+    {"queue_work", lluv_queue_work_safe},
+
+    {NULL,NULL}
+  },
+};
+
+LLUV_INTERNAL void lluv_work_initlib(lua_State *L, int nup, int safe){
+  luaL_setfuncs(L, lluv_functions[safe], nup);
+}
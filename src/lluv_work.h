@@ -0,0 +1,16 @@
+/******************************************************************************
+* Author: Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Copyright (C) 2014-2016 Alexey Melnichuk <alexeymelnichuck@gmail.com>
+*
+* Licensed according to the included 'LICENSE' document
+*
+* This file is part of lua-lluv library.
+******************************************************************************/
+
+#ifndef _LLUV_WORK_H_
+#define _LLUV_WORK_H_
+
+LLUV_INTERNAL void lluv_work_initlib(lua_State *L, int nup, int safe);
+
+#endif
@@ -922,6 +922,124 @@ function DeferQueue.self_test()
 end
 
 
+end
+-------------------------------------------------------------------
+
+-------------------------------------------------------------------
+-- Run `n` threads each with its own loop and TCP server bound
+-- to the same address with SO_REUSEPORT. Kernel balances incoming
+-- connections between them.
+--
+-- `fn(server, ...)` called in each thread with bound server and
+-- should start listen. Function can not use upvalues.
+--
+-- local shards = ListenShards.new(4, "0.0.0.0", 8080, function(server)
+--   server:listen(function(server, err) ... end)
+-- end)
+-- ...
+-- shards:stop():join()
+local ListenShards = class() do
+
+local uv
+
+-- code of each thread
+local SHARD = [[
+local code, id, host, port, main, args = ...
+local uv = require "lluv"
+local unpack = unpack or table.unpack
+local fn = assert((loadstring or load)(code))
+
+local server, err = uv.tcp():bind(host, port, {reuseport = true})
+if not server then
+  main:send(id, nil, tostring(err))
+  return
+end
+
+local control = uv.channel(function(self)
+  for _, h in ipairs(uv.handles()) do
+    if not h:closing() then h:close() end
+  end
+end)
+
+main:send(id, control)
+
+fn(server, unpack(args))
+
+uv.run()
+]]
+
+-- returns when all shards ready to accept connections
+function ListenShards:__init(n, host, port, fn, ...)
+  uv = uv or require "lluv"
+
+  self._threads  = {}
+  self._controls = {}
+  self._errors   = {}
+
+  local code, pending = string.dump(fn), n
+
+  -- private loop used only to wait shards
+  local loop = uv.loop()
+
+  -- bind probe socket to get port for all shards
+  local probe
+  if port == 0 then
+    local err
+    probe, err = uv.tcp(loop):bind(host, port, {reuseport = true})
+    if not probe then
+      loop:close()
+      return nil, err
+    end
+    local _; _, port = probe:getsockname()
+  end
+
+  self._port = port
+
+  local main = uv.channel(loop, function(main, id, control, err)
+    if control then self._controls[id] = control
+    else self._errors[id] = err end
+
+    pending = pending - 1
+    if pending == 0 then
+      if probe then probe:close() end
+      main:close()
+    end
+  end)
+
+  for id = 1, n do
+    self._threads[id] = uv.thread(SHARD, code, id, host, port, main, {...})
+  end
+
+  loop:run()
+  loop:close()
+
+  return self
+end
+
+function ListenShards:port()
+  return self._port
+end
+
+-- errors reported by shards which could not bind
+function ListenShards:errors()
+  return self._errors
+end
+
+function ListenShards:stop()
+  for _, control in pairs(self._controls) do
+    control:send("stop")
+  end
+  return self
+end
+
+-- blocks until all threads done
+function ListenShards:join()
+  for id, thread in ipairs(self._threads) do
+    if not thread:joined() then thread:join() end
+  end
+  return self
+end
+
 end
 -------------------------------------------------------------------
 
@@ -1019,6 +1137,7 @@ return {
   List        = List;
   Errors      = MakeErrors;
   DeferQueue  = DeferQueue;
+  ListenShards = ListenShards;
   class       = Class;
   split_first = split_first;
   split       = split;
@@ -0,0 +1,96 @@
+local uv = require "lluv"
+
+local function printf(...) io.write(string.format(...)) end
+
+-- Number of wakeups for each test
+local NUM_WAKEUPS = 200000
+
+local PIPE_NAME = (package.config:sub(1, 1) == '\\') and
+  '\\\\.\\pipe\\lluv-benchmark-async' or
+  '/tmp/lluv-benchmark-async.sock'
+
+local function report(name, start, count)
+  local t = (uv.hrtime() - start) / 1e9
+  printf("%-14s %d wakeups in %.2f seconds, %.0f wakeups/s\n", name, count, t, count / t)
+end
+
+-- each callback wakes up loop again
+local function async_wakeups(done)
+  local count, start = 0
+
+  local async = uv.async(function(self)
+    count = count + 1
+    if count < NUM_WAKEUPS then return self:send() end
+    report("async", start, count)
+    self:close(done)
+  end)
+
+  start = uv.hrtime()
+  async:send()
+end
+
+-- the same with pair of connected pipes as wakeup channel
+local function pipe_wakeups(done)
+  os.remove(PIPE_NAME)
+
+  local count, start, sender = 0
+
+  local server = uv.pipe():bind(PIPE_NAME, function(server, err)
+    assert(not err, tostring(err))
+  end)
+
+  server:listen(function(server, err)
+    assert(not err, tostring(err))
+    local receiver = server:accept()
+
+    receiver:start_read(function(receiver, err, data)
+      assert(not err, tostring(err))
+      count = count + #data
+      if count < NUM_WAKEUPS then
+        return sender:write("\0")
+      end
+      report("pipe", start, count)
+      sender:close()
+      receiver:close()
+      server:close(done)
+    end)
+
+    start = uv.hrtime()
+    sender:write("\0")
+  end)
+
+  sender = uv.pipe():connect(PIPE_NAME, function(cli, err)
+    assert(not err, tostring(err))
+  end)
+end
+
+-- many sends per iteration are coalesced into one callback
+local function async_coalesce()
+  local sends, calls = 0, 0
+  local start
+
+  local async = uv.async(function() calls = calls + 1 end)
+
+  uv.timer():start(0, 1, function(timer)
+    for i = 1, 1000 do async:send() end
+    sends = sends + 1000
+    if sends < NUM_WAKEUPS then return end
+    timer:close()
+    async:close(function()
+      local t = (uv.hrtime() - start) / 1e9
+      printf("%-14s %d sends in %.2f seconds, %d callbacks\n", "async burst", sends, t, calls)
+    end)
+  end)
+
+  start = uv.hrtime()
+end
+
+async_wakeups(function()
+  pipe_wakeups(function()
+    async_coalesce()
+  end)
+end)
+
+uv.run()
+
+os.remove(PIPE_NAME)
@@ -0,0 +1,39 @@
+local uv = require "lluv"
+
+local function printf(...) io.write(string.format(...)) end
+
+local NUM_HANDLES = 200000
+
+local function gc() for i = 1, 3 do collectgarbage("collect") end end
+
+local function handle_create(name, ctor)
+  local handles = {}
+
+  gc()
+  local mem_before = collectgarbage("count")
+  local start = uv.hrtime()
+
+  for i = 1, NUM_HANDLES do handles[i] = ctor() end
+
+  local t = (uv.hrtime() - start) / 1e9
+  gc()
+  local mem_after = collectgarbage("count")
+
+  -- registry lookup of handles without references from libuv
+  start = uv.hrtime()
+  local n = #uv.handles()
+  local t_lookup = (uv.hrtime() - start) / 1e9
+  assert(n == NUM_HANDLES)
+
+  -- memory of `handles` table itself is not counted
+  local bytes = (mem_after - mem_before) * 1024 / NUM_HANDLES - 16
+
+  printf("%-6s %d handles in %.2f seconds, %.0f handles/s, %.0f bytes/handle, uv.handles() %.2f seconds\n",
+    name, NUM_HANDLES, t, NUM_HANDLES / t, bytes, t_lookup)
+
+  for i = 1, NUM_HANDLES do handles[i]:close() end
+  uv.run()
+end
+
+handle_create("timer", uv.timer)
+handle_create("tcp",   uv.tcp)
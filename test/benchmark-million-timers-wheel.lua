@@ -0,0 +1,46 @@
+local uv = require "lluv"
+
+local function printf(...) io.write(string.format(...)) end
+
+local NUM_TIMERS = 5 * 1000 * 1000
+
+local timer_cb_called = 0
+
+local function timer_cb()
+  timer_cb_called = timer_cb_called + 1
+end
+
+local function million_timers()
+  local wheel = uv.timer_wheel(1)
+
+  local before_all
+  local before_run
+  local after_run
+  local after_all
+  local timeout = 0
+
+  before_all = uv.hrtime()
+  for i = 1, NUM_TIMERS do
+    if i % 1000 == 0 then timeout = timeout + 1 end
+    wheel:add(timeout, timer_cb)
+  end
+
+  before_run = uv.hrtime()
+  assert(0 == uv.run())
+  after_run = uv.hrtime()
+
+  wheel:close()
+
+  assert(0 == uv.run())
+  after_all = uv.hrtime();
+
+  assert(timer_cb_called == NUM_TIMERS);
+
+  printf("%.2f seconds total\n",    (after_all - before_all)  / 1e9)
+  printf("%.2f seconds init\n",     (before_run - before_all) / 1e9)
+  printf("%.2f seconds dispatch\n", (after_run - before_run)  / 1e9)
+  printf("%.2f seconds cleanup\n",  (after_all - after_run)   / 1e9)
+
+end
+
+million_timers()
@@ -16,7 +16,7 @@ local function pinger_new()
 local pinger
 
 local function pinger_close_cb(handle)
-  printf("ping_pongs: %d roundtrips/s\n", (1000 * pinger.pongs) / TIME)
+  printf("ping_pongs: %d roundtrips/s\n", math.floor((1000 * pinger.pongs) / TIME))
   pinger.complite = true
 end
 
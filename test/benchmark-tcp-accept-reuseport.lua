@@ -0,0 +1,79 @@
+local uv = require "lluv"
+local ut = require "lluv.utils"
+
+local function printf(...) io.write(string.format(...)) end
+
+-- Total number of connections for each test
+local NUM_CONNECTIONS = 20000
+
+-- Number of client threads and connections in flight per thread
+local CLIENTS, CONCURRENCY = 4, 50
+
+local function client(port, n, conc, done)
+  local uv = require "lluv"
+  local count, errors = 0, 0
+
+  local function connect()
+    if count >= n then return end
+    count = count + 1
+    uv.tcp():connect("127.0.0.1", port, function(cli, err)
+      if err then
+        errors = errors + 1
+        cli:close()
+        return connect()
+      end
+      cli:start_read(function(cli)
+        cli:close()
+        connect()
+      end)
+    end)
+  end
+
+  for i = 1, conc do connect() end
+
+  uv.run()
+
+  done:send(count, errors)
+end
+
+-- Single listener is an upper bound for one accept loop which hands off
+-- connections to other loops: handoff can only add cost.
+local function server(server)
+  server:listen(1024, function(server, err)
+    if err then return end
+    local cli = server:accept()
+    if cli then cli:close() end
+  end)
+end
+
+local function accept_rate(name, shards_count)
+  local shards = assert(ut.ListenShards.new(shards_count, "127.0.0.1", 0, server))
+  assert(not next(shards:errors()), "can not bind shard")
+
+  local finished, total, errors, start, threads = 0, 0, 0, nil, {}
+
+  local done = uv.channel(function(self, count, err)
+    finished, total, errors = finished + 1, total + count, errors + err
+    if finished < CLIENTS then return end
+
+    local t = (uv.hrtime() - start) / 1e9
+    printf("%-22s %d connections in %.2f seconds, %.0f conn/s (%d errors)\n",
+      name, total, t, total / t, errors)
+
+    self:close()
+  end)
+
+  start = uv.hrtime()
+  for i = 1, CLIENTS do
+    threads[i] = uv.thread(client, shards:port(), NUM_CONNECTIONS / CLIENTS,
+      CONCURRENCY, done)
+  end
+
+  uv.run()
+
+  for i = 1, CLIENTS do threads[i]:join() end
+  shards:stop():join()
+end
+
+accept_rate("single listener", 1)
+accept_rate("reuseport x" .. CLIENTS, CLIENTS)
@@ -0,0 +1,35 @@
+local uv = require "lluv"
+
+local function printf(...) io.write(string.format(...)) end
+
+-- Number of messages sent by each producer thread
+local NUM_MESSAGES = 200000
+
+local function channel_throughput(producers)
+  local received, threads, start = 0, {}
+
+  local chan = uv.channel(function(self)
+    received = received + 1
+    if received < producers * NUM_MESSAGES then return end
+
+    local t = (uv.hrtime() - start) / 1e9
+    printf("%d producer(s): %d messages in %.2f seconds, %.0f messages/s\n",
+      producers, received, t, received / t)
+
+    self:close()
+    for i = 1, producers do assert(threads[i]:join()) end
+  end)
+
+  start = uv.hrtime()
+  for i = 1, producers do
+    threads[i] = uv.thread(function(chan, n)
+      for i = 1, n do chan:send(i, "message") end
+    end, chan, NUM_MESSAGES)
+  end
+
+  uv.run()
+end
+
+channel_throughput(1)
+channel_throughput(2)
+channel_throughput(4)
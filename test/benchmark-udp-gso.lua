@@ -0,0 +1,68 @@
+local uv = require "lluv"
+
+local function printf(...) io.write(string.format(...)) end
+
+-- Run each case for this many ms
+local TIME = 3000
+
+local SEGMENT, SEGMENTS = 1200, 32
+
+local MESSAGE = string.rep("x", SEGMENT)
+
+local BUFFER = string.rep(MESSAGE, SEGMENTS)
+
+-- Sender and receiver share loop so we measure received bytes.
+local function run(name, opts, send)
+  local srv = assert(uv.udp():bind("127.0.0.1", 0))
+  local _, port = srv:getsockname()
+  local cli = assert(uv.udp():bind("127.0.0.1", 0))
+  local recv, calls, start = 0, 0
+
+  local function on_recv(self, err, data)
+    assert(not err, tostring(err))
+    recv, calls = recv + #data, calls + 1
+  end
+
+  if opts then srv:start_recv(opts, on_recv) else srv:start_recv(on_recv) end
+
+  uv.idle():start(function(idle)
+    if not start then start = uv.now() end
+
+    send(cli, port)
+
+    if uv.now() - start > TIME then
+      idle:close()
+      cli:close()
+      srv:close()
+    end
+  end)
+
+  uv.run()
+
+  local elapsed = (uv.now() - start) / 1000
+  printf("%-24s: %8.2f MB/s %10d callbacks/s\n", name,
+    recv / elapsed / (1024 * 1024), math.floor(calls / elapsed)
+  )
+end
+
+run("try_send", nil, function(cli, port)
+  for i = 1, SEGMENTS do
+    cli:try_send("127.0.0.1", port, MESSAGE)
+  end
+end)
+
+local probe = uv.udp():bind("127.0.0.1", 0)
+local ok, err = probe:set_gso(0)
+probe:close() uv.run()
+
+if not ok then
+  return printf("GSO not supported: %s\n", tostring(err))
+end
+
+run("try_send_gso", nil, function(cli, port)
+  cli:try_send_gso("127.0.0.1", port, BUFFER, SEGMENT)
+end)
+
+run("try_send_gso + gro", {gro = true}, function(cli, port)
+  cli:try_send_gso("127.0.0.1", port, BUFFER, SEGMENT)
+end)
@@ -0,0 +1,76 @@
+local uv = require "lluv"
+
+local function printf(...) io.write(string.format(...)) end
+
+-- Number of rounds. Each round fills socket receive buffer
+-- and measures time to drain it.
+local ROUNDS = 2000
+
+local BURST  = 100
+
+local MESSAGE = "<34>1 2003-10-11T22:14:15.003Z mymachine.example.com su - ID47 - BOM'su root' failed"
+
+local function run(name, flags, opts)
+  local server = assert(uv.udp(flags):bind("127.0.0.1", 0))
+  local _, port = server:getsockname()
+  local cli = assert(uv.udp())
+
+  local round, received, expected, elapsed, total, start = 0, 0, 0, 0, 0
+
+  local function next_round()
+    round = round + 1
+    if round > ROUNDS then
+      server:close()
+      cli:close()
+      return
+    end
+
+    received, expected = 0, 0
+    for i = 1, BURST do
+      if not cli:try_send("127.0.0.1", port, MESSAGE) then break end
+      expected = expected + 1
+    end
+    start = uv.hrtime()
+  end
+
+  local function on_done()
+    elapsed = elapsed + (uv.hrtime() - start)
+    total   = total + received
+    next_round()
+  end
+
+  if opts and opts.batch then
+    server:start_recv(opts, function(self, err, datas, hosts, ports, n)
+      assert(not err, tostring(err))
+      received = received + n
+      if received == expected then on_done() end
+    end)
+  else
+    server:start_recv(opts or {}, function(self, err, data, flags, host, port)
+      assert(not err, tostring(err))
+      received = received + 1
+      if received == expected then on_done() end
+    end)
+  end
+
+  uv.timer():start(0, function(timer)
+    timer:close()
+    next_round()
+  end)
+
+  uv.run()
+
+  printf("%-20s: %d datagrams/s\n", name, math.floor(total / (elapsed / 1e9)))
+end
+
+run("recv",          nil, nil)
+run("recv sockaddr",  nil, {addr = "sockaddr"})
+run("recv interned",  nil, {addr = "interned"})
+run("recv binary",    nil, {addr = "binary"})
+run("recv batch",    nil, {batch = true})
+run("recv batch interned", nil, {batch = true, addr = "interned"})
+
+if uv.UDP_RECVMMSG then
+  run("recvmmsg",       "recvmmsg", nil)
+  run("recvmmsg batch", "recvmmsg", {batch = true})
+end
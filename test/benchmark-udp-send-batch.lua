@@ -0,0 +1,70 @@
+local uv = require "lluv"
+
+local function printf(...) io.write(string.format(...)) end
+
+local NUM_DGRAMS = 1000 * 1000
+
+local BATCH = 64
+
+local MESSAGE = "<34>1 2003-10-11T22:14:15.003Z mymachine.example.com su - ID47 - BOM'su root' failed"
+
+-- datagrams are dropped by receiver. We measure only send side.
+local sink = assert(uv.udp():bind("127.0.0.1", 0))
+local _, port = sink:getsockname()
+
+local function run(name, send)
+  local cli = uv.udp()
+  local sent, start = 0
+
+  uv.idle():start(function(idle)
+    if not start then start = uv.hrtime() end
+
+    sent = sent + send(cli)
+
+    if sent >= NUM_DGRAMS then
+      idle:close()
+      cli:close()
+    end
+  end)
+
+  uv.run()
+
+  local elapsed = (uv.hrtime() - start) / 1e9
+  printf("%-20s: %d datagrams/s\n", name, math.floor(sent / elapsed))
+end
+
+run("send", function(cli)
+  for i = 1, BATCH do
+    cli:send("127.0.0.1", port, MESSAGE)
+  end
+  return BATCH
+end)
+
+run("try_send", function(cli)
+  for i = 1, BATCH do
+    cli:try_send("127.0.0.1", port, MESSAGE)
+  end
+  return BATCH
+end)
+
+local addr = uv.sockaddr("127.0.0.1", port)
+
+run("try_send sockaddr", function(cli)
+  for i = 1, BATCH do
+    cli:try_send(addr, MESSAGE)
+  end
+  return BATCH
+end)
+
+local list = {}
+for i = 1, BATCH do
+  list[i] = {MESSAGE, "127.0.0.1", port}
+end
+
+run("send_batch", function(cli)
+  cli:send_batch(list)
+  return BATCH
+end)
+
+sink:close()
+uv.run()
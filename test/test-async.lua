@@ -0,0 +1,58 @@
+local uv = require "lluv"
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+-- several sends before loop iteration coalesce into one callback
+local called, rounds = 0, 0
+
+local async; async = uv.async(function(self)
+  assert(self == async)
+  called = called + 1
+  rounds = rounds + 1
+  if rounds < 3 then
+    self:send():send():send()
+    return
+  end
+  self:close()
+  TIMER:close()
+end)
+
+assert(async:active())
+
+async:send()
+async:send()
+assert(called == 0, "callback called synchronously")
+
+local ptr, api = async:pointer()
+assert(type(ptr) == "userdata")
+assert(type(api) == "userdata")
+
+uv.run()
+
+assert(called == 3, "invalid number of calls: " .. called)
+assert(async:closed())
+
+-- unref'ed handle does not keep loop alive
+local idle = uv.async(function() end):unref()
+uv.run()
+assert(not idle:closed())
+idle:close()
+uv.run()
+
+-- with explicit loop
+local loop = uv.loop()
+local loop_called = false
+uv.async(loop, function(self)
+  assert(self:loop() == loop)
+  loop_called = true
+  self:close()
+end):send()
+loop:run()
+loop:close()
+assert(loop_called)
+
+assert(not pcall(uv.async))
+
+print("Done!")
@@ -0,0 +1,48 @@
+local uv = require "lluv"
+
+local loop = uv.default_loop()
+
+local stats = loop:buffer_stats()
+assert(stats.in_use == 0)
+assert(stats.limit  == loop:buffer_pool_limit())
+
+local N, counter = 10, 0
+
+local cli
+
+uv.udp():bind("127.0.0.1", 0, function(server, err)
+  assert(not err, tostring(err))
+
+  local host, port = server:getsockname()
+
+  server:start_recv(function(self, err, data)
+    assert(not err, tostring(err))
+    assert(data == "hello")
+    counter = counter + 1
+    if counter == N then
+      self:close()
+      cli:close()
+    end
+  end)
+
+  cli = uv.udp()
+  for i = 1, N do cli:send(host, port, "hello") end
+end)
+
+uv.run()
+
+assert(counter == N)
+
+stats = loop:buffer_stats()
+assert(stats.in_use   == 0)
+assert(stats.retained  > 0)
+assert(stats.reuses    > 0)
+assert(stats.allocs    < N)
+assert(stats.retained == stats.free * 65536)
+
+loop:buffer_pool_limit(0)
+stats = loop:buffer_stats()
+assert(stats.limit    == 0)
+assert(stats.retained == 0)
+
+print("Done!")
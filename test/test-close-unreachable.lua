@@ -0,0 +1,80 @@
+local uv = require "lluv"
+
+local loop = uv.default_loop()
+
+local function gc_sentinel(fn)
+  if newproxy then
+    local p = newproxy(true)
+    getmetatable(p).__gc = fn
+    return p
+  end
+  return setmetatable({}, {__gc = fn})
+end
+
+-- Create handle and make it unreachable but do not run its finalizer.
+-- Object created later finalized first so one collect step finalizes
+-- only sentinel and handle still waits its finalizer.
+local function unreachable_handle(probe)
+  local finalized = false
+
+  do
+    local cli = uv.tcp()
+    local on_full = function() end
+    cli:set_write_watermarks(1024, 512, on_full)
+    probe[#probe + 1], probe[#probe + 2] = cli, on_full
+    gc_sentinel(function() finalized = true end)
+  end
+
+  repeat collectgarbage("step", 0) until finalized
+end
+
+local function count_handles()
+  local n = 0
+  loop:handles(function() n = n + 1 end)
+  return n
+end
+
+collectgarbage("stop")
+
+-- handle closed by loop before its finalizer
+local probe = setmetatable({}, {__mode = "v"})
+unreachable_handle(probe)
+assert(probe[1] == nil)
+assert(count_handles() == 0)
+
+loop:close_all_handles()
+
+collectgarbage("restart")
+collectgarbage()
+collectgarbage()
+
+-- close callback released handle callbacks
+assert(probe[2] == nil, "handle was not cleaned up")
+
+-- finalizer called while handle is closing
+collectgarbage("stop")
+
+probe = setmetatable({}, {__mode = "v"})
+unreachable_handle(probe)
+
+local server = assert(uv.udp():bind("127.0.0.1", 0))
+local _, port = server:getsockname()
+
+-- send callbacks called when udp handle closed after tcp one
+local called = false
+uv.udp():send("127.0.0.1", port, "hello", function()
+  called = true
+  for i = 1, 10 do collectgarbage("step", 0) end
+end)
+
+loop:close_all_handles()
+
+collectgarbage("restart")
+collectgarbage()
+collectgarbage()
+
+assert(called)
+assert(probe[2] == nil, "handle was not cleaned up")
+assert(count_handles() == 0)
+
+print("Done!")
@@ -0,0 +1,107 @@
+local uv = require "lluv"
+
+local N      = 100
+local PASS   = false
+local chunks = {}
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+local function expected()
+  local t = {"HEADER"}
+  for i = 1, N do t[#t + 1] = tostring(i) .. ";" end
+  t[#t + 1] = "FOOTER"
+  return table.concat(t)
+end
+
+local function on_read(cli, err, data)
+  if err then
+    if err:name() ~= 'EOF' then
+      io.stderr:write("Can not read data:", tostring(err), "\n")
+    end
+    PASS = (table.concat(chunks) == expected())
+    TIMER:close()
+    return cli:close()
+  end
+
+  chunks[#chunks + 1] = data
+end
+
+local function on_connection(server, err)
+  if err then
+    io.stderr:write("Can not listen on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  server:accept():start_read(on_read)
+  server:close()
+end
+
+local last, called = 0, 0
+
+local function on_write(cli, err, i)
+  assert(not err, tostring(err))
+  assert(i > last, "write callbacks out of order")
+  last, called = i, called + 1
+end
+
+uv.tcp():bind("127.0.0.1", 0, function(server, err)
+  if err then
+    io.stderr:write("Can not bind on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  local host, port = server:getsockname()
+
+  server:listen(on_connection)
+
+  uv.tcp():connect(host, port, function(cli, err)
+    if err then
+      io.stderr:write("Can not connect to server:", tostring(err), "\n")
+      return cli:close()
+    end
+
+    -- explicit cork
+    cli:cork()
+    cli:write("HEAD")
+    cli:write{"E", "R"}
+    assert(cli:get_write_queue_size() == 0)
+    cli:uncork()
+
+    -- writes from same loop iteration gathered in one request
+    cli:set_auto_cork(true)
+    for i = 1, N do
+      if i % 2 == 0 then
+        cli:write(tostring(i) .. ";", on_write, i)
+      else
+        cli:write(tostring(i) .. ";")
+      end
+    end
+    assert(cli:get_write_queue_size() == 0)
+    assert(called == 0)
+
+    -- internal loop handles are not visible
+    for _, h in ipairs(uv.handles()) do
+      assert(h:loop() == uv.default_loop())
+    end
+
+    uv.timer():start(10, function(self)
+      self:close()
+      assert(called == N / 2)
+      cli:set_auto_cork(false)
+      cli:write("FOOTER")
+      cli:shutdown(function() cli:close() end)
+    end)
+  end)
+end)
+
+uv.run()
+
+-- loop with internal handles can be closed
+local _, err = uv.default_loop():close()
+assert(not err, tostring(err))
+
+if not PASS then os.exit(1) end
+
+print("Done!")
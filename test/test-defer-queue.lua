@@ -0,0 +1,46 @@
+local uv = require "lluv"
+
+-- order and arguments
+local calls = {}
+for i = 1, 10000 do
+  if i % 3 == 0 then
+    uv.defer(function(a, b, c, d) calls[#calls + 1] = {a, b, c, d} end, i, nil, "x", nil)
+  else
+    uv.defer(function(...) calls[#calls + 1] = {...} end, i)
+  end
+end
+
+uv.run()
+
+assert(#calls == 10000, "invalid number of calls: " .. #calls)
+for i, args in ipairs(calls) do
+  assert(args[1] == i, "invalid order")
+  if i % 3 == 0 then
+    assert(args[2] == nil and args[3] == "x" and args[4] == nil)
+  end
+end
+
+-- without arguments and with many arguments
+local n
+uv.defer(function() n = select('#') end)
+uv.defer(function(...) n = n + select('#', ...) end, (string.byte(string.rep("a", 100), 1, -1)))
+uv.defer(function(...) n = n + select('#', ...) end, string.byte(string.rep("a", 100), 1, -1))
+uv.run()
+assert(n == 101, n)
+
+-- deferred calls from deferred calls
+local order = {}
+uv.defer(function()
+  order[#order + 1] = 1
+  uv.defer(function() order[#order + 1] = 3 end)
+end)
+uv.defer(function() order[#order + 1] = 2 end)
+uv.run()
+assert(table.concat(order) == "123", table.concat(order))
+
+-- error in deferred function stops loop
+uv.defer(function() error("some error") end)
+local ok, err = pcall(uv.run)
+assert(not ok and string.find(tostring(err), "some error"), tostring(err))
+
+print("Done!")
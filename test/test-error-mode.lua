@@ -0,0 +1,81 @@
+local uv = require "lluv"
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+local N = 4
+
+local errors, numbers = {}, {}
+
+local server = assert(uv.tcp():bind("127.0.0.1", 0))
+local _, port = server:getsockname()
+
+server:listen(function(server, err)
+  assert(not err, tostring(err))
+  local cli = server:accept()
+  cli:close()
+end)
+
+local function connect(mode, result)
+  local cli = uv.tcp()
+  assert(cli:error_mode() == "object")
+  assert(cli:error_mode(mode) == cli)
+  assert(cli:error_mode() == mode)
+
+  cli:connect("127.0.0.1", port, function(cli, err)
+    assert(not err, tostring(err))
+    cli:start_read(function(cli, err, data)
+      if err then
+        result[#result + 1] = err
+        cli:close()
+        if #errors == N and #numbers == N then
+          server:close()
+          TIMER:close()
+        end
+      end
+    end)
+  end)
+end
+
+for i = 1, N do
+  connect("object", errors)
+  connect("number", numbers)
+end
+
+uv.run()
+
+assert(#errors == N and #numbers == N)
+
+-- errors without ext are shared objects
+for i = 1, N do
+  assert(type(errors[i]) == "userdata")
+  assert(errors[i]:name() == "EOF", tostring(errors[i]))
+  assert(rawequal(errors[1], errors[i]))
+end
+
+for i = 1, N do
+  assert(numbers[i] == uv.EOF, tostring(numbers[i]))
+end
+
+-- user created errors are never shared
+local e1, e2 = uv.error("LIBUV", uv.EOF), uv.error("LIBUV", uv.EOF)
+assert(not rawequal(e1, e2))
+assert(e1 == e2)
+assert(e1 == errors[1])
+
+-- ext is preserved
+local _, err = uv.tcp():bind("invalid", 0)
+assert(err and err:ext() ~= "")
+
+-- library errors report own category name
+local e = uv.error("LLUV", 1)
+assert(e:category() == "LLUV", tostring(e:category()))
+assert(string.find(tostring(e), "[LLUV]", 1, true), tostring(e))
+
+local h = uv.timer()
+assert(not pcall(h.error_mode, h, "unknown"))
+h:close()
+uv.run()
+
+print("Done!")
@@ -0,0 +1,91 @@
+local uv = require "lluv"
+
+local SIZE      = 16 * 1024 * 1024
+local HIGH, LOW = 1024 * 1024, 64 * 1024
+local DATA      = string.rep("x", SIZE)
+local events    = {}
+local received  = 0
+local result
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+-- first connection is source and second one is destination
+local conns = {}
+
+local function start_pipe()
+  local src, dst = conns[1], conns[2]
+
+  dst:set_write_watermarks(HIGH, LOW, function(self)
+    assert(self == dst)
+    events[#events + 1] = "full"
+  end, function(self)
+    assert(self == dst)
+    events[#events + 1] = "drain"
+  end)
+
+  src:pipe_to(dst, {limit = 4 * HIGH}, function(self, err, nread, nwritten)
+    result = {err, nread, nwritten}
+    self:close()
+    dst:shutdown(function() dst:close() end)
+  end)
+end
+
+local function on_connection(server, err)
+  if err then
+    io.stderr:write("Can not listen on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  conns[#conns + 1] = server:accept()
+  if #conns == 2 then
+    server:close()
+    start_pipe()
+  end
+end
+
+uv.tcp():bind("127.0.0.1", 0, function(server, err)
+  if err then
+    io.stderr:write("Can not bind on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  local host, port = server:getsockname()
+
+  server:listen(on_connection)
+
+  uv.tcp():connect(host, port, function(cli, err)
+    assert(not err, tostring(err))
+
+    -- destination peer starts read later so pipe queue grows
+    uv.tcp():connect(host, port, function(sink, err)
+      assert(not err, tostring(err))
+      uv.timer():start(300, function(self)
+        self:close()
+        sink:start_read(function(sink, err, data)
+          if err then
+            TIMER:close()
+            return sink:close()
+          end
+          received = received + #data
+        end)
+      end)
+    end)
+
+    cli:write(DATA)
+    cli:shutdown(function() cli:close() end)
+  end)
+end)
+
+uv.run()
+
+assert(result, "pipe callback not called")
+assert(result[1] == nil, tostring(result[1]))
+assert(result[3] == SIZE)
+assert(received == SIZE, received)
+
+assert(events[1] == "full" and events[2] == "drain", table.concat(events, ","))
+for i = 2, #events do assert(events[i] ~= events[i - 1]) end
+
+print("Done!")
@@ -0,0 +1,84 @@
+local uv = require "lluv"
+
+local SIZE   = 4 * 1024 * 1024
+local DATA   = string.rep("0123456789abcdef", SIZE / 16)
+local PASS   = false
+local chunks = {}
+local result
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+local function on_connection(server, err)
+  if err then
+    io.stderr:write("Can not listen on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  -- echo server
+  local cli = server:accept()
+  server:close()
+
+  cli:pipe_to(cli, {limit = 64 * 1024}, function(self, err, nread, nwritten)
+    assert(self == cli)
+    result = {err, nread, nwritten}
+    self:close()
+  end)
+
+  -- pipe already active
+  local _, err = cli:pipe_to(cli)
+  assert(err and err:name() == "EBUSY", tostring(err))
+
+  -- can not read stream while pipe active
+  local _, err = cli:start_read(print)
+  assert(err and err:name() == "EBUSY", tostring(err))
+  _, err = cli:start_read({frame = "line"}, print)
+  assert(err and err:name() == "EBUSY", tostring(err))
+  _, err = cli:start_read({batch = 16}, print)
+  assert(err and err:name() == "EBUSY", tostring(err))
+end
+
+uv.tcp():bind("127.0.0.1", 0, function(server, err)
+  if err then
+    io.stderr:write("Can not bind on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  local host, port = server:getsockname()
+
+  server:listen(on_connection)
+
+  uv.tcp():connect(host, port, function(cli, err)
+    if err then
+      io.stderr:write("Can not connect to server:", tostring(err), "\n")
+      return cli:close()
+    end
+
+    cli:start_read(function(cli, err, data)
+      if err then
+        if err:name() ~= 'EOF' then
+          io.stderr:write("Can not read data:", tostring(err), "\n")
+        end
+        PASS = (table.concat(chunks) == DATA)
+        TIMER:close()
+        return cli:close()
+      end
+      chunks[#chunks + 1] = data
+    end)
+
+    cli:write(DATA)
+    cli:shutdown()
+  end)
+end)
+
+uv.run()
+
+assert(result, "pipe callback not called")
+assert(result[1] == nil, tostring(result[1]))
+assert(result[2] == SIZE)
+assert(result[3] == SIZE)
+
+if not PASS then os.exit(1) end
+
+print("Done!")
@@ -0,0 +1,75 @@
+local uv = require "lluv"
+
+local results = {}
+
+uv.queue_work("local a, b = ... return a + b, {x = a, y = {b, 'str', true}}", 1, 2.5, function(loop, err, sum, t)
+  assert(not err, tostring(err))
+  assert(sum == 3.5)
+  assert(t.x == 1 and t.y[1] == 2.5 and t.y[2] == 'str' and t.y[3] == true)
+  results.args = true
+end)
+
+-- same code reused by many jobs
+local N, done = 50, 0
+for i = 1, N do
+  uv.queue_work(function(n)
+    local s = 0
+    for j = 1, n do s = s + j end
+    return s
+  end, i * 1000, function(loop, err, s)
+    assert(not err, tostring(err))
+    assert(s == (i * 1000) * (i * 1000 + 1) / 2)
+    done = done + 1
+  end)
+end
+
+-- no results
+uv.queue_work("return", function(loop, err, ...)
+  assert(not err, tostring(err))
+  assert(select('#', ...) == 0)
+  results.empty = true
+end)
+
+-- nil values preserved
+uv.queue_work("return ...", nil, 1, nil, function(loop, err, ...)
+  assert(not err, tostring(err))
+  local n, a, b, c = select('#', ...), ...
+  assert(n == 3 and a == nil and b == 1 and c == nil)
+  results.nils = true
+end)
+
+-- runtime error
+uv.queue_work("error('some error')", function(loop, err)
+  assert(err and string.find(err:ext(), 'some error', 1, true), tostring(err))
+  results.runtime = true
+end)
+
+-- syntax error
+uv.queue_work("return +", function(loop, err)
+  assert(err, "error expected")
+  results.syntax = true
+end)
+
+-- unsupported result
+uv.queue_work("return print", function(loop, err)
+  assert(err, "error expected")
+  results.result = true
+end)
+
+-- unsupported argument
+assert(not pcall(uv.queue_work, "return", print, function() end))
+
+-- callback never called synchronously
+local called = false
+uv.queue_work("return 1", function() called = true end)
+assert(not called)
+
+uv.run()
+
+assert(done == N, "done: " .. done)
+assert(called)
+for _, name in ipairs{"args", "empty", "nils", "runtime", "syntax", "result"} do
+  assert(results[name], name .. " callback not called")
+end
+
+print("Done!")
@@ -0,0 +1,107 @@
+local uv = require "lluv"
+
+local SIZE = 1024 * 1024
+local DATA = string.rep("0123456789abcdef", SIZE / 16)
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+local results = {}
+
+local function run_case(mode, port, done)
+  local chunks, calls = {}, 0
+  local result = {}
+  results[mode] = result
+
+  uv.tcp():connect("127.0.0.1", port, function(cli, err)
+    if err then
+      io.stderr:write("Can not connect to server:", tostring(err), "\n")
+      return cli:close()
+    end
+
+    local on_read
+
+    on_read = function(cli, err, data)
+      if err then
+        result.error = err:name()
+        result.data  = table.concat(chunks)
+        result.calls = calls
+        cli:close()
+        return done()
+      end
+
+      calls = calls + 1
+      if mode == "array" then
+        assert(type(data) == "table" and #data > 0)
+        for _, chunk in ipairs(data) do
+          assert(type(chunk) == "string")
+          chunks[#chunks + 1] = chunk
+        end
+      else
+        assert(type(data) == "string")
+        chunks[#chunks + 1] = data
+      end
+
+      -- pause reading, buffered data should be delivered after restart
+      if calls == 1 then
+        cli:stop_read()
+        uv.timer():start(50, function(timer)
+          timer:close()
+          cli:start_read({batch = mode}, on_read)
+        end)
+      end
+    end
+
+    cli:start_read({batch = mode}, on_read)
+  end)
+end
+
+local function on_connection(server, err)
+  if err then
+    io.stderr:write("Can not listen on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  local cli = server:accept()
+  for i = 1, SIZE, 1024 do
+    cli:write(DATA:sub(i, i + 1023))
+  end
+  cli:shutdown(function() cli:close() end)
+end
+
+uv.tcp():bind("127.0.0.1", 0, function(server, err)
+  if err then
+    io.stderr:write("Can not bind on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  local _, port = server:getsockname()
+
+  server:listen(on_connection)
+
+  run_case("string", port, function()
+    run_case("array", port, function()
+      server:close()
+      TIMER:close()
+    end)
+  end)
+end)
+
+uv.run()
+
+for _, mode in ipairs{"string", "array"} do
+  local result = results[mode]
+  assert(result and result.error == "EOF", mode .. ": " .. tostring(result and result.error))
+  assert(result.data == DATA, mode .. ": invalid data")
+  assert(result.calls >= 1)
+end
+
+-- invalid options
+local s = uv.tcp()
+assert(not pcall(s.start_read, s, {batch = "unknown"}, print))
+assert(not pcall(s.start_read, s, {batch = "array", frame = "line"}, print))
+s:close()
+uv.run()
+
+print("Done!")
@@ -0,0 +1,63 @@
+local uv = require "lluv"
+
+local PASS   = false
+local buffer = uv.buffer(4096)
+local chunks = {}
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+local function on_read(cli, err, buf, offset, nread)
+  assert(buf == buffer)
+  assert(offset == 16)
+
+  if err then
+    assert(nread == 0)
+    if err:name() ~= 'EOF' then
+      io.stderr:write("Can not read data:", tostring(err), "\n")
+    end
+    PASS = (table.concat(chunks) == "HELLO, WORLD!!!")
+    TIMER:close()
+    return cli:close()
+  end
+
+  chunks[#chunks + 1] = buf:to_s(offset, nread)
+end
+
+local function on_connection(server, err)
+  if err then
+    io.stderr:write("Can not listen on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  server:accept():start_read(buffer, 16, on_read)
+  server:close()
+end
+
+uv.tcp():bind("127.0.0.1", 0, function(server, err)
+  if err then
+    io.stderr:write("Can not bind on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  local host, port = server:getsockname()
+
+  server:listen(on_connection)
+
+  uv.tcp():connect(host, port, function(cli, err)
+    if err then
+      io.stderr:write("Can not connect to server:", tostring(err), "\n")
+      return cli:close()
+    end
+
+    cli:write{"HELLO", ", ", "WORLD", "!!!"}
+    cli:close()
+  end)
+end)
+
+uv.run()
+
+if not PASS then os.exit(1) end
+
+print("Done!")
@@ -0,0 +1,174 @@
+local uv = require "lluv"
+
+local function u16be(s)
+  return string.char(math.floor(#s / 256), #s % 256) .. s
+end
+
+local function u32be(s)
+  local n = #s
+  return string.char(
+    math.floor(n / 16777216) % 256, math.floor(n / 65536) % 256,
+    math.floor(n / 256) % 256, n % 256
+  ) .. s
+end
+
+local function varint(s)
+  local n, t = #s, {}
+  repeat
+    local b = n % 128
+    n = math.floor(n / 128)
+    if n > 0 then b = b + 128 end
+    t[#t + 1] = string.char(b)
+  until n == 0
+  return table.concat(t) .. s
+end
+
+local BIG = string.rep("x", 300)
+
+local CASES = {
+  { opts  = {frame = "line", eol = "\r\n"},
+    parts = {"hello\r", "\nworld", "\r\n\r\n", "tail"},
+    expect = {"hello", "world", ""}, rest = "tail",
+  },
+  { opts  = {frame = "line"},
+    parts = {"a\nb", "\nc\n"},
+    expect = {"a", "b", "c"},
+  },
+  { opts  = {frame = "u16be"},
+    parts = {u16be("one") .. u16be(""):sub(1, 1), u16be(""):sub(2) .. u16be(BIG)},
+    expect = {"one", "", BIG},
+  },
+  { opts  = {frame = "u32be"},
+    parts = {u32be("hello"):sub(1, 3), u32be("hello"):sub(4) .. u32be(BIG)},
+    expect = {"hello", BIG},
+  },
+  { opts  = {frame = "varint"},
+    parts = {varint("abc") .. varint(BIG):sub(1, 1), varint(BIG):sub(2)},
+    expect = {"abc", BIG},
+  },
+  { opts  = {frame = "fixed", size = 4},
+    parts = {"abcde", "fgh", "ij"},
+    expect = {"abcd", "efgh"}, rest = "ij",
+  },
+  { opts  = {frame = "line", max = 8},
+    parts = {"short\n", "very long line\n"},
+    expect = {"short"}, error = "EMSGSIZE", rest = "very long line\n",
+  },
+  { opts  = {frame = "u16be", max = 8},
+    parts = {u16be("123456789")},
+    expect = {}, error = "EMSGSIZE", rest = u16be("123456789"),
+  },
+  -- rest of data delivered after switch to plain read
+  { opts  = {frame = "line"}, switch = "plain",
+    parts = {"HDR\nBODY"},
+    expect = {"HDR", "BODY"},
+  },
+  { opts  = {frame = "line"}, switch = "fbuf",
+    parts = {"HDR\nBODY"},
+    expect = {"HDR", "BODY"},
+  },
+}
+
+local FBUF = uv.buffer(64)
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+local done = 0
+
+local function run_case(case, port)
+  case.result = {}
+
+  uv.tcp():connect("127.0.0.1", port, function(cli, err)
+    if err then
+      io.stderr:write("Can not connect to server:", tostring(err), "\n")
+      return cli:close()
+    end
+
+    local i = 0
+    uv.timer():start(0, 5, function(timer)
+      i = i + 1
+      if case.parts[i] then return cli:write(case.parts[i]) end
+      timer:close()
+      cli:shutdown()
+    end)
+  end)
+end
+
+local function on_connection(server, err)
+  if err then
+    io.stderr:write("Can not listen on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  local cli = server:accept()
+  local case = CASES[done + 1]
+  done = done + 1
+
+  local function on_read(cli, err, msg, offset, nread)
+    if msg == FBUF then
+      msg = (nread > 0) and FBUF:to_s(offset, nread) or nil
+    end
+
+    if err then
+      case.error_name = err:name()
+      case.rest_data  = msg
+      cli:close()
+      if done == #CASES then
+        server:close()
+        TIMER:close()
+      else
+        run_case(CASES[done + 1], select(2, server:getsockname()))
+      end
+      return
+    end
+    case.result[#case.result + 1] = msg
+
+    if case.switch == "plain" then
+      case.switch = nil
+      cli:stop_read():start_read(on_read)
+    elseif case.switch == "fbuf" then
+      case.switch = nil
+      cli:stop_read():start_read(FBUF, 8, on_read)
+    end
+  end
+
+  cli:start_read(case.opts, on_read)
+end
+
+uv.tcp():bind("127.0.0.1", 0, function(server, err)
+  if err then
+    io.stderr:write("Can not bind on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  local _, port = server:getsockname()
+
+  server:listen(on_connection)
+
+  run_case(CASES[1], port)
+end)
+
+uv.run()
+
+assert(done == #CASES, "not all cases done")
+
+for i, case in ipairs(CASES) do
+  assert(#case.result == #case.expect, "case #" .. i .. ": invalid number of messages: " .. #case.result)
+  for j, msg in ipairs(case.expect) do
+    assert(case.result[j] == msg, "case #" .. i .. ": invalid message #" .. j)
+  end
+  assert(case.error_name == (case.error or "EOF"), "case #" .. i .. ": " .. tostring(case.error_name))
+  assert(case.rest_data == case.rest, "case #" .. i .. ": invalid rest: " .. tostring(case.rest_data))
+end
+
+-- invalid options
+local s = uv.tcp()
+assert(not pcall(s.start_read, s, {frame = "unknown"}, print))
+assert(not pcall(s.start_read, s, {frame = "fixed"}, print))
+assert(not pcall(s.start_read, s, {frame = "line", eol = ""}, print))
+s:close()
+uv.run()
+
+print("Done!")
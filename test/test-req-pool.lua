@@ -0,0 +1,55 @@
+local uv = require "lluv"
+
+local loop = uv.default_loop()
+
+local stats = loop:req_stats()
+assert(stats.idle  == 0)
+assert(stats.limit  > 0)
+
+local N, counter, sent = 20, 0, 0
+
+local cli
+
+uv.udp():bind("127.0.0.1", 0, function(server, err)
+  assert(not err, tostring(err))
+
+  local host, port = server:getsockname()
+
+  server:start_recv(function(self, err, data)
+    assert(not err, tostring(err))
+    counter = counter + 1
+    if counter == 2 * N then
+      self:close()
+      cli:close()
+    end
+  end)
+
+  cli = uv.udp()
+
+  local function send(i)
+    if i > N then return end
+    -- request without callback does not touch registry
+    cli:send(host, port, "hello")
+    cli:send(host, port, "world", function(self, err, ctx)
+      assert(self == cli)
+      assert(not err, tostring(err))
+      assert(ctx == i)
+      sent = sent + 1
+      send(i + 1)
+    end, i)
+  end
+
+  send(1)
+end)
+
+uv.run()
+
+assert(counter == 2 * N)
+assert(sent    == N)
+
+stats = loop:req_stats()
+assert(stats.idle    > 0)
+assert(stats.reuses  > 0)
+assert(stats.allocs  < 2 * N)
+
+print("Done!")
@@ -0,0 +1,136 @@
+local uv = require "lluv"
+
+local FILE   = "./sendfile.tmp"
+local SIZE   = 8 * 1024 * 1024
+local OFFSET = 100
+local PASS   = false
+local BUSY
+local chunks = {}
+local result
+
+local DATA do
+  local t = {}
+  for i = 1, SIZE / 16 do t[i] = string.format("%015d\n", i) end
+  DATA = table.concat(t)
+end
+
+local f = assert(io.open(FILE, "wb"))
+f:write(DATA) f:close()
+
+local file = assert(uv.fs_open(FILE, "r"))
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+local function on_connection(server, err)
+  if err then
+    io.stderr:write("Can not listen on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  server:accept():start_read(function(cli, err, data)
+    if err then
+      if err:name() ~= 'EOF' then
+        io.stderr:write("Can not read data:", tostring(err), "\n")
+      end
+      PASS = (table.concat(chunks) == "HEADER" .. DATA:sub(OFFSET + 1))
+      TIMER:close()
+      return cli:close()
+    end
+    chunks[#chunks + 1] = data
+  end)
+  server:close()
+end
+
+uv.tcp():bind("127.0.0.1", 0, function(server, err)
+  if err then
+    io.stderr:write("Can not bind on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  local host, port = server:getsockname()
+
+  server:listen(on_connection)
+
+  uv.tcp():connect(host, port, function(cli, err)
+    if err then
+      io.stderr:write("Can not connect to server:", tostring(err), "\n")
+      return cli:close()
+    end
+
+    cli:write("HEADER")
+
+    -- length beyond end of file
+    cli:sendfile(file, OFFSET, SIZE, function(self, err, sent)
+      assert(self == cli)
+      result = {err, sent}
+      cli:shutdown(function() cli:close() end)
+    end)
+
+    -- socket is used by sendfile
+    local _, err = cli:write("X")
+    assert(err and err:name() == 'EBUSY', tostring(err))
+    _, err = cli:try_write("X")
+    assert(err and err:name() == 'EBUSY', tostring(err))
+    _, err = cli:sendfile(file, 0, 1)
+    assert(err and err:name() == 'EBUSY', tostring(err))
+    cli:write("X", function(self, err)
+      BUSY = err and err:name()
+    end)
+  end)
+end)
+
+uv.run()
+
+-- close stream while chunk is sent from thread pool.
+-- callback is not called for closed stream
+TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+uv.tcp():bind("127.0.0.1", 0, function(server, err)
+  assert(not err, tostring(err))
+
+  local host, port = server:getsockname()
+
+  server:listen(function(server)
+    server:accept():start_read(function(cli, err)
+      if err then cli:close() end
+    end)
+    server:close()
+  end)
+
+  uv.tcp():connect(host, port, function(cli, err)
+    assert(not err, tostring(err))
+
+    cli:sendfile(file, 0, SIZE)
+    cli:close()
+
+    -- may reuse descriptor number of closed socket
+    local tmp = assert(uv.fs_open(FILE .. ".2", "w"))
+    uv.timer():start(100, function(self)
+      self:close()
+      tmp:close()
+      TIMER:close()
+    end)
+  end)
+end)
+
+uv.run()
+
+file:close()
+os.remove(FILE)
+local tmp = assert(io.open(FILE .. ".2", "rb"))
+assert(tmp:read("*a") == "", "data written to reused descriptor")
+tmp:close()
+os.remove(FILE .. ".2")
+
+assert(result, "sendfile callback not called")
+assert(result[1] == nil, tostring(result[1]))
+assert(result[2] == SIZE - OFFSET)
+assert(BUSY == 'EBUSY', tostring(BUSY))
+
+if not PASS then os.exit(1) end
+
+print("Done!")
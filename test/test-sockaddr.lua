@@ -0,0 +1,126 @@
+local uv = require "lluv"
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+-- object
+local sa = assert(uv.sockaddr("127.0.0.1", 5555))
+assert(sa:host() == "127.0.0.1")
+assert(sa:port() == 5555)
+assert(sa:family() == "inet")
+assert(tostring(sa) == "127.0.0.1:5555", tostring(sa))
+local host, port = sa:unpack()
+assert(host == "127.0.0.1" and port == 5555)
+
+local sa6 = assert(uv.sockaddr("::1", 5555))
+assert(sa6:host() == "::1")
+assert(sa6:family() == "inet6")
+assert(tostring(sa6) == "[::1]:5555", tostring(sa6))
+
+assert(sa == uv.sockaddr("127.0.0.1", 5555))
+assert(sa ~= uv.sockaddr("127.0.0.1", 5556))
+assert(sa ~= sa6)
+assert(sa == uv.sockaddr(sa))
+assert(not rawequal(sa, uv.sockaddr(sa)))
+
+local _, err = uv.sockaddr("invalid", 0)
+assert(err)
+
+-- udp
+local server = assert(uv.udp():bind(uv.sockaddr("127.0.0.1", 0)))
+local server_addr = uv.sockaddr(server:getsockname())
+
+local cli = assert(uv.udp())
+local received = {}
+
+server:start_recv({addr = "sockaddr"}, function(self, err, data, flags, addr, port)
+  assert(not err, tostring(err))
+  assert(port == nil)
+  assert(addr:host() == "127.0.0.1")
+  assert(addr:port() == select(2, cli:getsockname()))
+  received[#received + 1] = data
+  if #received == 4 then
+    self:close()
+    cli:close()
+  end
+end)
+
+assert(cli:send(server_addr, "1", function(self, err)
+  assert(not err, tostring(err))
+  assert(cli:try_send(server_addr, "2"))
+  cli:send_batch({{"3", server_addr}, {"4", server_addr:unpack()}})
+end))
+
+uv.run()
+
+assert(table.concat(received) == "1234", table.concat(received))
+
+-- batch receive
+local server = assert(uv.udp():bind("127.0.0.1", 0))
+local server_addr = uv.sockaddr(server:getsockname())
+local cli = assert(uv.udp())
+local got
+
+server:start_recv({batch = true, addr = "sockaddr"}, function(self, err, datas, addrs, ports, n)
+  assert(not err, tostring(err))
+  assert(ports == nil)
+  for i = 1, n do
+    assert(addrs[i]:host() == "127.0.0.1")
+    assert(addrs[i]:port() == select(2, cli:getsockname()))
+  end
+  got = datas
+  self:close()
+  cli:close()
+end)
+
+cli:send(server_addr, "hello")
+
+uv.run()
+
+assert(got and got[1] == "hello")
+
+-- tcp
+local server = assert(uv.tcp():bind(uv.sockaddr("127.0.0.1", 0), function(self, err, host, port)
+  assert(not err, tostring(err))
+  assert(host == "127.0.0.1")
+end))
+local addr = uv.sockaddr(server:getsockname())
+local connected, accepted
+
+server:listen(function(self, err)
+  assert(not err, tostring(err))
+  self:accept():close()
+  accepted = true
+  self:close()
+end)
+
+uv.tcp():connect(addr, function(self, err)
+  assert(not err, tostring(err))
+  connected = true
+  self:close()
+end)
+
+uv.run()
+
+assert(connected and accepted)
+
+-- error message contains address
+local s1 = assert(uv.udp():bind("127.0.0.1", 0))
+local s2 = uv.udp()
+local _, err = s2:bind(uv.sockaddr(s1:getsockname()))
+assert(err and err:ext():find(tostring(uv.sockaddr(s1:getsockname())), 1, true), tostring(err))
+s1:close(); s2:close()
+
+-- getnameinfo
+uv.getnameinfo(uv.sockaddr("127.0.0.1", 80), function(loop, err, host, service)
+  assert(not err, tostring(err))
+  assert(host)
+end)
+
+uv.run()
+
+TIMER:close()
+uv.run()
+
+print("Done!")
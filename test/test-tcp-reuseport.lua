@@ -0,0 +1,75 @@
+local uv = require "lluv"
+local ut = require "lluv.utils"
+
+local s1, err = uv.tcp():bind("127.0.0.1", 0, {reuseport = true})
+if not s1 and err:name() == "ENOTSUP" then
+  io.stderr:write("SO_REUSEPORT not supported\n")
+  print("Done!")
+  return
+end
+assert(s1, tostring(err))
+
+local _, port = s1:getsockname()
+
+local s2 = assert(uv.tcp():bind("127.0.0.1", port, {reuseport = true}))
+local _, port2 = s2:getsockname()
+assert(port == port2)
+
+-- both sockets can listen
+assert(s1:listen(function() end))
+assert(s2:listen(function() end))
+
+-- socket without flag can not share port
+local s3_err
+uv.tcp():bind("127.0.0.1", port):listen(function(self, err)
+  s3_err = err
+  self:close()
+end)
+
+uv.run("once")
+assert(s3_err and s3_err:name() == "EADDRINUSE", tostring(s3_err))
+
+s1:close() s2:close()
+uv.run()
+
+-- shards in threads
+local N, M = 2, 20
+
+local shards = assert(ut.ListenShards.new(N, "127.0.0.1", 0, function(server, greeting)
+  server:listen(function(server, err)
+    if err then return end
+    local cli = server:accept()
+    cli:write(greeting)
+    cli:close()
+  end)
+end, "hello"))
+
+assert(shards:port() ~= 0)
+assert(not next(shards:errors()))
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+local replies = 0
+for i = 1, M do
+  uv.tcp():connect("127.0.0.1", shards:port(), function(cli, err)
+    assert(not err, tostring(err))
+    local data = {}
+    cli:start_read(function(cli, err, chunk)
+      if not err then data[#data + 1] = chunk return end
+      assert(table.concat(data) == "hello")
+      cli:close()
+      replies = replies + 1
+      if replies == M then TIMER:close() end
+    end)
+  end)
+end
+
+uv.run()
+
+shards:stop():join()
+
+assert(replies == M, "not all connections served: " .. replies)
+
+print("Done!")
@@ -0,0 +1,119 @@
+local uv = require "lluv"
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+-- results and arguments
+local t = uv.thread(function(a, b) return a + b, {a, b}, "str" end, 1, 2)
+local ok, sum, tab, str = t:join()
+assert(ok == true and sum == 3 and tab[1] == 1 and tab[2] == 2 and str == "str")
+assert(t:joined())
+
+-- error in thread
+t = uv.thread("error('some error')")
+local ok, err = t:join()
+assert(ok == nil)
+assert(err and string.find(tostring(err), 'some error', 1, true), tostring(err))
+
+-- many producers to one channel
+local N, M = 4, 1000
+local received, threads = {}, {}
+
+local chan = uv.channel(function(self, id, i)
+  received[id] = received[id] or 0
+  assert(received[id] + 1 == i, "invalid message order")
+  received[id] = i
+
+  for j = 1, N do if received[j] ~= M then return end end
+
+  self:close()
+  for j = 1, N do assert(threads[j]:join()) end
+end)
+
+for i = 1, N do
+  threads[i] = uv.thread(function(chan, id, m)
+    for i = 1, m do assert(chan:send(id, i)) end
+  end, chan, i, M)
+end
+
+uv.run()
+
+for i = 1, N do
+  assert(received[i] == M, "not all messages received")
+  assert(threads[i]:joined())
+end
+
+-- ping pong with thread loop
+local pongs = 0
+
+local peer
+local main = uv.channel(function(self, msg, sender)
+  if msg == "hello" then
+    peer = sender
+    return peer:send("ping")
+  end
+  assert(msg == "pong")
+  pongs = pongs + 1
+  if pongs < 100 then return peer:send("ping") end
+  peer:send("stop")
+  self:close()
+end)
+
+t = uv.thread(function(main)
+  local uv = require "lluv"
+  local pings = 0
+  local chan = uv.channel(function(self, msg)
+    if msg == "stop" then return self:close() end
+    assert(msg == "ping")
+    pings = pings + 1
+    main:send("pong")
+  end)
+  main:send("hello", chan)
+  uv.run()
+  return pings
+end, main)
+
+uv.run()
+
+local ok, pings = t:join()
+assert(ok and pings == 100, tostring(pings))
+assert(pongs == 100)
+assert(not peer:send("ping"), "send to closed channel")
+assert(peer:closed())
+
+-- collecting not joined thread does not wait for it
+local bye = false
+local detached = uv.channel(function(self, msg, sender)
+  if msg == "hello" then
+    -- thread still runs its loop
+    collectgarbage()
+    collectgarbage()
+    return sender:send("stop")
+  end
+  assert(msg == "bye")
+  bye = true
+  self:close()
+end)
+
+uv.thread(function(main)
+  local uv = require "lluv"
+  local chan = uv.channel(function(self, msg)
+    if msg == "stop" then return self:close() end
+  end)
+  main:send("hello", chan)
+  uv.run()
+  main:send("bye")
+end, detached)
+
+uv.run()
+
+assert(bye)
+
+-- not serializable argument
+assert(not pcall(uv.thread, "return", print))
+
+TIMER:close()
+uv.run()
+
+print("Done!")
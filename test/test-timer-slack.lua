@@ -0,0 +1,58 @@
+local uv = require "lluv"
+
+local start = uv.now()
+local fired = {}
+
+local function on_timer(name, min)
+  return function(timer)
+    fired[name] = uv.now() - start
+    assert(fired[name] >= min, name .. " fired early: " .. fired[name])
+    timer:close()
+  end
+end
+
+-- t1 and t2 coalesced (t1 window [100, 150], t2 window [120, 170])
+uv.timer():start(100, 0, {slack = 50}, on_timer("t1", 100))
+uv.timer():start(120, 0, {slack = 50}, on_timer("t2", 120))
+
+-- window [130, 140] does not contain 150
+uv.timer():start(130, 0, {slack = 10}, on_timer("t3", 130))
+
+-- leader stopped and closed, members should still fire
+local l1 = uv.timer():start(200, 0, {slack = 50}, function() error("stopped timer fired") end)
+uv.timer():start(220, 0, {slack = 50}, on_timer("m1", 220))
+local l2 = uv.timer():start(300, 0, {slack = 50}, function() error("closed timer fired") end)
+uv.timer():start(320, 0, {slack = 50}, on_timer("m2", 320))
+l1:stop() l1:close()
+l2:close()
+
+-- repeat
+local count = 0
+uv.timer():start(10, 20, {slack = 5}, function(timer)
+  count = count + 1
+  if count == 3 then
+    assert(timer:get_repeat() == 20)
+    timer:close()
+  end
+end)
+
+-- restart as regular timer
+local r = uv.timer():start(10, 0, {slack = 5}, function() error("restarted timer fired") end)
+r:start(20, on_timer("r", 20))
+
+uv.run()
+
+assert(fired.t1 and fired.t2 and fired.t3, "timers not fired")
+assert(fired.t1 == fired.t2, "timers not coalesced")
+assert(fired.t1 <= 150 + 50)
+assert(fired.t3 <= fired.t1, "t3 should fire before t1/t2")
+assert(fired.m1 and fired.m2 and fired.r)
+assert(count == 3)
+
+-- invalid slack
+local t = uv.timer()
+assert(not pcall(t.start, t, 10, 0, {slack = -1}, print))
+t:close()
+uv.run()
+
+print("Done!")
@@ -0,0 +1,71 @@
+local uv = require "lluv"
+
+local wheel = uv.timer_wheel(1)
+assert(wheel:resolution() == 1)
+assert(wheel:count() == 0)
+
+local start = uv.now()
+local fired, early = 0, 0
+local order = {}
+
+-- many timeouts which go through cascade
+local N = 20000
+for i = 1, N do
+  local ms = (i * 7919) % 1200
+  wheel:add(ms, function(expected)
+    fired = fired + 1
+    if uv.now() - start < expected then early = early + 1 end
+  end, ms)
+end
+
+-- arguments
+wheel:add(10, function(...)
+  order[#order + 1] = {select('#', ...), ...}
+end)
+wheel:add(10, function(...)
+  order[#order + 1] = {select('#', ...), ...}
+end, 1, nil, 3)
+
+-- cancel
+local canceled = wheel:add(5, function() error("canceled timeout called") end)
+assert(wheel:count() == N + 3)
+assert(wheel:cancel(canceled) == true)
+assert(wheel:cancel(canceled) == false)
+assert(wheel:count() == N + 2)
+
+-- add and cancel from callback
+local nested = false
+wheel:add(20, function()
+  local token = wheel:add(1, function() error("canceled timeout called") end)
+  wheel:add(1, function() nested = true end)
+  assert(wheel:cancel(token))
+end)
+
+uv.run()
+
+assert(fired == N, "fired: " .. fired)
+assert(early == 0, "early: " .. early)
+assert(nested)
+assert(wheel:count() == 0)
+
+assert(#order == 2)
+assert(order[1][1] == 0)
+assert(order[2][1] == 3 and order[2][2] == 1 and order[2][3] == nil and order[2][4] == 3)
+
+-- wheel does not keep loop alive after all timeouts done
+local wheel2 = uv.timer_wheel(uv.default_loop(), 50)
+assert(wheel2:resolution() == 50)
+local t0, t1 = uv.now()
+wheel2:add(120, function() t1 = uv.now() end)
+uv.run()
+assert(t1 and t1 - t0 >= 120, tostring(t1 and t1 - t0))
+
+-- closed wheel drops pending timeouts
+wheel2:add(10, function() error("timeout called after close") end)
+wheel2:close()
+wheel:close()
+uv.run()
+
+assert(not pcall(uv.timer_wheel, 0))
+
+print("Done!")
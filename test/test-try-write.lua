@@ -0,0 +1,90 @@
+local uv = require "lluv"
+
+local N      = 100
+local PASS   = false
+local chunks = {}
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+local function expected()
+  local t = {}
+  for i = 1, N do t[#t + 1] = tostring(i) .. ";" end
+  t[#t + 1] = string.rep("x", 4 * 1024 * 1024)
+  return table.concat(t)
+end
+
+local function on_read(cli, err, data)
+  if err then
+    if err:name() ~= 'EOF' then
+      io.stderr:write("Can not read data:", tostring(err), "\n")
+    end
+    PASS = (table.concat(chunks) == expected())
+    TIMER:close()
+    return cli:close()
+  end
+
+  chunks[#chunks + 1] = data
+end
+
+local function on_connection(server, err)
+  if err then
+    io.stderr:write("Can not listen on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  server:accept():start_read(on_read)
+  server:close()
+end
+
+local last, called = 0, 0
+
+local function on_write(cli, err, i)
+  assert(not err, tostring(err))
+  assert(i > last, "write callbacks out of order")
+  last, called = i, called + 1
+end
+
+uv.tcp():bind("127.0.0.1", 0, function(server, err)
+  if err then
+    io.stderr:write("Can not bind on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  local host, port = server:getsockname()
+
+  server:listen(on_connection)
+
+  uv.tcp():connect(host, port, function(cli, err)
+    if err then
+      io.stderr:write("Can not connect to server:", tostring(err), "\n")
+      return cli:close()
+    end
+
+    cli:set_try_write(true)
+
+    for i = 1, N do
+      if i % 2 == 0 then
+        cli:write(tostring(i) .. ";", on_write, i)
+      else
+        cli:write(tostring(i) .. ";")
+      end
+    end
+    -- callbacks never called from write itself
+    assert(called == 0)
+
+    -- tail which does not fit to socket buffer uses write request
+    cli:write(string.rep("x", 4 * 1024 * 1024), function(cli, err)
+      assert(not err, tostring(err))
+      assert(called == N / 2)
+      cli:shutdown(function() cli:close() end)
+    end)
+  end)
+end)
+
+uv.run()
+
+if not PASS then os.exit(1) end
+
+print("Done!")
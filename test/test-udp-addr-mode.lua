@@ -0,0 +1,93 @@
+local uv = require "lluv"
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+local N = 10
+
+local function run_case(host, opts, cb)
+  local server = assert(uv.udp():bind(host, 0))
+  local _, port = server:getsockname()
+  local cli = assert(uv.udp():bind(host, 0))
+  local _, cli_port = cli:getsockname()
+  local result = {}
+
+  local function on_recv(addr, port)
+    result[#result + 1] = {addr, port}
+    if #result == N then
+      server:close()
+      cli:close()
+      cb(result, cli_port)
+    end
+  end
+
+  if opts.batch then
+    server:start_recv(opts, function(self, err, datas, hosts, ports, n)
+      assert(not err, tostring(err))
+      for i = 1, n do on_recv(hosts[i], ports and ports[i]) end
+    end)
+  else
+    server:start_recv(opts, function(self, err, data, flags, host, port)
+      assert(not err, tostring(err))
+      on_recv(host, port)
+    end)
+  end
+
+  for i = 1, N do cli:send(host, port, "hello") end
+end
+
+local function check_interned(host)
+  return function(result, cli_port)
+    local addr = result[1][1]
+    assert(uv.sockaddr(host, cli_port) == addr)
+    assert(addr:host() == host and addr:port() == cli_port)
+    for i = 1, N do
+      assert(rawequal(result[i][1], addr), "not interned #" .. i)
+      assert(result[i][2] == nil)
+    end
+  end
+end
+
+local function check_binary(host, expected)
+  return function(result, cli_port)
+    for i = 1, N do
+      local bin, port = result[i][1], result[i][2]
+      assert(bin == expected, "invalid binary address #" .. i)
+      assert(port == cli_port)
+      assert(uv.sockaddr(bin, port) == uv.sockaddr(host, cli_port))
+      assert(uv.sockaddr(bin, port):host() == host)
+    end
+  end
+end
+
+run_case("127.0.0.1", {addr = "interned"},               check_interned("127.0.0.1"))
+run_case("127.0.0.1", {addr = "interned", batch = true}, check_interned("127.0.0.1"))
+run_case("127.0.0.1", {addr = "binary"},                 check_binary("127.0.0.1", 0x7F000001))
+run_case("127.0.0.1", {addr = "binary", batch = true},   check_binary("127.0.0.1", 0x7F000001))
+
+local s6 = uv.udp()
+local has_ipv6 = s6:bind("::1", 0) and true
+s6:close()
+
+if has_ipv6 then
+  local LOOPBACK6 = string.rep("\0", 15) .. "\1"
+  run_case("::1", {addr = "interned"}, check_interned("::1"))
+  run_case("::1", {addr = "binary"},   check_binary("::1", LOOPBACK6))
+end
+
+uv.run()
+
+-- binary IPv6 address which looks like text
+assert(uv.sockaddr("2001:db8::1:2:34", 1):host() == "2001:db8::1:2:34")
+local bin = "2a00:1450" .. string.rep("\0", 7)
+assert(uv.sockaddr(bin, 1):family() == "inet6")
+
+local s = uv.udp()
+assert(not pcall(s.start_recv, s, {addr = "unknown"}, print))
+s:close()
+
+TIMER:close()
+uv.run()
+
+print("Done!")
@@ -0,0 +1,114 @@
+local uv = require "lluv"
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+local SEGMENT, COUNT = 100, 10
+
+local function segments(n, size)
+  local t = {}
+  for i = 1, n do t[i] = string.rep(string.char(64 + i), size) end
+  return t
+end
+
+local DATA = table.concat(segments(COUNT, SEGMENT))
+
+local probe = assert(uv.udp():bind("127.0.0.1", 0))
+local ok, err = probe:set_gso(0)
+probe:close()
+
+if not ok then
+  assert(err:name() == "ENOTSUP" or err:name() == "ENOPROTOOPT", tostring(err))
+  print("GSO not supported: " .. tostring(err))
+  TIMER:close()
+  uv.run()
+  return print("Done!")
+end
+
+-- GSO send to regular receiver: kernel splits buffer to datagrams
+local plain = {}
+
+local receiver = assert(uv.udp():bind("127.0.0.1", 0))
+local _, rport = receiver:getsockname()
+
+local sender = assert(uv.udp():bind("127.0.0.1", 0))
+assert(sender:set_gso(SEGMENT) == sender)
+
+receiver:start_recv(function(self, err, data)
+  assert(not err, tostring(err))
+  plain[#plain + 1] = data
+  if #plain == COUNT then self:stop_recv() end
+end)
+
+assert(sender:send("127.0.0.1", rport, DATA))
+
+-- explicit segment size for one call
+local gro_data, gro_segment, gro_chunks = {}, {}, 0
+
+local gro_receiver = assert(uv.udp():bind("127.0.0.1", 0))
+local _, gport = gro_receiver:getsockname()
+
+gro_receiver:start_recv({gro = true}, function(self, err, data, flags, host, port, segment)
+  assert(not err, tostring(err))
+  assert(flags == 0)
+  assert(host == "127.0.0.1")
+  assert(type(port) == "number")
+  gro_data[#gro_data + 1] = data
+  gro_segment[#gro_segment + 1] = segment
+  gro_chunks = gro_chunks + #data
+  if gro_chunks == #DATA then self:stop_recv() end
+end)
+
+assert(sender:set_gso(0) == sender)
+assert(uv.timer():start(50, function(timer)
+  timer:close()
+  assert(sender:try_send_gso("127.0.0.1", gport, DATA, SEGMENT) == #DATA)
+end))
+
+uv.timer():start(500, function(timer)
+  timer:close()
+  receiver:close()
+  gro_receiver:close()
+  sender:close()
+  TIMER:close()
+end)
+
+uv.run(debug.traceback)
+
+assert(#plain == COUNT, "invalid number of datagrams: " .. #plain)
+for i, s in ipairs(segments(COUNT, SEGMENT)) do
+  assert(plain[i] == s, "invalid datagram #" .. i)
+end
+
+assert(table.concat(gro_data) == DATA, "invalid gro data")
+for i, data in ipairs(gro_data) do
+  assert(gro_segment[i] == math.min(SEGMENT, #data), "invalid segment size: " .. tostring(gro_segment[i]))
+end
+
+-- unbound handle bound on first send like with try_send
+local r = assert(uv.udp():bind("127.0.0.1", 0))
+local _, port = r:getsockname()
+local u = uv.udp()
+assert(u:try_send_gso("127.0.0.1", port, "hello", 0) == 5)
+assert(select(2, u:getsockname()) ~= 0)
+
+-- queued send requests can not be overtaken
+assert(u:send("127.0.0.1", port, "first"))
+local _, err = u:try_send_gso("127.0.0.1", port, "second", 0)
+assert(err and err:name() == "EAGAIN", tostring(err))
+r:close() u:close()
+uv.run()
+
+-- connected form and argument checks
+local a = assert(uv.udp():bind("127.0.0.1", 0))
+local b = assert(uv.udp():bind("127.0.0.1", 0))
+assert(a:connect(b:getsockname()))
+assert(a:try_send_gso("hello", 0) == 5)
+assert(not pcall(a.set_gso, a, -1))
+assert(not pcall(a.try_send_gso, a, "hello", 70000))
+assert(not pcall(b.start_recv, b, {gro = true, batch = 10}, print))
+a:close() b:close()
+uv.run()
+
+print("Done!")
@@ -0,0 +1,137 @@
+local uv = require "lluv"
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+local N = 50
+
+local function make_messages(n, prefix)
+  local t = {}
+  for i = 1, n do t[i] = prefix .. i end
+  return t
+end
+
+local function sender(port, messages)
+  local cli = uv.udp()
+  local i = 0
+  uv.timer():start(0, 1, function(timer)
+    -- send few datagrams per loop iteration to get several in one batch
+    for j = 1, 5 do
+      i = i + 1
+      if not messages[i] then
+        timer:close()
+        cli:close()
+        return
+      end
+      cli:send("127.0.0.1", port, messages[i])
+    end
+  end)
+end
+
+local function run_case(flags, opts, cb)
+  local messages = make_messages(N, "message #")
+  local result, batches, max_batch = {}, 0, 0
+
+  local server = assert(uv.udp(flags):bind("127.0.0.1", 0))
+  local _, port = server:getsockname()
+
+  local function done()
+    server:close()
+    cb(messages, result, batches, max_batch)
+  end
+
+  if opts then
+    server:start_recv(opts, function(self, err, datas, hosts, ports, n)
+      assert(not err, tostring(err))
+      assert(n == #datas and n == #hosts and n == #ports)
+      batches = batches + 1
+      if n > max_batch then max_batch = n end
+      for i = 1, n do
+        assert(hosts[i] == "127.0.0.1", tostring(hosts[i]))
+        assert(type(ports[i]) == "number")
+        result[#result + 1] = datas[i]
+      end
+      if #result == N then done() end
+    end)
+  else
+    server:start_recv(function(self, err, data, flags, host, port)
+      assert(not err, tostring(err))
+      assert(host == "127.0.0.1")
+      batches = batches + 1
+      result[#result + 1] = data
+      if #result == N then done() end
+    end)
+  end
+
+  sender(port, messages)
+end
+
+local function check(name, batch_size)
+  return function(messages, result, batches, max_batch)
+    assert(#result == N, name .. ": invalid number of messages: " .. #result)
+    for i = 1, N do
+      assert(result[i] == messages[i], name .. ": invalid message #" .. i)
+    end
+    if batch_size then
+      assert(max_batch <= batch_size, name .. ": batch too big: " .. max_batch)
+      assert(batches < N, name .. ": datagrams not batched")
+    end
+  end
+end
+
+local cases = 0
+
+local function case(...)
+  cases = cases + 1
+  local cb = select(select('#', ...), ...)
+  local args = {...}
+  args[#args] = function(...)
+    cb(...)
+    cases = cases - 1
+    if cases == 0 then TIMER:close() end
+  end
+  run_case((table.unpack or unpack)(args))
+end
+
+case(nil, nil,          check("plain"))
+case(nil, {batch=true}, check("batch", N))
+case(nil, {batch=3},    check("batch 3", 3))
+
+if uv.UDP_RECVMMSG then
+  case("recvmmsg", nil,          check("recvmmsg plain"))
+  case({"recvmmsg", "inet"}, {batch=true}, check("recvmmsg batch", N))
+end
+
+uv.run()
+
+assert(cases == 0, "not all cases done")
+
+-- incomplete batch delivered at end of loop iteration
+local server = assert(uv.udp():bind("127.0.0.1", 0))
+local _, port = server:getsockname()
+local cli = uv.udp()
+local got
+
+server:start_recv({batch=10}, function(self, err, datas, hosts, ports, n)
+  assert(not err, tostring(err))
+  got = datas
+  self:close()
+  cli:close()
+end)
+
+cli:send("127.0.0.1", port, "hello")
+
+uv.run()
+
+assert(got and #got == 1 and got[1] == "hello")
+
+-- invalid options
+local s = uv.udp()
+assert(not pcall(s.start_recv, s, {batch=0}, print))
+assert(not pcall(s.start_recv, s, {batch=false}, print))
+assert(not pcall(uv.udp, "unknown"))
+s:close()
+uv.run()
+
+print("Done!")
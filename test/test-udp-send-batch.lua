@@ -0,0 +1,99 @@
+local uv = require "lluv"
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+local N = 64
+
+local received = {}
+local cb_called, ctx_value, cb_error = 0
+
+local server = assert(uv.udp():bind("127.0.0.1", 0))
+local _, port = server:getsockname()
+
+local cli = uv.udp()
+
+server:start_recv(function(self, err, data, flags, host, port)
+  assert(not err, tostring(err))
+  received[#received + 1] = data
+  if #received == 2 * N then
+    server:close()
+    cli:close()
+    TIMER:close()
+  end
+end)
+
+local list = {}
+for i = 1, N do
+  list[i] = {"message #" .. i, "127.0.0.1", port}
+end
+
+assert(cli == cli:send_batch(list, function(self, err, ctx)
+  assert(self == cli)
+  cb_called = cb_called + 1
+  ctx_value, cb_error = ctx, err
+end, "ctx"))
+
+-- callback never called from send_batch itself
+assert(cb_called == 0)
+
+-- requests already pending so all datagrams go through queue
+cli:send("127.0.0.1", port, "message #" .. (N + 1))
+local list2 = {}
+for i = 2, N do
+  list2[#list2 + 1] = {"message #" .. (N + i), "127.0.0.1", port}
+end
+assert(cli == cli:send_batch(list2))
+
+uv.run()
+
+assert(cb_called == 1, "callback called: " .. cb_called)
+assert(ctx_value == "ctx")
+assert(not cb_error, tostring(cb_error))
+
+assert(#received == 2 * N, "received: " .. #received)
+for i = 1, 2 * N do
+  assert(received[i] == "message #" .. i, "invalid message #" .. i .. ": " .. tostring(received[i]))
+end
+
+-- connected socket
+if uv.udp().connect then
+  local server = assert(uv.udp():bind("127.0.0.1", 0))
+  local _, port = server:getsockname()
+  local cli = assert(uv.udp():connect("127.0.0.1", port))
+  local got, err_called = {}, 0
+
+  server:start_recv(function(self, err, data)
+    assert(not err, tostring(err))
+    got[#got + 1] = data
+    if #got == 5 then self:close() end
+  end)
+
+  cli:send_batch({"a", "b", "c"}, function(self, err)
+    assert(not err, tostring(err))
+    -- error of one datagram does not stop others
+    self:send_batch({"d", string.rep("x", 70000), "f"}, function(self, err)
+      err_called = err_called + 1
+      assert(err)
+      self:close()
+    end)
+  end)
+
+  uv.run()
+
+  assert(table.concat(got) == "abcdf", table.concat(got))
+  assert(err_called == 1)
+end
+
+-- invalid arguments
+local s = uv.udp()
+local ok, err = s:send_batch({{"data", "invalid", 0}})
+assert(not ok and err)
+assert(not pcall(s.send_batch, s, {{}}))
+assert(not pcall(s.send_batch, s, {true}))
+assert(not pcall(s.send_batch, s, "data"))
+s:close()
+uv.run()
+
+print("Done!")
@@ -0,0 +1,87 @@
+local uv = require "lluv"
+
+local HIGH, LOW = 1024 * 1024, 64 * 1024
+local CHUNK     = string.rep("x", 64 * 1024)
+local PASS      = false
+local events    = {}
+local received, sent = 0, 0
+
+local TIMER = uv.timer():start(10000, function()
+  uv.stop()
+end)
+
+local function on_read(cli, err, data)
+  if err then
+    if err:name() ~= 'EOF' then
+      io.stderr:write("Can not read data:", tostring(err), "\n")
+    end
+    PASS = (received == sent) and (table.concat(events, ",") == "full,drain")
+    TIMER:close()
+    return cli:close()
+  end
+
+  received = received + #data
+end
+
+local function on_connection(server, err)
+  if err then
+    io.stderr:write("Can not listen on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  local cli = server:accept()
+  server:close()
+
+  -- start read later so client queue grows
+  uv.timer():start(200, function(self)
+    self:close()
+    cli:start_read(on_read)
+  end)
+end
+
+uv.tcp():bind("127.0.0.1", 0, function(server, err)
+  if err then
+    io.stderr:write("Can not bind on server:", tostring(err), "\n")
+    return server:close()
+  end
+
+  local host, port = server:getsockname()
+
+  server:listen(on_connection)
+
+  uv.tcp():connect(host, port, function(cli, err)
+    if err then
+      io.stderr:write("Can not connect to server:", tostring(err), "\n")
+      return cli:close()
+    end
+
+    local full = false
+
+    cli:set_write_watermarks(HIGH, LOW, function(self)
+      assert(self == cli)
+      assert(self:get_write_queue_size() >= HIGH)
+      events[#events + 1] = "full"
+      full = true
+    end, function(self)
+      assert(self == cli)
+      assert(self:get_write_queue_size() <= LOW)
+      events[#events + 1] = "drain"
+      cli:shutdown(function() cli:close() end)
+    end)
+
+    -- on_full called asynchronously after write
+    uv.idle():start(function(self)
+      if full then return self:close() end
+      for i = 1, 4 do
+        cli:write(CHUNK)
+        sent = sent + #CHUNK
+      end
+    end)
+  end)
+end)
+
+uv.run()
+
+if not PASS then os.exit(1) end
+
+print("Done!")